@@ -0,0 +1,635 @@
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+static const VkDeviceSize SMALL_HEAP_SIZE = 1024ull * 1024 * 1024;
+static const VkDeviceSize MIN_BLOCK_SIZE = 1024ull * 1024;
+static const VkDeviceSize STAGING_BLOCK_SIZE = 16ull * 1024 * 1024;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+        return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Whether the end of a resource and the start of the one after it fall on
+// the same bufferImageGranularity page
+static bool onSamePage(
+        VkDeviceSize endOffset,
+        VkDeviceSize startOffset,
+        VkDeviceSize granularity
+) {
+        return (endOffset & ~(granularity - 1)) == (startOffset & ~(granularity - 1));
+}
+
+const Result allocatorFindMemoryType(
+        const Allocator *allocator,
+        uint32_t typeFilter,
+        VkMemoryPropertyFlags properties,
+        uint32_t *pMemType
+) {
+        const VkPhysicalDeviceMemoryProperties *memProperties =
+                &allocator->memoryProperties;
+
+        for (uint32_t i = 0; i < memProperties->memoryTypeCount; i++) {
+                if (typeFilter & (1 << i)
+                        && (memProperties->memoryTypes[i].propertyFlags & properties)
+                                == properties
+                ) {
+                        *pMemType = i;
+                        return RESULT_SUCCESS;
+                }
+        }
+
+        return RESULT_ERROR(-1, "failed to find suitable memory type!");
+}
+
+const Result allocatorCreate(
+        Allocator *allocator,
+        VkPhysicalDevice physicalDevice,
+        VkDevice device
+) {
+        memset(allocator, 0, sizeof(Allocator));
+        allocator->device = device;
+
+        vkGetPhysicalDeviceMemoryProperties(
+                physicalDevice,
+                &allocator->memoryProperties
+        );
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        allocator->bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+        // Small heaps (e.g. the host-visible BAR window) get smaller blocks so
+        // a single pool cannot claim a large share of them
+        for (uint32_t i = 0; i < allocator->memoryProperties.memoryTypeCount; i++) {
+                const uint32_t heap = allocator->memoryProperties.memoryTypes[i].heapIndex;
+                const VkDeviceSize heapSize =
+                        allocator->memoryProperties.memoryHeaps[heap].size;
+
+                VkDeviceSize blockSize = heapSize <= SMALL_HEAP_SIZE
+                        ? heapSize / 8
+                        : DEFAULT_BLOCK_SIZE;
+
+                if (blockSize < MIN_BLOCK_SIZE)
+                        blockSize = MIN_BLOCK_SIZE;
+
+                allocator->blockSizes[i] = blockSize;
+        }
+
+        return allocatorFindMemoryType(
+                allocator,
+                UINT32_MAX,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &allocator->staging.memoryType
+        );
+}
+
+static const Result allocateBlock(
+        Allocator *allocator,
+        uint32_t memoryType,
+        VkDeviceSize size,
+        VkDeviceSize minSize,
+        AllocatorBlock *pBlock
+) {
+        VkMemoryAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .allocationSize = size,
+                .memoryTypeIndex = memoryType,
+        };
+
+        VkDeviceMemory memory;
+        VkResult result = vkAllocateMemory(allocator->device, &allocInfo, NULL, &memory);
+
+        // Retry with smaller blocks before giving up
+        while (result != VK_SUCCESS && allocInfo.allocationSize / 2 >= minSize) {
+                allocInfo.allocationSize /= 2;
+                result = vkAllocateMemory(allocator->device, &allocInfo, NULL, &memory);
+        }
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate device memory block!");
+
+        *pBlock = (AllocatorBlock) {
+                .memory = memory,
+                .size = allocInfo.allocationSize,
+        };
+
+        const VkMemoryPropertyFlags flags =
+                allocator->memoryProperties.memoryTypes[memoryType].propertyFlags;
+
+        // Host-visible blocks stay mapped for their whole lifetime
+        if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                result = vkMapMemory(
+                        allocator->device,
+                        memory,
+                        0,
+                        VK_WHOLE_SIZE,
+                        0,
+                        &pBlock->mapped
+                );
+
+                if (result != VK_SUCCESS) {
+                        vkFreeMemory(allocator->device, memory, NULL);
+                        return RESULT_ERROR(result, "failed to map device memory block!");
+                }
+        }
+
+        allocator->stats.blockCount++;
+        allocator->stats.blockBytes += pBlock->size;
+        allocator->stats.deviceMemoryAllocations++;
+        return RESULT_SUCCESS;
+}
+
+static void releaseBlock(Allocator *allocator, AllocatorBlock *block)
+{
+        if (block->memory == VK_NULL_HANDLE)
+                return;
+
+        vkFreeMemory(allocator->device, block->memory, NULL);
+        free(block->chunks);
+
+        allocator->stats.blockCount--;
+        allocator->stats.blockBytes -= block->size;
+        *block = (AllocatorBlock) { .memory = VK_NULL_HANDLE };
+}
+
+static bool reserveChunks(AllocatorBlock *block, uint32_t extra)
+{
+        if (block->chunkCount + extra <= block->chunkCapacity)
+                return true;
+
+        uint32_t capacity = block->chunkCapacity ? block->chunkCapacity * 2 : 16;
+        while (capacity < block->chunkCount + extra)
+                capacity *= 2;
+
+        AllocatorChunk *chunks = realloc(block->chunks, sizeof(AllocatorChunk) * capacity);
+        if (!chunks)
+                return false;
+
+        block->chunks = chunks;
+        block->chunkCapacity = capacity;
+        return true;
+}
+
+static void insertChunk(AllocatorBlock *block, uint32_t index, AllocatorChunk chunk)
+{
+        memmove(
+                &block->chunks[index + 1],
+                &block->chunks[index],
+                sizeof(AllocatorChunk) * (block->chunkCount - index)
+        );
+
+        block->chunks[index] = chunk;
+        block->chunkCount++;
+}
+
+static void removeChunk(AllocatorBlock *block, uint32_t index)
+{
+        memmove(
+                &block->chunks[index],
+                &block->chunks[index + 1],
+                sizeof(AllocatorChunk) * (block->chunkCount - index - 1)
+        );
+
+        block->chunkCount--;
+}
+
+// First fit over the free chunks of a block. Free chunks are always merged,
+// so the neighbours of a free chunk are either used or absent.
+static bool allocateFromBlock(
+        AllocatorBlock *block,
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        VkDeviceSize granularity,
+        AllocationKind kind,
+        VkDeviceSize *pOffset
+) {
+        if (block->size - block->used < size)
+                return false;
+
+        for (uint32_t i = 0; i < block->chunkCount; i++) {
+                const AllocatorChunk chunk = block->chunks[i];
+                if (!chunk.free || chunk.size < size)
+                        continue;
+
+                VkDeviceSize offset = alignUp(chunk.offset, alignment);
+
+                if (i > 0 && granularity > 1) {
+                        const AllocatorChunk *prev = &block->chunks[i - 1];
+                        if (prev->kind != kind && onSamePage(
+                                prev->offset + prev->size - 1,
+                                offset,
+                                granularity
+                        )) {
+                                offset = alignUp(offset, granularity);
+                        }
+                }
+
+                const VkDeviceSize end = offset + size;
+                if (end > chunk.offset + chunk.size)
+                        continue;
+
+                if (i + 1 < block->chunkCount && granularity > 1) {
+                        const AllocatorChunk *next = &block->chunks[i + 1];
+                        if (next->kind != kind && onSamePage(end - 1, next->offset, granularity))
+                                continue;
+                }
+
+                if (!reserveChunks(block, 2))
+                        return false;
+
+                block->chunks[i] = (AllocatorChunk) {
+                        .offset = offset,
+                        .size = size,
+                        .kind = kind,
+                        .free = false,
+                };
+
+                const VkDeviceSize tail = chunk.offset + chunk.size - end;
+                if (tail > 0) {
+                        insertChunk(block, i + 1, (AllocatorChunk) {
+                                .offset = end,
+                                .size = tail,
+                                .free = true,
+                        });
+                }
+
+                if (offset > chunk.offset) {
+                        insertChunk(block, i, (AllocatorChunk) {
+                                .offset = chunk.offset,
+                                .size = offset - chunk.offset,
+                                .free = true,
+                        });
+                }
+
+                block->used += size;
+                *pOffset = offset;
+                return true;
+        }
+
+        return false;
+}
+
+static void freeFromBlock(AllocatorBlock *block, VkDeviceSize offset)
+{
+        uint32_t lo = 0;
+        uint32_t hi = block->chunkCount;
+        while (lo < hi) {
+                const uint32_t mid = (lo + hi) / 2;
+                if (block->chunks[mid].offset < offset)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        if (lo == block->chunkCount || block->chunks[lo].offset != offset)
+                return;
+
+        uint32_t i = lo;
+        block->used -= block->chunks[i].size;
+        block->chunks[i].free = true;
+
+        if (i + 1 < block->chunkCount && block->chunks[i + 1].free) {
+                block->chunks[i].size += block->chunks[i + 1].size;
+                removeChunk(block, i + 1);
+        }
+
+        if (i > 0 && block->chunks[i - 1].free) {
+                block->chunks[i - 1].size += block->chunks[i].size;
+                removeChunk(block, i);
+        }
+}
+
+static uint32_t liveBlockCount(const AllocatorPool *pool)
+{
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+                if (pool->blocks[i].memory != VK_NULL_HANDLE)
+                        count++;
+        }
+
+        return count;
+}
+
+static const Result addBlock(
+        Allocator *allocator,
+        uint32_t memoryType,
+        VkDeviceSize minSize,
+        uint32_t *pIndex
+) {
+        AllocatorPool *pool = &allocator->pools[memoryType];
+
+        uint32_t index = pool->blockCount;
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+                if (pool->blocks[i].memory == VK_NULL_HANDLE) {
+                        index = i;
+                        break;
+                }
+        }
+
+        if (index == pool->blockCount) {
+                AllocatorBlock *blocks = realloc(
+                        pool->blocks,
+                        sizeof(AllocatorBlock) * (pool->blockCount + 1)
+                );
+
+                if (!blocks)
+                        return RESULT_ERROR(-1, "failed to grow allocator pool!");
+
+                pool->blocks = blocks;
+                pool->blocks[pool->blockCount++] = (AllocatorBlock) {
+                        .memory = VK_NULL_HANDLE,
+                };
+        }
+
+        VkDeviceSize size = allocator->blockSizes[memoryType];
+        if (size < minSize)
+                size = minSize;
+
+        AllocatorBlock *block = &pool->blocks[index];
+        Result res;
+        handle(allocateBlock(allocator, memoryType, size, minSize, block));
+
+        if (!reserveChunks(block, 1)) {
+                releaseBlock(allocator, block);
+                return RESULT_ERROR(-1, "failed to allocate block chunk list!");
+        }
+
+        block->chunks[block->chunkCount++] = (AllocatorChunk) {
+                .offset = 0,
+                .size = block->size,
+                .free = true,
+        };
+
+        *pIndex = index;
+        return RESULT_SUCCESS;
+}
+
+const Result allocatorAllocate(
+        Allocator *allocator,
+        const VkMemoryRequirements *requirements,
+        VkMemoryPropertyFlags properties,
+        AllocationKind kind,
+        Allocation *pAllocation
+) {
+        uint32_t memoryType;
+        Result res;
+        handle(allocatorFindMemoryType(
+                allocator,
+                requirements->memoryTypeBits,
+                properties,
+                &memoryType
+        ));
+
+        AllocatorPool *pool = &allocator->pools[memoryType];
+        const VkDeviceSize granularity = allocator->bufferImageGranularity;
+
+        VkDeviceSize offset = 0;
+        uint32_t blockIndex = UINT32_MAX;
+        for (uint32_t i = 0; i < pool->blockCount; i++) {
+                if (pool->blocks[i].memory == VK_NULL_HANDLE)
+                        continue;
+
+                if (allocateFromBlock(
+                        &pool->blocks[i],
+                        requirements->size,
+                        requirements->alignment,
+                        granularity,
+                        kind,
+                        &offset
+                )) {
+                        blockIndex = i;
+                        break;
+                }
+        }
+
+        if (blockIndex == UINT32_MAX) {
+                handle(addBlock(allocator, memoryType, requirements->size, &blockIndex));
+
+                // A fresh block starts at offset 0, which satisfies any alignment
+                if (!allocateFromBlock(
+                        &pool->blocks[blockIndex],
+                        requirements->size,
+                        requirements->alignment,
+                        granularity,
+                        kind,
+                        &offset
+                )) {
+                        return RESULT_ERROR(-1, "failed to sub-allocate from new block!");
+                }
+        }
+
+        const AllocatorBlock *block = &pool->blocks[blockIndex];
+        *pAllocation = (Allocation) {
+                .memory = block->memory,
+                .offset = offset,
+                .size = requirements->size,
+                .mapped = block->mapped ? (char *) block->mapped + offset : NULL,
+                .memoryType = memoryType,
+                .block = blockIndex,
+                .staging = false,
+        };
+
+        AllocatorStats *stats = &allocator->stats;
+        stats->allocationCount++;
+        stats->allocatedBytes += requirements->size;
+        if (stats->allocatedBytes > stats->peakAllocatedBytes)
+                stats->peakAllocatedBytes = stats->allocatedBytes;
+
+        return RESULT_SUCCESS;
+}
+
+void allocatorFree(Allocator *allocator, Allocation *allocation)
+{
+        if (allocation->memory == VK_NULL_HANDLE)
+                return;
+
+        // Staging memory is only ever reclaimed by allocatorResetStaging
+        if (allocation->staging) {
+                *allocation = (Allocation) { .memory = VK_NULL_HANDLE };
+                return;
+        }
+
+        AllocatorPool *pool = &allocator->pools[allocation->memoryType];
+        AllocatorBlock *block = &pool->blocks[allocation->block];
+        freeFromBlock(block, allocation->offset);
+
+        allocator->stats.allocationCount--;
+        allocator->stats.allocatedBytes -= allocation->size;
+
+        // Keep one block per pool around to avoid churn on alloc/free cycles
+        if (block->used == 0 && liveBlockCount(pool) > 1)
+                releaseBlock(allocator, block);
+
+        *allocation = (Allocation) { .memory = VK_NULL_HANDLE };
+}
+
+const Result allocatorAllocateStaging(
+        Allocator *allocator,
+        const VkMemoryRequirements *requirements,
+        Allocation *pAllocation
+) {
+        StagingArena *arena = &allocator->staging;
+
+        if (!(requirements->memoryTypeBits & (1 << arena->memoryType)))
+                return RESULT_ERROR(-1, "staging memory type not supported by resource!");
+
+        VkDeviceSize offset = 0;
+        for (;;) {
+                if (arena->current < arena->blockCount) {
+                        const AllocatorBlock *block = &arena->blocks[arena->current];
+                        offset = alignUp(arena->offset, requirements->alignment);
+                        if (offset + requirements->size <= block->size)
+                                break;
+
+                        arena->current++;
+                        arena->offset = 0;
+                        continue;
+                }
+
+                AllocatorBlock *blocks = realloc(
+                        arena->blocks,
+                        sizeof(AllocatorBlock) * (arena->blockCount + 1)
+                );
+
+                if (!blocks)
+                        return RESULT_ERROR(-1, "failed to grow staging arena!");
+
+                arena->blocks = blocks;
+
+                const VkDeviceSize size = requirements->size > STAGING_BLOCK_SIZE
+                        ? requirements->size
+                        : STAGING_BLOCK_SIZE;
+
+                Result res;
+                handle(allocateBlock(
+                        allocator,
+                        arena->memoryType,
+                        size,
+                        requirements->size,
+                        &arena->blocks[arena->blockCount]
+                ));
+
+                arena->current = arena->blockCount++;
+                arena->offset = 0;
+        }
+
+        const AllocatorBlock *block = &arena->blocks[arena->current];
+        *pAllocation = (Allocation) {
+                .memory = block->memory,
+                .offset = offset,
+                .size = requirements->size,
+                .mapped = (char *) block->mapped + offset,
+                .memoryType = arena->memoryType,
+                .block = arena->current,
+                .staging = true,
+        };
+
+        arena->offset = offset + requirements->size;
+        allocator->stats.stagingBytes += requirements->size;
+        return RESULT_SUCCESS;
+}
+
+void allocatorResetStaging(Allocator *allocator)
+{
+        StagingArena *arena = &allocator->staging;
+
+        // Overflow blocks only exist for unusually large batches, keep the first
+        for (uint32_t i = 1; i < arena->blockCount; i++)
+                releaseBlock(allocator, &arena->blocks[i]);
+
+        arena->blockCount = arena->blockCount > 0 ? 1 : 0;
+        arena->current = 0;
+        arena->offset = 0;
+        allocator->stats.stagingBytes = 0;
+}
+
+const Result allocatorAllocateBuffer(
+        Allocator *allocator,
+        VkBuffer buffer,
+        VkMemoryPropertyFlags properties,
+        Allocation *pAllocation
+) {
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(allocator->device, buffer, &memRequirements);
+
+        Result res;
+        handle(allocatorAllocate(
+                allocator,
+                &memRequirements,
+                properties,
+                ALLOCATION_KIND_LINEAR,
+                pAllocation
+        ));
+
+        const VkResult result = vkBindBufferMemory(
+                allocator->device,
+                buffer,
+                pAllocation->memory,
+                pAllocation->offset
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to bind buffer memory!");
+
+        return RESULT_SUCCESS;
+}
+
+const Result allocatorAllocateImage(
+        Allocator *allocator,
+        VkImage image,
+        VkMemoryPropertyFlags properties,
+        Allocation *pAllocation
+) {
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(allocator->device, image, &memRequirements);
+
+        Result res;
+        handle(allocatorAllocate(
+                allocator,
+                &memRequirements,
+                properties,
+                ALLOCATION_KIND_OPTIMAL,
+                pAllocation
+        ));
+
+        const VkResult result = vkBindImageMemory(
+                allocator->device,
+                image,
+                pAllocation->memory,
+                pAllocation->offset
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to bind image memory!");
+
+        return RESULT_SUCCESS;
+}
+
+const AllocatorStats allocatorGetStats(const Allocator *allocator)
+{
+        return allocator->stats;
+}
+
+void allocatorDestroy(Allocator *allocator)
+{
+        for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+                AllocatorPool *pool = &allocator->pools[i];
+                for (uint32_t j = 0; j < pool->blockCount; j++)
+                        releaseBlock(allocator, &pool->blocks[j]);
+
+                free(pool->blocks);
+                *pool = (AllocatorPool) { .blocks = NULL };
+        }
+
+        for (uint32_t i = 0; i < allocator->staging.blockCount; i++)
+                releaseBlock(allocator, &allocator->staging.blocks[i]);
+
+        free(allocator->staging.blocks);
+        allocator->staging.blocks = NULL;
+        allocator->staging.blockCount = 0;
+}
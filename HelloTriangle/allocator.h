@@ -0,0 +1,126 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "result.h"
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+// Linear covers buffers and linear-tiled images, optimal covers
+// optimal-tiled images. Neighbours of different kinds must not share a
+// bufferImageGranularity page.
+typedef enum allocationKind {
+        ALLOCATION_KIND_LINEAR,
+        ALLOCATION_KIND_OPTIMAL,
+} AllocationKind;
+
+typedef struct allocation {
+        VkDeviceMemory memory;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        void *mapped; // NULL unless the memory is host-visible
+        uint32_t memoryType;
+        uint32_t block;
+        bool staging;
+} Allocation;
+
+typedef struct allocatorChunk {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        AllocationKind kind;
+        bool free;
+} AllocatorChunk;
+
+typedef struct allocatorBlock {
+        VkDeviceMemory memory; // VK_NULL_HANDLE marks a released slot
+        VkDeviceSize size;
+        VkDeviceSize used;
+        void *mapped;
+        AllocatorChunk *chunks; // sorted by offset, free neighbours merged
+        uint32_t chunkCount;
+        uint32_t chunkCapacity;
+} AllocatorBlock;
+
+typedef struct allocatorPool {
+        AllocatorBlock *blocks;
+        uint32_t blockCount;
+} AllocatorPool;
+
+// Bump-allocated host-visible memory for short-lived staging data. Nothing
+// is freed individually, the whole arena is reset once the copies that read
+// from it have completed.
+typedef struct stagingArena {
+        AllocatorBlock *blocks;
+        uint32_t blockCount;
+        uint32_t current;
+        VkDeviceSize offset;
+        uint32_t memoryType;
+} StagingArena;
+
+typedef struct allocatorStats {
+        uint32_t blockCount;
+        VkDeviceSize blockBytes;
+        uint32_t allocationCount;
+        VkDeviceSize allocatedBytes;
+        VkDeviceSize peakAllocatedBytes;
+        VkDeviceSize stagingBytes;
+        uint32_t deviceMemoryAllocations; // lifetime vkAllocateMemory calls
+} AllocatorStats;
+
+// Not thread-safe; all allocations happen on the render thread.
+typedef struct allocator {
+        VkDevice device;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize bufferImageGranularity;
+        VkDeviceSize blockSizes[VK_MAX_MEMORY_TYPES];
+        AllocatorPool pools[VK_MAX_MEMORY_TYPES];
+        StagingArena staging;
+        AllocatorStats stats;
+} Allocator;
+
+const Result allocatorCreate(
+        Allocator *allocator,
+        VkPhysicalDevice physicalDevice,
+        VkDevice device
+);
+void allocatorDestroy(Allocator *allocator);
+
+const Result allocatorFindMemoryType(
+        const Allocator *allocator,
+        uint32_t typeFilter,
+        VkMemoryPropertyFlags properties,
+        uint32_t *pMemType
+);
+
+const Result allocatorAllocate(
+        Allocator *allocator,
+        const VkMemoryRequirements *requirements,
+        VkMemoryPropertyFlags properties,
+        AllocationKind kind,
+        Allocation *pAllocation
+);
+void allocatorFree(Allocator *allocator, Allocation *allocation);
+
+// Always host-visible and coherent, and always mapped
+const Result allocatorAllocateStaging(
+        Allocator *allocator,
+        const VkMemoryRequirements *requirements,
+        Allocation *pAllocation
+);
+void allocatorResetStaging(Allocator *allocator);
+
+const Result allocatorAllocateBuffer(
+        Allocator *allocator,
+        VkBuffer buffer,
+        VkMemoryPropertyFlags properties,
+        Allocation *pAllocation
+);
+const Result allocatorAllocateImage(
+        Allocator *allocator,
+        VkImage image,
+        VkMemoryPropertyFlags properties,
+        Allocation *pAllocation
+);
+
+const AllocatorStats allocatorGetStats(const Allocator *allocator);
+
+#endif
@@ -1,25 +1,53 @@
 #include "app.h"
+#include "shaders.h"
 
 #include <cglm/call.h>
 
 #include <cglm/types.h>
+#include <ctype.h>
+#include <math.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <vulkan/vulkan_core.h>
 
-#define handle(result) \
-        res = result; \
-        if (res.code != 0) \
-                return res;
-
 static const uint32_t WIDTH = 800;
 static const uint32_t HEIGHT = 600;
 
-static const int MAX_FRAMES_IN_FLIGHT = 2;
 
-#define RESULT_ERROR(c, msg) (Result) { .code = c, .data = msg }
+// Headless targets rotate through more images than there are frames in
+// flight so an image is never rendered to while it is still being read back.
+static const uint32_t OFFSCREEN_IMAGE_COUNT = 3;
+static const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+static const uint32_t HEADLESS_DEFAULT_FRAME_COUNT = 1;
+
+static const char *const DEFAULT_PIPELINE_CACHE_PATH = "pipeline.cache";
+
+static const char *const SHADER_SOURCE_DIR = "shaders";
+
+// How long a minimised window sleeps on events between checks
+static const double SUSPENDED_WAIT_SECONDS = 0.1;
+
+static const VkDeviceSize UPLOAD_RING_SIZE = 8 * 1024 * 1024;
+
+// Device memory textures may stream into unless --texture-budget says otherwise
+static const uint32_t DEFAULT_TEXTURE_BUDGET_MIB = 256;
+static const float MAX_TEXTURE_ANISOTROPY = 8.0f;
+
+// Start and end of each frame's command buffer, then of its particle step
+static const uint32_t TIMESTAMPS_PER_FRAME = 4;
+
+static const uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x in cull.comp
+static const uint32_t PARTICLE_WORKGROUP_SIZE = 256; // local_size_x in particles.comp
+
+// Scale of the built-in quad for each particle
+static const float PARTICLE_SIZE = 0.005f;
+// Longer frames are simulated as this long, so a stall cannot fling
+// particles out past the walls they bounce off
+static const float PARTICLE_MAX_STEP_SECONDS = 1.0f / 30.0f;
+
+#define MAX_INSTANCE_EXTENSIONS 16
 
 const Result RESULT_SUCCESS = (Result) {
         .code = 0,
@@ -42,6 +70,30 @@ static const char *const DEVICE_EXTENSIONS[] = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 };
 
+// Enabled when the device has them, features check for the result
+static const uint32_t OPTIONAL_DEVICE_EXTENSION_COUNT = 1;
+static const char *const OPTIONAL_DEVICE_EXTENSIONS[] = {
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+};
+
+// Frame pacing times presents with these, windowed only and both or neither
+static const uint32_t PRESENT_TIMING_EXTENSION_COUNT = 2;
+static const char *const PRESENT_TIMING_EXTENSIONS[] = {
+        VK_KHR_PRESENT_ID_EXTENSION_NAME,
+        VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+};
+
+// Render without render pass or framebuffer objects, both or neither
+static const uint32_t DYNAMIC_RENDERING_EXTENSION_COUNT = 2;
+static const char *const DYNAMIC_RENDERING_EXTENSIONS[] = {
+        VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+};
+
+// A present still not on screen after this (an occluded window, say) is
+// given up on instead of stalling every frame behind it
+static const uint64_t PRESENT_WAIT_TIMEOUT_NS = 100000000;
+
 typedef struct {
         vec2 pos;
         vec3 color;
@@ -61,33 +113,63 @@ static const uint16_t INDICES[] = {
         2, 3, 0,
 };
 
-static const VkVertexInputBindingDescription vertexGetBindingDescription()
-{
-        const VkVertexInputBindingDescription bindingDescription = {
+#define VERTEX_BINDING_COUNT 2
+#define INSTANCE_ATTRIBUTE_COUNT 5
+#define FIRST_INSTANCE_LOCATION 2
+#define MAX_VERTEX_ATTRIBUTES (MESH_MAX_ATTRIBUTES + INSTANCE_ATTRIBUTE_COUNT)
+
+// Binding 0 follows whatever layout the mesh declares
+static void vertexGetBindingDescriptions(
+        const Mesh *mesh,
+        VkVertexInputBindingDescription pDescriptions[VERTEX_BINDING_COUNT]
+) {
+        pDescriptions[0] = (VkVertexInputBindingDescription) {
                 .binding = 0,
-                .stride = sizeof(Vertex),
+                .stride = mesh->header.vertexStride,
                 .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
         };
 
-        return bindingDescription;
+        pDescriptions[1] = (VkVertexInputBindingDescription) {
+                .binding = 1,
+                .stride = sizeof(Instance),
+                .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+        };
 }
 
-static void vertexGetAttributeDescriptions(
-        VkVertexInputAttributeDescription pDescriptions[2]
+// Returns the number of descriptions written
+static uint32_t vertexGetAttributeDescriptions(
+        const Mesh *mesh,
+        VkVertexInputAttributeDescription pDescriptions[MAX_VERTEX_ATTRIBUTES]
 ) {
-        pDescriptions[0] = (VkVertexInputAttributeDescription) {
-                .binding = 0,
-                .location = 0,
-                .format = VK_FORMAT_R32G32_SFLOAT,
-                .offset = offsetof(Vertex, pos),
-        };
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < mesh->header.attributeCount; i++) {
+                const MeshAttribute *attribute = &mesh->header.attributes[i];
+                pDescriptions[count++] = (VkVertexInputAttributeDescription) {
+                        .binding = 0,
+                        .location = attribute->location,
+                        .format = attribute->format,
+                        .offset = attribute->offset,
+                };
+        }
 
-        pDescriptions[1] = (VkVertexInputAttributeDescription) {
-                .binding = 0,
-                .location = 1,
-                .format = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset = offsetof(Vertex, color),
+        // One location per matrix column
+        for (uint32_t i = 0; i < 4; i++) {
+                pDescriptions[count++] = (VkVertexInputAttributeDescription) {
+                        .binding = 1,
+                        .location = FIRST_INSTANCE_LOCATION + i,
+                        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                        .offset = offsetof(Instance, transform) + sizeof(vec4) * i,
+                };
+        }
+
+        pDescriptions[count++] = (VkVertexInputAttributeDescription) {
+                .binding = 1,
+                .location = FIRST_INSTANCE_LOCATION + 4,
+                .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                .offset = offsetof(Instance, color),
         };
+
+        return count;
 }
 
 static const bool checkValidationLayerSupport()
@@ -222,10 +304,22 @@ static const Result initWindow(App *app)
         return RESULT_SUCCESS;
 }
 
-const char **getRequiredExtensions(uint32_t *extCount)
-{
-        const char **extensions;
-        extensions = glfwGetRequiredInstanceExtensions(extCount);
+const char **getRequiredExtensions(
+        const App *app,
+        const char **extensions,
+        uint32_t *extCount
+) {
+        *extCount = 0;
+
+        // Headless runs never create a surface, so GLFW is not even initialised
+        if (!app->config.headless) {
+                uint32_t glfwExtCount = 0;
+                const char **glfwExtensions =
+                        glfwGetRequiredInstanceExtensions(&glfwExtCount);
+
+                for (uint32_t i = 0; i < glfwExtCount; i++)
+                        extensions[(*extCount)++] = glfwExtensions[i];
+        }
 
         if (ENABLE_VALIDATION_LAYERS)
                 extensions[(*extCount)++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
@@ -272,11 +366,16 @@ static const Result createInstance(App *app)
                 .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
                 .pEngineName = "No Engine",
                 .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-                .apiVersion = VK_API_VERSION_1_0,
+                .apiVersion = VK_API_VERSION_1_2,
         };
 
         uint32_t extCount = 0;
-        const char **extensions = getRequiredExtensions(&extCount);
+        const char *extensionNames[MAX_INSTANCE_EXTENSIONS];
+        const char **extensions = getRequiredExtensions(
+                app,
+                extensionNames,
+                &extCount
+        );
         checkExtensions(extensions, extCount);
 
         VkInstanceCreateInfo createInfo = {
@@ -305,6 +404,11 @@ static const Result createInstance(App *app)
 
 static const Result createSurface(App *app)
 {
+        if (app->config.headless) {
+                app->surface = VK_NULL_HANDLE;
+                return RESULT_SUCCESS;
+        }
+
         VkResult result = glfwCreateWindowSurface(
                 app->instance,
                 app->window,
@@ -322,7 +426,7 @@ typedef struct {
         uint32_t formatCount;
         VkSurfaceFormatKHR formats[256];
         uint32_t presentModeCount;
-        VkPresentModeKHR presentModes[4];
+        VkPresentModeKHR presentModes[8];
 } SwapChainSupportDetails;
 
 static const SwapChainSupportDetails querySwapChainSupport(
@@ -359,6 +463,11 @@ static const SwapChainSupportDetails querySwapChainSupport(
                 NULL
         );
 
+        // Anything past the array is reported as VK_INCOMPLETE, not written
+        const uint32_t maxPresentModes = sizeof(details.presentModes) / sizeof(details.presentModes[0]);
+        if (details.presentModeCount > maxPresentModes)
+                details.presentModeCount = maxPresentModes;
+
         if (details.presentModeCount != 0) {
                 vkGetPhysicalDeviceSurfacePresentModesKHR(
                         device,
@@ -374,10 +483,19 @@ static const SwapChainSupportDetails querySwapChainSupport(
 typedef struct {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        uint32_t transferFamily; // graphicsFamily when no dedicated one exists
+        uint32_t computeFamily; // graphicsFamily whenever that supports compute
+        uint32_t asyncComputeFamily; // compute without graphics, -1 when there is none
 } QueueFamilyIndices;
 
-static const bool indicesComplete(QueueFamilyIndices indices) {
-        return indices.graphicsFamily != -1 && indices.presentFamily != -1;
+// Without a surface (headless) there is nothing to present to, so only the
+// graphics family is required.
+static const bool indicesComplete(
+        QueueFamilyIndices indices,
+        VkSurfaceKHR surface
+) {
+        return indices.graphicsFamily != -1
+                && (surface == VK_NULL_HANDLE || indices.presentFamily != -1);
 }
 
 static const QueueFamilyIndices findQueueFamilies(
@@ -387,6 +505,9 @@ static const QueueFamilyIndices findQueueFamilies(
         QueueFamilyIndices indices = {
                 .graphicsFamily = -1,
                 .presentFamily = -1,
+                .transferFamily = -1,
+                .computeFamily = -1,
+                .asyncComputeFamily = -1,
         };
 
         uint32_t queueFamilyCount = 0;
@@ -399,30 +520,80 @@ static const QueueFamilyIndices findQueueFamilies(
                 queueFamilies
         );
 
+        // Drivers list their main family first. Presenting from the graphics
+        // family, where it can, saves a queue and a semaphore hop per frame.
         VkBool32 presentSupport = false;
         for (uint32_t i = 0; i < queueFamilyCount; i++) {
-                if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                if (indices.graphicsFamily == -1
+                        && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+                ) {
                         indices.graphicsFamily = i;
+                }
 
-                vkGetPhysicalDeviceSurfaceSupportKHR(
-                        device,
-                        i,
-                        surface,
-                        &presentSupport
-                );
+                if (surface != VK_NULL_HANDLE) {
+                        vkGetPhysicalDeviceSurfaceSupportKHR(
+                                device,
+                                i,
+                                surface,
+                                &presentSupport
+                        );
+
+                        if (presentSupport
+                                && (indices.presentFamily == -1 || i == indices.graphicsFamily)
+                        ) {
+                                indices.presentFamily = i;
+                        }
+                }
+        }
+
+        // Transfer-only families usually map to the copy engines, which can run
+        // uploads alongside rendering
+        for (uint32_t i = 0; i < queueFamilyCount; i++) {
+                const VkQueueFlags flags = queueFamilies[i].queueFlags;
+                if ((flags & VK_QUEUE_TRANSFER_BIT)
+                        && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+                ) {
+                        indices.transferFamily = i;
+                        break;
+                }
+        }
 
-                if (presentSupport)
-                        indices.presentFamily = i;
+        if (indices.transferFamily == -1)
+                indices.transferFamily = indices.graphicsFamily;
+
+        // Culling is recorded into the frame's own command buffer, so compute
+        // on the graphics family avoids any cross-queue hand-off
+        if (indices.graphicsFamily != -1
+                && (queueFamilies[indices.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT)
+        ) {
+                indices.computeFamily = indices.graphicsFamily;
+        } else {
+                for (uint32_t i = 0; i < queueFamilyCount; i++) {
+                        if (queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) {
+                                indices.computeFamily = i;
+                                break;
+                        }
+                }
+        }
 
-                if (indicesComplete(indices))
+        // Compute families without graphics run alongside rendering instead
+        // of taking turns with it
+        for (uint32_t i = 0; i < queueFamilyCount; i++) {
+                const VkQueueFlags flags = queueFamilies[i].queueFlags;
+                if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                        indices.asyncComputeFamily = i;
                         break;
+                }
         }
 
         return indices;
 }
 
-static const bool checkDeviceExtensionSupport(VkPhysicalDevice device)
-{
+static const bool checkDeviceExtensionSupport(
+        VkPhysicalDevice device,
+        const char *const *extensions,
+        uint32_t extCount
+) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
 
@@ -434,31 +605,85 @@ static const bool checkDeviceExtensionSupport(VkPhysicalDevice device)
                 availableExtensions
         );
 
-        bool missingExt = true;
-        for (int i = 0; i < DEVICE_EXTENSION_COUNT; i++) {
+        for (int i = 0; i < extCount; i++) {
+                bool found = false;
                 for (int j = 0; j < extensionCount; j++) {
                         if (strncmp(
-                                DEVICE_EXTENSIONS[i],
+                                extensions[i],
                                 availableExtensions[j].extensionName,
                                 64
                         ) == 0) {
-                                missingExt = false;
+                                found = true;
                                 break;
                         }
                 }
 
-                if (missingExt)
-                        break;
+                if (!found)
+                        return false;
         }
 
-        return !missingExt;
+        return true;
+}
+
+// Frame and upload synchronisation is built on timeline semaphores
+static const bool supportsTimelineSemaphores(VkPhysicalDevice device)
+{
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_2)
+                return false;
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        };
+
+        VkPhysicalDeviceFeatures2 features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &timelineFeatures,
+        };
+
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        return timelineFeatures.timelineSemaphore;
+}
+
+// Textures are bound through the bindless heap: partially bound,
+// update-after-bind arrays indexed at runtime, per vertex by the quads.
+// Without it the scene draws untextured and the quads are skipped.
+static const bool supportsDescriptorIndexing(VkPhysicalDevice device)
+{
+        VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+        };
+
+        VkPhysicalDeviceFeatures2 features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &indexingFeatures,
+        };
+
+        vkGetPhysicalDeviceFeatures2(device, &features);
+        return indexingFeatures.runtimeDescriptorArray
+                && indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+                && indexingFeatures.descriptorBindingPartiallyBound
+                && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+                && indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+                && indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
 }
 
 static const bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
         const QueueFamilyIndices indices = findQueueFamilies(device, surface);
+        if (!supportsTimelineSemaphores(device))
+                return false;
+
+        // Headless rendering needs neither the swapchain extension nor a surface
+        if (surface == VK_NULL_HANDLE)
+                return indicesComplete(indices, surface);
 
-        bool extensionsSupported = checkDeviceExtensionSupport(device);
+        bool extensionsSupported = checkDeviceExtensionSupport(
+                device,
+                DEVICE_EXTENSIONS,
+                DEVICE_EXTENSION_COUNT
+        );
 
         bool swapchainAdequate = false;
         if (extensionsSupported) {
@@ -472,11 +697,124 @@ static const bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface
                         && swapchainSupport.presentModeCount != 0;
         }
 
-        return indicesComplete(indices)
+        return indicesComplete(indices, surface)
                 && extensionsSupported
                 && swapchainAdequate;
 }
 
+// Device type weighs most, so a discrete GPU wins over an integrated one
+// whose heap is really shared system memory
+static const uint32_t DEVICE_TYPE_SCORE_DISCRETE = 20000;
+static const uint32_t DEVICE_TYPE_SCORE_INTEGRATED = 10000;
+static const uint32_t DEVICE_TYPE_SCORE_VIRTUAL = 5000;
+static const uint32_t DEVICE_TYPE_SCORE_CPU = 1000;
+static const uint32_t DEVICE_HEAP_SCORE_PER_GIB = 100;
+static const uint32_t DEVICE_HEAP_SCORE_MAX_GIB = 32;
+static const uint32_t DEVICE_FEATURE_SCORE = 500;
+
+// Ranks a suitable device by its type, its largest device-local heap, and
+// the optional features and queues the renderer makes use of. Never 0.
+static uint32_t rateDevice(VkPhysicalDevice device, VkSurfaceKHR surface)
+{
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+
+        uint32_t score = 1;
+        switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                score += DEVICE_TYPE_SCORE_DISCRETE;
+                break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                score += DEVICE_TYPE_SCORE_INTEGRATED;
+                break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                score += DEVICE_TYPE_SCORE_VIRTUAL;
+                break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                score += DEVICE_TYPE_SCORE_CPU;
+                break;
+        default:
+                break;
+        }
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+        VkDeviceSize largestHeap = 0;
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+                const VkMemoryHeap *heap = &memoryProperties.memoryHeaps[i];
+                if ((heap->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap->size > largestHeap)
+                        largestHeap = heap->size;
+        }
+
+        const VkDeviceSize heapGiB = largestHeap >> 30;
+        score += DEVICE_HEAP_SCORE_PER_GIB
+                * (uint32_t) (heapGiB < DEVICE_HEAP_SCORE_MAX_GIB ? heapGiB : DEVICE_HEAP_SCORE_MAX_GIB);
+
+        VkPhysicalDeviceFeatures features;
+        vkGetPhysicalDeviceFeatures(device, &features);
+
+        const QueueFamilyIndices indices = findQueueFamilies(device, surface);
+        const bool optionalFeatures[] = {
+                features.multiDrawIndirect,
+                features.drawIndirectFirstInstance,
+                checkDeviceExtensionSupport(
+                        device,
+                        OPTIONAL_DEVICE_EXTENSIONS,
+                        OPTIONAL_DEVICE_EXTENSION_COUNT
+                ),
+                checkDeviceExtensionSupport(
+                        device,
+                        DYNAMIC_RENDERING_EXTENSIONS,
+                        DYNAMIC_RENDERING_EXTENSION_COUNT
+                ),
+                indices.transferFamily != indices.graphicsFamily,
+                indices.asyncComputeFamily != -1,
+        };
+
+        for (uint32_t i = 0; i < sizeof(optionalFeatures) / sizeof(optionalFeatures[0]); i++) {
+                if (optionalFeatures[i])
+                        score += DEVICE_FEATURE_SCORE;
+        }
+
+        return score;
+}
+
+// Matches part of the device name, or the whole device UUID as hex digits
+// with or without dashes
+static const bool deviceMatches(VkPhysicalDevice device, const char *name)
+{
+        VkPhysicalDeviceIDProperties idProperties = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        };
+
+        VkPhysicalDeviceProperties2 properties = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                .pNext = &idProperties,
+        };
+
+        vkGetPhysicalDeviceProperties2(device, &properties);
+        if (strstr(properties.properties.deviceName, name) != NULL)
+                return true;
+
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+                snprintf(&uuid[i * 2], 3, "%02x", idProperties.deviceUUID[i]);
+
+        uint32_t digits = 0;
+        for (const char *c = name; *c != '\0'; c++) {
+                if (*c == '-')
+                        continue;
+
+                if (digits == VK_UUID_SIZE * 2 || tolower((unsigned char) *c) != uuid[digits])
+                        return false;
+
+                digits++;
+        }
+
+        return digits == VK_UUID_SIZE * 2;
+}
+
 static const Result pickPhysicalDevice(App *app)
 {
         uint32_t deviceCount = 0;
@@ -488,13 +826,29 @@ static const Result pickPhysicalDevice(App *app)
         VkPhysicalDevice devices[deviceCount];
         vkEnumeratePhysicalDevices(app->instance, &deviceCount, devices);
 
+        // An override narrows the choice down, the score still decides
+        // between devices that match it
+        const char *override = app->config.deviceOverride;
+        bool matched = false;
+        uint32_t bestScore = 0;
         for (int i = 0; i < deviceCount; i++) {
-                if (isDeviceSuitable(devices[i], app->surface)) {
+                if (override && !deviceMatches(devices[i], override))
+                        continue;
+
+                matched = true;
+                if (!isDeviceSuitable(devices[i], app->surface))
+                        continue;
+
+                const uint32_t score = rateDevice(devices[i], app->surface);
+                if (score > bestScore) {
+                        bestScore = score;
                         app->physicalDevice = devices[i];
-                        break;
                 }
         }
 
+        if (override && !matched)
+                return RESULT_ERROR(-1, "no GPU matches the requested device!");
+
         if (app->physicalDevice == NULL)
                 return RESULT_ERROR(-1, "failed to find a suitable GPU!");
         
@@ -508,16 +862,24 @@ static const Result createLogicalDevice(App *app)
                 app->surface
         );
 
-        #define QUEUE_COUNT 2
+        const bool asyncCompute = indices.asyncComputeFamily != -1
+                && !app->config.noAsyncCompute;
+
+        #define QUEUE_COUNT 4
         VkDeviceQueueCreateInfo queueCreateInfos[QUEUE_COUNT];
-        uint32_t queueFamilies[QUEUE_COUNT] = {
-                indices.graphicsFamily,
-                indices.presentFamily,
-        };
+        uint32_t queueFamilies[QUEUE_COUNT];
+        uint32_t queueFamilyCount = 0;
+        queueFamilies[queueFamilyCount++] = indices.graphicsFamily;
+        queueFamilies[queueFamilyCount++] = indices.transferFamily;
+        if (asyncCompute)
+                queueFamilies[queueFamilyCount++] = indices.asyncComputeFamily;
+
+        if (!app->config.headless)
+                queueFamilies[queueFamilyCount++] = indices.presentFamily;
 
         const float queuePriority = 1.0;
         uint32_t uniqueCount = 0;
-        for (int i = 0; i < QUEUE_COUNT; i++) {
+        for (int i = 0; i < queueFamilyCount; i++) {
                 bool unique = true;
                 for (int j = 0; j < uniqueCount; j++) {
                         if (queueFamilies[i] ==
@@ -539,15 +901,152 @@ static const Result createLogicalDevice(App *app)
                 };
         }
 
-        const VkPhysicalDeviceFeatures deviceFeatures = {};
+        const char *extensions[
+                DEVICE_EXTENSION_COUNT
+                + OPTIONAL_DEVICE_EXTENSION_COUNT
+                + PRESENT_TIMING_EXTENSION_COUNT
+                + DYNAMIC_RENDERING_EXTENSION_COUNT
+        ];
+        uint32_t extensionCount = 0;
+        if (!app->config.headless) {
+                for (uint32_t i = 0; i < DEVICE_EXTENSION_COUNT; i++)
+                        extensions[extensionCount++] = DEVICE_EXTENSIONS[i];
+        }
+
+        bool drawIndirectCount = false;
+        for (uint32_t i = 0; i < OPTIONAL_DEVICE_EXTENSION_COUNT; i++) {
+                if (!checkDeviceExtensionSupport(
+                        app->physicalDevice,
+                        &OPTIONAL_DEVICE_EXTENSIONS[i],
+                        1
+                )) {
+                        continue;
+                }
+
+                extensions[extensionCount++] = OPTIONAL_DEVICE_EXTENSIONS[i];
+                if (strcmp(OPTIONAL_DEVICE_EXTENSIONS[i], VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+                        drawIndirectCount = true;
+        }
+
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+        };
+
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+                .pNext = &synchronization2Features,
+        };
+
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+                .pNext = &dynamicRenderingFeatures,
+        };
+
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+                .pNext = &presentWaitFeatures,
+        };
+
+        VkPhysicalDeviceFeatures2 supportedFeatures = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &presentIdFeatures,
+        };
+
+        vkGetPhysicalDeviceFeatures2(app->physicalDevice, &supportedFeatures);
+
+        // Only what the GPU culling path and texture samplers use, and only
+        // where available
+        app->enabledFeatures = (VkPhysicalDeviceFeatures) {
+                .multiDrawIndirect = supportedFeatures.features.multiDrawIndirect,
+                .drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance,
+                .samplerAnisotropy = supportedFeatures.features.samplerAnisotropy,
+        };
+
+        const bool presentTiming = !app->config.headless
+                && presentIdFeatures.presentId
+                && presentWaitFeatures.presentWait
+                && checkDeviceExtensionSupport(
+                        app->physicalDevice,
+                        PRESENT_TIMING_EXTENSIONS,
+                        PRESENT_TIMING_EXTENSION_COUNT
+                );
+
+        VkPhysicalDevicePresentWaitFeaturesKHR enabledPresentWait = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+                .presentWait = VK_TRUE,
+        };
+
+        VkPhysicalDevicePresentIdFeaturesKHR enabledPresentId = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+                .pNext = &enabledPresentWait,
+                .presentId = VK_TRUE,
+        };
+
+        if (presentTiming) {
+                for (uint32_t i = 0; i < PRESENT_TIMING_EXTENSION_COUNT; i++)
+                        extensions[extensionCount++] = PRESENT_TIMING_EXTENSIONS[i];
+        }
+
+        const bool dynamicRendering = !app->config.renderPass
+                && dynamicRenderingFeatures.dynamicRendering
+                && synchronization2Features.synchronization2
+                && checkDeviceExtensionSupport(
+                        app->physicalDevice,
+                        DYNAMIC_RENDERING_EXTENSIONS,
+                        DYNAMIC_RENDERING_EXTENSION_COUNT
+                );
+
+        VkPhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2 = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+                .pNext = presentTiming ? &enabledPresentId : NULL,
+                .synchronization2 = VK_TRUE,
+        };
+
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRendering = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
+                .pNext = &enabledSynchronization2,
+                .dynamicRendering = VK_TRUE,
+        };
+
+        if (dynamicRendering) {
+                for (uint32_t i = 0; i < DYNAMIC_RENDERING_EXTENSION_COUNT; i++)
+                        extensions[extensionCount++] = DYNAMIC_RENDERING_EXTENSIONS[i];
+        }
+
+        app->descriptorIndexing = supportsDescriptorIndexing(app->physicalDevice);
+
+        void *const enabledRendering = dynamicRendering
+                ? (void *) &enabledDynamicRendering
+                : enabledSynchronization2.pNext;
+
+        VkPhysicalDeviceDescriptorIndexingFeatures enabledDescriptorIndexing = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+                .pNext = enabledRendering,
+                .runtimeDescriptorArray = VK_TRUE,
+                .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+                .descriptorBindingPartiallyBound = VK_TRUE,
+                .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+                .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+                .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+        };
+
+        // Timeline semaphores are checked by isDeviceSuitable
+        VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimeline = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+                .pNext = app->descriptorIndexing
+                        ? (void *) &enabledDescriptorIndexing
+                        : enabledRendering,
+                .timelineSemaphore = VK_TRUE,
+        };
 
         VkDeviceCreateInfo createInfo = {
                 .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+                .pNext = &enabledTimeline,
                 .queueCreateInfoCount = uniqueCount,
                 .pQueueCreateInfos = queueCreateInfos,
-                .pEnabledFeatures = &deviceFeatures,
-                .enabledExtensionCount = DEVICE_EXTENSION_COUNT,
-                .ppEnabledExtensionNames = DEVICE_EXTENSIONS,
+                .pEnabledFeatures = &app->enabledFeatures,
+                .enabledExtensionCount = extensionCount,
+                .ppEnabledExtensionNames = extensions,
                 .enabledLayerCount = 0,
         };
 
@@ -576,11 +1075,54 @@ static const Result createLogicalDevice(App *app)
 
         vkGetDeviceQueue(
                 app->device,
-                indices.presentFamily,
+                indices.transferFamily,
                 0, // single queue
-                &app->presentQueue
+                &app->transferQueue
         );
 
+        app->computeQueue = VK_NULL_HANDLE;
+        app->asyncComputeFamily = indices.asyncComputeFamily;
+        if (asyncCompute) {
+                vkGetDeviceQueue(
+                        app->device,
+                        indices.asyncComputeFamily,
+                        0, // single queue
+                        &app->computeQueue
+                );
+        }
+
+        app->graphicsFamily = indices.graphicsFamily;
+        app->transferFamily = indices.transferFamily;
+        app->computeFamily = indices.computeFamily;
+
+        if (drawIndirectCount) {
+                app->cmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)
+                        vkGetDeviceProcAddr(app->device, "vkCmdDrawIndexedIndirectCountKHR");
+        }
+
+        if (presentTiming) {
+                app->waitForPresent = (PFN_vkWaitForPresentKHR)
+                        vkGetDeviceProcAddr(app->device, "vkWaitForPresentKHR");
+        }
+
+        if (dynamicRendering) {
+                app->cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)
+                        vkGetDeviceProcAddr(app->device, "vkCmdBeginRenderingKHR");
+                app->cmdEndRendering = (PFN_vkCmdEndRenderingKHR)
+                        vkGetDeviceProcAddr(app->device, "vkCmdEndRenderingKHR");
+                app->cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)
+                        vkGetDeviceProcAddr(app->device, "vkCmdPipelineBarrier2KHR");
+        }
+
+        if (!app->config.headless) {
+                vkGetDeviceQueue(
+                        app->device,
+                        indices.presentFamily,
+                        0, // single queue
+                        &app->presentQueue
+                );
+        }
+
         return RESULT_SUCCESS;
 }
 
@@ -596,18 +1138,6 @@ static const VkSurfaceFormatKHR chooseSwapSurfaceFormat(
         return availableFormats[0];
 }
 
-static const VkPresentModeKHR chooseSwapPresentMode(
-        const VkPresentModeKHR *availablePresentModes,
-        uint32_t presentModeCount
-) {
-        for (int i = 0; i < presentModeCount; i++)  {
-                if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
-                        return availablePresentModes[i];
-        }
-
-        return VK_PRESENT_MODE_FIFO_KHR;
-}
-
 static const VkExtent2D chooseSwapExtent(
         GLFWwindow *window,
         const VkSurfaceCapabilitiesKHR capabilities
@@ -640,7 +1170,8 @@ static const Result createSwapchain(App *app)
                 swapchainSupport.formatCount
         );
 
-        const VkPresentModeKHR presentMode = chooseSwapPresentMode(
+        const VkPresentModeKHR presentMode = pacerChoosePresentMode(
+                &app->pacer,
                 swapchainSupport.presentModes,
                 swapchainSupport.presentModeCount
         );
@@ -650,13 +1181,13 @@ static const Result createSwapchain(App *app)
                 swapchainSupport.capabilities
         );
 
-        uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
-        if (swapchainSupport.capabilities.maxImageCount > 0
-                && imageCount > swapchainSupport.capabilities.maxImageCount
-        ) {
-                
-                imageCount = swapchainSupport.capabilities.maxImageCount;
-        }
+        uint32_t imageCount = pacerChooseImageCount(
+                &app->pacer,
+                &swapchainSupport.capabilities
+        );
+
+        if (imageCount > MAX_COMMAND_SLOTS)
+                imageCount = MAX_COMMAND_SLOTS;
 
         QueueFamilyIndices indices = findQueueFamilies(
                 app->physicalDevice,
@@ -668,6 +1199,10 @@ static const Result createSwapchain(App *app)
                 indices.presentFamily,
         };
 
+        // Handing over the old swapchain lets the driver reuse its resources
+        // and keep presenting while the new one comes up
+        const VkSwapchainKHR oldSwapchain = app->swapchain;
+
         VkSwapchainCreateInfoKHR createInfo = {
                 .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
                 .surface = app->surface,
@@ -681,7 +1216,7 @@ static const Result createSwapchain(App *app)
                 .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
                 .presentMode = presentMode,
                 .clipped = VK_TRUE,
-                .oldSwapchain = VK_NULL_HANDLE,
+                .oldSwapchain = oldSwapchain,
         };
 
         if (indices.graphicsFamily != indices.presentFamily) {
@@ -703,9 +1238,13 @@ static const Result createSwapchain(App *app)
         if (result != VK_SUCCESS)
                 return RESULT_ERROR(result, "failed to create swapchain!");
 
+        app->presentMode = presentMode;
         vkGetSwapchainImagesKHR(app->device, app->swapchain, &imageCount, NULL);
         app->swapchainImageCount = imageCount;
 
+        if (imageCount > MAX_COMMAND_SLOTS)
+                return RESULT_ERROR(-1, "swapchain has more images than command slots!");
+
         app->swapchainImages = malloc(sizeof(VkImage) * app->swapchainImageCount);
         
         vkGetSwapchainImagesKHR(
@@ -759,49 +1298,28 @@ static const Result createImageViews(App *app)
         return RESULT_SUCCESS;
 }
 
-static const Result readFile(const char *fname, uint32_t *pfsize)
+static const Result createShaderModule(const App *app, const char *name)
 {
-        FILE *fp = fopen(fname, "rb+");
-        if (!fp) {
-                char errmsg[64];
-                sprintf(errmsg, "failed to open file: %s", fname);
-                return RESULT_ERROR(-1, errmsg);
-        }
-
-        fseek(fp, 0l, SEEK_END);
-        *pfsize = (uint32_t) ftell(fp);
-        rewind(fp);
-
-        char *fcontent = malloc(*pfsize * sizeof(char));
-        fread(fcontent, 1, *pfsize, fp);
-
-        fclose(fp);
-        return (Result) {
-                .code = 0,
-                .data = (char *) fcontent,
-        };
-}
+        ShaderCode code;
+        Result res;
+        handle(shaderLoad(app->config.shaderDir, name, &code));
 
-static const Result createShaderModule(
-        VkDevice device,
-        const char *code,
-        uint32_t fsize
-) {
-        printf("File size: %d\n", fsize);
         VkShaderModuleCreateInfo createInfo = {
                 .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-                .codeSize = fsize,
-                .pCode = (const uint32_t *) code,
+                .codeSize = code.size,
+                .pCode = code.code,
         };
 
         VkShaderModule shaderModule;
         VkResult result = vkCreateShaderModule(
-                device,
+                app->device,
                 &createInfo,
                 NULL,
                 &shaderModule
         );
 
+        shaderRelease(&code);
+
         if (result != VK_SUCCESS)
                 return RESULT_ERROR(result, "failed to create shader module!");
 
@@ -811,8 +1329,22 @@ static const Result createShaderModule(
         };
 }
 
+static const VkImageLayout presentLayout(const App *app)
+{
+        if (!app->config.headless)
+                return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        return app->config.readbackPath
+                ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+}
+
 static const Result createRenderPass(App *app)
 {
+        // Attachments are described when rendering begins instead
+        if (app->cmdBeginRendering)
+                return RESULT_SUCCESS;
+
         const VkAttachmentDescription colorAttachment = {
                 .format = app->swapchainImageFormat,
                 .samples = VK_SAMPLE_COUNT_1_BIT,
@@ -821,7 +1353,7 @@ static const Result createRenderPass(App *app)
                 .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
                 .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                .finalLayout = presentLayout(app),
         };
 
         const VkAttachmentReference colorAttachmentRef = {
@@ -835,13 +1367,24 @@ static const Result createRenderPass(App *app)
                 .pColorAttachments = &colorAttachmentRef,
         };
 
-        const VkSubpassDependency dependency = {
-                .srcSubpass = VK_SUBPASS_EXTERNAL,
-                .dstSubpass = 0,
-                .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                .srcAccessMask = 0,
-                .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        const VkSubpassDependency dependencies[] = {
+                {
+                        .srcSubpass = VK_SUBPASS_EXTERNAL,
+                        .dstSubpass = 0,
+                        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        .srcAccessMask = 0,
+                        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                },
+                // Readback copies the attachment out right after the pass
+                {
+                        .srcSubpass = 0,
+                        .dstSubpass = VK_SUBPASS_EXTERNAL,
+                        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                },
         };
 
         const VkRenderPassCreateInfo renderPassInfo = {
@@ -850,8 +1393,8 @@ static const Result createRenderPass(App *app)
                 .pAttachments = &colorAttachment,
                 .subpassCount = 1,
                 .pSubpasses = &subpass,
-                .dependencyCount = 1,
-                .pDependencies = &dependency,
+                .dependencyCount = app->config.readbackPath ? 2 : 1,
+                .pDependencies = dependencies,
         };
 
         const VkResult result = vkCreateRenderPass(
@@ -867,49 +1410,202 @@ static const Result createRenderPass(App *app)
         return RESULT_SUCCESS;
 }
 
-static const Result createGraphicsPipeline(App *app)
-{
-        uint32_t vertSize;
-        uint32_t fragSize;
+// Room in each uniform ring region for per-frame data beyond the frame and
+// draw uniforms, alignment padding included
+static const VkDeviceSize UNIFORM_RING_HEADROOM = 64 * 1024;
+
+#define FRAME_BINDING_COUNT 2
+
+// Push constants for every draw through the graphics pipeline
+typedef struct {
+        uint32_t drawIndex; // into the DrawUniforms
+        uint32_t textureIndex; // bindless slot, BINDLESS_INVALID for none
+} DrawParams;
 
-        const Result vertShaderResult = readFile("shaders/vert.spv", &vertSize);
-        if (vertShaderResult.code != 0)
-                return vertShaderResult;
+// Descriptor counts asked of the bindless heap, before device limits
+static const uint32_t BINDLESS_TEXTURE_CAPACITY = 16384;
+static const uint32_t BINDLESS_BUFFER_CAPACITY = 4096;
 
-        const Result fragShaderResult = readFile("shaders/frag.spv", &fragSize);
-        if (fragShaderResult.code != 0)
-                return fragShaderResult;
+// Without descriptor indexing the heap stays empty, and the textures and
+// quads that would need it are dropped
+static const Result createBindlessHeap(App *app)
+{
+        if (!app->descriptorIndexing) {
+                if (app->config.textureFileCount > 0 || app->config.quadCount > 0)
+                        fprintf(stderr, "WARN: no descriptor indexing, textures and quads will not be drawn.\n");
 
-        char *vertShaderCode = vertShaderResult.data;
-        char *fragShaderCode = fragShaderResult.data;
+                app->config.textureFileCount = 0;
+                app->config.quadCount = 0;
+                return RESULT_SUCCESS;
+        }
 
-        const Result vertModuleResult = createShaderModule(
+        return bindlessCreate(
+                &app->bindless,
                 app->device,
-                vertShaderCode,
-                vertSize
+                app->physicalDevice,
+                BINDLESS_TEXTURE_CAPACITY,
+                BINDLESS_BUFFER_CAPACITY
         );
-        if (vertModuleResult.code != 0)
-                return vertModuleResult;
+}
+
+static const Result createPipelineLayout(App *app)
+{
+        // Both bindings point into the uniform ring and move with the
+        // dynamic offsets, so the set never needs rewriting
+        const VkDescriptorSetLayoutBinding bindings[FRAME_BINDING_COUNT] = {
+                {
+                        .binding = 0,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                },
+                {
+                        .binding = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+                },
+        };
 
-        const Result fragModuleResult = createShaderModule(
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .bindingCount = FRAME_BINDING_COUNT,
+                .pBindings = bindings,
+        };
+
+        const VkResult setLayoutResult = vkCreateDescriptorSetLayout(
                 app->device,
-                fragShaderCode,
-                fragSize
+                &setLayoutInfo,
+                NULL,
+                &app->frameSetLayout
         );
-        if (fragModuleResult.code != 0)
-                return fragModuleResult;
 
-        VkShaderModule vertShaderModule = vertModuleResult.data;
-        VkShaderModule fragShaderModule = fragModuleResult.data;
+        if (setLayoutResult != VK_SUCCESS)
+                return RESULT_ERROR(setLayoutResult, "failed to create frame descriptor set layout!");
 
-        const VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                .module = vertShaderModule,
-                .pName = "main",
+        const VkPushConstantRange pushConstantRange = {
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+                        | VK_SHADER_STAGE_FRAGMENT_BIT,
+                .offset = 0,
+                .size = sizeof(DrawParams),
         };
 
-        const VkPipelineShaderStageCreateInfo fragShaderStageInfo = {
+        // Set 1 is the bindless heap, bound alongside the frame set
+        const VkDescriptorSetLayout setLayouts[] = {
+                app->frameSetLayout,
+                app->bindless.setLayout,
+        };
+
+        const VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = app->descriptorIndexing ? 2 : 1,
+                .pSetLayouts = setLayouts,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange,
+        };
+
+        const VkResult pipelineLayoutResult = vkCreatePipelineLayout(
+                app->device,
+                &pipelineLayoutInfo,
+                NULL,
+                &app->pipelineLayout
+        );
+
+        if (pipelineLayoutResult != VK_SUCCESS) {
+                return RESULT_ERROR(
+                        pipelineLayoutResult,
+                        "failed to create pipeline layout!"
+                );
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Dynamic rendering builds pipelines against the swapchain format, where
+// the render pass path has it in the render pass
+static uint32_t pipelineColorFormat(const App *app)
+{
+        return app->cmdBeginRendering ? app->swapchainImageFormat : VK_FORMAT_UNDEFINED;
+}
+
+// The scene's own state: the mesh and instance layout, opaque, back faces
+// culled. Every other state starts from it.
+static void defaultPipelineState(const App *app, PipelineState *state)
+{
+        memset(state, 0, sizeof(PipelineState));
+        strcpy(state->vertexShader, "vert");
+        strcpy(state->fragmentShader, app->descriptorIndexing ? "frag" : "frag_untextured");
+        state->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        state->polygonMode = VK_POLYGON_MODE_FILL;
+        state->cullMode = VK_CULL_MODE_BACK_BIT;
+        state->frontFace = VK_FRONT_FACE_CLOCKWISE;
+        state->blend = PIPELINE_BLEND_OPAQUE;
+        state->colorFormat = pipelineColorFormat(app);
+        state->bindingCount = VERTEX_BINDING_COUNT;
+        vertexGetBindingDescriptions(&app->mesh, state->bindings);
+        state->attributeCount = vertexGetAttributeDescriptions(&app->mesh, state->attributes);
+}
+
+// Variant 0 is the default state; the rest add culling off and alpha or
+// additive blending in turn
+static void variantPipelineState(const App *app, uint32_t variant, PipelineState *state)
+{
+        *state = app->pipelineState;
+        state->cullMode = variant % 2 == 0 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+        state->blend = (variant / 2) % PIPELINE_BLEND_COUNT;
+}
+
+static VkPipelineColorBlendAttachmentState blendAttachment(PipelineBlend blend)
+{
+        VkPipelineColorBlendAttachmentState attachment = {
+                .colorWriteMask =
+                        VK_COLOR_COMPONENT_R_BIT
+                        | VK_COLOR_COMPONENT_G_BIT
+                        | VK_COLOR_COMPONENT_B_BIT
+                        | VK_COLOR_COMPONENT_A_BIT,
+                .blendEnable = blend != PIPELINE_BLEND_OPAQUE,
+                .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+                .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                .colorBlendOp = VK_BLEND_OP_ADD,
+                .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+                .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                .alphaBlendOp = VK_BLEND_OP_ADD,
+        };
+
+        if (blend == PIPELINE_BLEND_ADDITIVE) {
+                attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+                attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        }
+
+        return attachment;
+}
+
+// Reads nothing of the app that changes after init beyond the shader
+// source; the colour format comes with the state. So the hot reload and
+// pipeline compile threads can call it too.
+static const Result buildPipeline(const App *app, const PipelineState *state, VkPipeline *pPipeline)
+{
+        const Result vertModuleResult = createShaderModule(app, state->vertexShader);
+        if (vertModuleResult.code != 0)
+                return vertModuleResult;
+
+        const Result fragModuleResult = createShaderModule(app, state->fragmentShader);
+        if (fragModuleResult.code != 0) {
+                vkDestroyShaderModule(app->device, vertModuleResult.data, NULL);
+                return fragModuleResult;
+        }
+
+        VkShaderModule vertShaderModule = vertModuleResult.data;
+        VkShaderModule fragShaderModule = fragModuleResult.data;
+
+        const VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = vertShaderModule,
+                .pName = "main",
+        };
+
+        const VkPipelineShaderStageCreateInfo fragShaderStageInfo = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
                 .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
                 .module = fragShaderModule,
@@ -921,39 +1617,20 @@ static const Result createGraphicsPipeline(App *app)
                 fragShaderStageInfo,
         };
 
-        const VkVertexInputBindingDescription bindingDesc = vertexGetBindingDescription();
-        uint32_t attrDescCount = 2;
-        VkVertexInputAttributeDescription attrDescs[attrDescCount];
-        vertexGetAttributeDescriptions(attrDescs);
-
         const VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-                .vertexBindingDescriptionCount = 1,
-                .pVertexBindingDescriptions = &bindingDesc,
-                .vertexAttributeDescriptionCount = attrDescCount,
-                .pVertexAttributeDescriptions = attrDescs,
+                .vertexBindingDescriptionCount = state->bindingCount,
+                .pVertexBindingDescriptions = state->bindings,
+                .vertexAttributeDescriptionCount = state->attributeCount,
+                .pVertexAttributeDescriptions = state->attributes,
         };
 
         const VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-                .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                .topology = state->topology,
                 .primitiveRestartEnable = VK_FALSE,
         };
 
-        const VkViewport viewport = {
-                .x = 0.0f,
-                .y = 0.0f,
-                .width = (float) app->swapchainExtent.width,
-                .height = (float) app->swapchainExtent.height,
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
-        };
-
-        const VkRect2D scissor = {
-                .offset = { .x = 0, .y = 0 },
-                .extent = app->swapchainExtent,
-        };
-
         uint32_t dynamicStateCount = 2;
         const VkDynamicState dynamicStates[] = {
                 VK_DYNAMIC_STATE_VIEWPORT,
@@ -966,22 +1643,21 @@ static const Result createGraphicsPipeline(App *app)
                 .pDynamicStates = dynamicStates,
         };
 
+        // Both are dynamic, so the pipeline does not depend on the swapchain
         const VkPipelineViewportStateCreateInfo viewportState = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
                 .viewportCount = 1,
-                .pViewports = &viewport,
                 .scissorCount = 1,
-                .pScissors = &scissor,
         };
 
         const VkPipelineRasterizationStateCreateInfo rasterizer = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
                 .depthClampEnable = VK_FALSE,
                 .rasterizerDiscardEnable = VK_FALSE,
-                .polygonMode = VK_POLYGON_MODE_FILL,
+                .polygonMode = state->polygonMode,
                 .lineWidth = 1.0f,
-                .cullMode = VK_CULL_MODE_BACK_BIT,
-                .frontFace = VK_FRONT_FACE_CLOCKWISE,
+                .cullMode = state->cullMode,
+                .frontFace = state->frontFace,
                 .depthBiasEnable = VK_FALSE,
         };
 
@@ -991,14 +1667,7 @@ static const Result createGraphicsPipeline(App *app)
                 .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
         };
 
-        const VkPipelineColorBlendAttachmentState colorBlendAttachment = {
-                .colorWriteMask =
-                        VK_COLOR_COMPONENT_R_BIT
-                        | VK_COLOR_COMPONENT_G_BIT
-                        | VK_COLOR_COMPONENT_B_BIT
-                        | VK_COLOR_COMPONENT_A_BIT,
-                .blendEnable = VK_FALSE,
-        };
+        const VkPipelineColorBlendAttachmentState colorBlendAttachment = blendAttachment(state->blend);
 
         const VkPipelineColorBlendStateCreateInfo colorBlending = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
@@ -1007,26 +1676,16 @@ static const Result createGraphicsPipeline(App *app)
                 .pAttachments = &colorBlendAttachment,
         };
 
-        const VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        const VkFormat colorFormat = state->colorFormat;
+        const VkPipelineRenderingCreateInfoKHR renderingInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR,
+                .colorAttachmentCount = 1,
+                .pColorAttachmentFormats = &colorFormat,
         };
 
-        const VkResult pipelineLayoutResult = vkCreatePipelineLayout(
-                app->device,
-                &pipelineLayoutInfo,
-                NULL,
-                &app->pipelineLayout
-        );
-
-        if (pipelineLayoutResult != VK_SUCCESS) {
-                return RESULT_ERROR(
-                        pipelineLayoutResult,
-                        "failed to create pipeline layout!"
-                );
-        }
-
         const VkGraphicsPipelineCreateInfo pipelineInfo = {
                 .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                .pNext = app->cmdBeginRendering ? &renderingInfo : NULL,
                 .stageCount = 2,
                 .pStages = shaderStages,
                 .pVertexInputState = &vertexInputInfo,
@@ -1046,506 +1705,3133 @@ static const Result createGraphicsPipeline(App *app)
 
         VkResult result = vkCreateGraphicsPipelines(
                 app->device,
-                NULL,
+                app->pipelineCache,
                 1,
                 &pipelineInfo,
                 NULL,
-                &app->graphicsPipeline
+                pPipeline
         );
 
+        vkDestroyShaderModule(app->device, fragShaderModule, NULL);
+        vkDestroyShaderModule(app->device, vertShaderModule, NULL);
+
         if (result != VK_SUCCESS)
                 return RESULT_ERROR(result, "failed to create graphics pipeline!");
 
-        vkDestroyShaderModule(app->device, fragShaderModule, NULL);
-        vkDestroyShaderModule(app->device, vertShaderModule, NULL);
-        free(fragShaderCode);
-        free(vertShaderCode);
         return RESULT_SUCCESS;
 }
 
-static const Result createFramebuffers(App *app)
+static const Result createGraphicsPipeline(App *app)
 {
-        app->swapchainFramebuffers = malloc(
-                app->swapchainImageCount * sizeof(VkFramebuffer)
-        );
+        Result res;
+        handle(createPipelineLayout(app));
 
-        for (int i = 0; i < app->swapchainImageCount; i++) {
-                const VkImageView attachments[] = {
-                        app->swapchainImageViews[i],
-                };
+        defaultPipelineState(app, &app->pipelineState);
 
-                const VkFramebufferCreateInfo createInfo = {
-                        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-                        .renderPass = app->renderPass,
-                        .attachmentCount = 1,
-                        .pAttachments = attachments,
-                        .width = app->swapchainExtent.width,
-                        .height = app->swapchainExtent.height,
-                        .layers = 1,
+        const double pipelineStart = benchNowMs();
+        VkPipeline pipeline;
+        handle(buildPipeline(app, &app->pipelineState, &pipeline));
+        benchSetValue(&app->bench, "pipelineCreateMs", benchNowMs() - pipelineStart);
+
+        handle(registryAddPipeline(
+                &app->registry,
+                pipeline,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                &app->graphicsPipeline
+        ));
+
+        return RESULT_SUCCESS;
+}
+
+static const Result buildPipelineVariant(
+        void *userData,
+        const PipelineState *state,
+        VkPipeline *pPipeline
+) {
+        return buildPipeline(userData, state, pPipeline);
+}
+
+// Sprites are unculled and blended, with the quad batcher's vertex layout
+static void quadPipelineState(const App *app, uint32_t pipeline, PipelineState *state)
+{
+        memset(state, 0, sizeof(PipelineState));
+        strcpy(state->vertexShader, "quad_vert");
+        strcpy(state->fragmentShader, "quad_frag");
+        state->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        state->polygonMode = VK_POLYGON_MODE_FILL;
+        state->cullMode = VK_CULL_MODE_NONE;
+        state->frontFace = VK_FRONT_FACE_CLOCKWISE;
+        state->blend = pipeline == 0 ? PIPELINE_BLEND_ALPHA : PIPELINE_BLEND_ADDITIVE;
+        state->colorFormat = app->pipelineState.colorFormat;
+
+        state->bindingCount = 1;
+        state->bindings[0] = (VkVertexInputBindingDescription) {
+                .binding = 0,
+                .stride = sizeof(QuadVertex),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+        };
+
+        const VkFormat formats[] = {
+                VK_FORMAT_R32G32_SFLOAT,
+                VK_FORMAT_R32G32_SFLOAT,
+                VK_FORMAT_R8G8B8A8_UNORM,
+                VK_FORMAT_R32_UINT,
+        };
+        const uint32_t offsets[] = {
+                offsetof(QuadVertex, position),
+                offsetof(QuadVertex, uv),
+                offsetof(QuadVertex, color),
+                offsetof(QuadVertex, texture),
+        };
+
+        state->attributeCount = sizeof(formats) / sizeof(formats[0]);
+        for (uint32_t i = 0; i < state->attributeCount; i++) {
+                state->attributes[i] = (VkVertexInputAttributeDescription) {
+                        .binding = 0,
+                        .location = i,
+                        .format = formats[i],
+                        .offset = offsets[i],
                 };
+        }
+}
 
-                VkResult result = vkCreateFramebuffer(
-                        app->device,
-                        &createInfo,
-                        NULL,
-                        &app->swapchainFramebuffers[i]
-                );
+static const Result createQuadPipelines(App *app)
+{
+        if (app->config.quadCount == 0)
+                return RESULT_SUCCESS;
 
-                if (result != VK_SUCCESS)
-                        return RESULT_ERROR(result, "failed to create framebuffer!");
+        Result res;
+        for (uint32_t i = 0; i < QUAD_PIPELINE_COUNT; i++) {
+                PipelineState state;
+                quadPipelineState(app, i, &state);
+
+                VkPipeline pipeline;
+                handle(buildPipeline(app, &state, &pipeline));
+                handle(registryAddPipeline(
+                        &app->registry,
+                        pipeline,
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        &app->quadPipelines[i]
+                ));
         }
 
         return RESULT_SUCCESS;
 }
 
-static const Result createCommandPool(App *app)
+#define PIPELINE_COMPILE_THREADS 2
+
+// Variants beyond the default compile in the background
+static const Result createPipelineVariants(App *app)
 {
-        const QueueFamilyIndices queueFamilyIndices = findQueueFamilies(
-                app->physicalDevice,
-                app->surface
+        if (app->config.pipelineVariants < 2)
+                return RESULT_SUCCESS;
+
+        return pipelineStateCacheCreate(
+                &app->pipelineStates,
+                app->device,
+                MAX_PIPELINE_VARIANTS,
+                PIPELINE_COMPILE_THREADS,
+                buildPipelineVariant,
+                app
         );
+}
 
-        const VkCommandPoolCreateInfo createInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-                .queueFamilyIndex = queueFamilyIndices.graphicsFamily,
+// std430 layout of CullObject in cull.comp
+typedef struct {
+        vec4 sphere; // xyz centre, w radius
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t instanceIndex;
+} CullObject;
+
+typedef struct {
+        vec4 planes[6];
+        uint32_t objectCount;
+        uint32_t compact;
+} CullParams;
+
+#define CULL_BINDING_COUNT 3
+
+static const Result buildCullPipeline(const App *app, VkPipeline *pPipeline)
+{
+        const Result compModuleResult = createShaderModule(app, "cull");
+        if (compModuleResult.code != 0)
+                return compModuleResult;
+
+        VkShaderModule compShaderModule = compModuleResult.data;
+
+        const VkComputePipelineCreateInfo pipelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage = {
+                        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                        .module = compShaderModule,
+                        .pName = "main",
+                },
+                .layout = app->cullPipelineLayout,
         };
 
-        const VkResult result = vkCreateCommandPool(
+        const VkResult result = vkCreateComputePipelines(
                 app->device,
-                &createInfo,
+                app->pipelineCache,
+                1,
+                &pipelineInfo,
                 NULL,
-                &app->commandPool
+                pPipeline
         );
 
+        vkDestroyShaderModule(app->device, compShaderModule, NULL);
+
         if (result != VK_SUCCESS)
-                return RESULT_ERROR(result, "failed to create command pool");
-        
+                return RESULT_ERROR(result, "failed to create cull pipeline!");
+
         return RESULT_SUCCESS;
 }
 
-static const Result findMemoryType(
-        const VkPhysicalDevice physicalDevice,
-        const uint32_t typeFilter,
-        const VkMemoryPropertyFlags properties,
-        uint32_t *pMemType
-) {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-                if (typeFilter & (1 << i)
-                        && (memProperties.memoryTypes[i].propertyFlags & properties)
-                                == properties
-                ) {
-                        *pMemType = i;
-                        return RESULT_SUCCESS;
-                }
+static const Result createCullPipeline(App *app)
+{
+        VkDescriptorSetLayoutBinding bindings[CULL_BINDING_COUNT];
+        for (uint32_t i = 0; i < CULL_BINDING_COUNT; i++) {
+                bindings[i] = (VkDescriptorSetLayoutBinding) {
+                        .binding = i,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                };
         }
 
-        return RESULT_ERROR(-1, "failed to find suitable memory type!");
-}
-
-static const Result createBuffer(
-        App *app,
-        const VkDeviceSize size,
-        const VkBufferUsageFlags usage,
-        const VkMemoryPropertyFlags properties,
-        VkBuffer *pBuffer,
-        VkDeviceMemory *pBufferMemory
-) {
-        
-        const VkBufferCreateInfo createInfo = {
-                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                .size = size,
-                .usage = usage,
-                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .bindingCount = CULL_BINDING_COUNT,
+                .pBindings = bindings,
         };
 
-        const VkResult createResult = vkCreateBuffer(
+        VkResult result = vkCreateDescriptorSetLayout(
                 app->device,
-                &createInfo,
+                &setLayoutInfo,
                 NULL,
-                pBuffer
+                &app->cullSetLayout
         );
 
-        if (createResult != VK_SUCCESS)
-                return RESULT_ERROR(createResult, "failed to create buffer!");
-
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(app->device, *pBuffer, &memRequirements);
-
-        uint32_t memType;
-        const Result memTypeResult = findMemoryType(
-                app->physicalDevice,
-                memRequirements.memoryTypeBits,
-                properties,
-                &memType
-        );
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create cull descriptor set layout!");
 
-        if (memTypeResult.code != 0)
-                return memTypeResult;
+        const VkPushConstantRange pushConstantRange = {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(CullParams),
+        };
 
-        const VkMemoryAllocateInfo allocInfo = {
-                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                .allocationSize = memRequirements.size,
-                .memoryTypeIndex = memType,
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = 1,
+                .pSetLayouts = &app->cullSetLayout,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange,
         };
 
-        const VkResult allocResult = vkAllocateMemory(
+        result = vkCreatePipelineLayout(
                 app->device,
-                &allocInfo,
+                &layoutInfo,
                 NULL,
-                pBufferMemory
+                &app->cullPipelineLayout
         );
 
-        if (allocResult != VK_SUCCESS)
-                return RESULT_ERROR(allocResult, "failed to allocate buffer memory!");
-        
-        vkBindBufferMemory(app->device, *pBuffer, *pBufferMemory, 0);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create cull pipeline layout!");
 
-        return RESULT_SUCCESS;
+        VkPipeline pipeline;
+        Result res;
+        handle(buildCullPipeline(app, &pipeline));
+        return registryAddPipeline(
+                &app->registry,
+                pipeline,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                &app->cullPipeline
+        );
 }
 
-static const Result copyBuffer(
-        App *app,
-        VkBuffer srcBuffer,
-        VkBuffer dstBuffer,
-        VkDeviceSize size
-) {
-        const VkCommandBufferAllocateInfo allocInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                .commandPool = app->commandPool,
-                .commandBufferCount = 1,
-        };
-
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(app->device, &allocInfo, &commandBuffer);
-
-        const VkCommandBufferBeginInfo beginInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        };
+typedef struct {
+        uint32_t particleCount;
+        uint32_t reset;
+        float deltaSeconds;
+        float size;
+} ParticleParams;
 
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+#define PARTICLE_BINDING_COUNT 2
 
-        const VkBufferCopy copyRegion = {
-                .srcOffset = 0, // optional
-                .dstOffset = 0, // optional
-                .size = size,
+static const Result buildParticlePipeline(const App *app, VkPipeline *pPipeline)
+{
+        const Result compModuleResult = createShaderModule(app, "particles");
+        if (compModuleResult.code != 0)
+                return compModuleResult;
+
+        VkShaderModule compShaderModule = compModuleResult.data;
+
+        const VkComputePipelineCreateInfo pipelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage = {
+                        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                        .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                        .module = compShaderModule,
+                        .pName = "main",
+                },
+                .layout = app->particlePipelineLayout,
         };
 
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-        vkEndCommandBuffer(commandBuffer);
-
-        const VkSubmitInfo submitInfo = {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &commandBuffer,
-        };
+        const VkResult result = vkCreateComputePipelines(
+                app->device,
+                app->pipelineCache,
+                1,
+                &pipelineInfo,
+                NULL,
+                pPipeline
+        );
 
-        vkQueueSubmit(app->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(app->graphicsQueue);
+        vkDestroyShaderModule(app->device, compShaderModule, NULL);
 
-        vkFreeCommandBuffers(app->device, app->commandPool, 1, &commandBuffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create particle pipeline!");
 
         return RESULT_SUCCESS;
 }
 
-static const Result createVertexBuffer(App *app)
+// Sits next to the graphics pipeline: the compute step writes what the
+// graphics pipeline then reads as per-instance vertex attributes
+static const Result createParticlePipeline(App *app)
 {
-        const VkDeviceSize bufferSize = sizeof(Vertex) * VERTEX_COUNT;
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        const Result sBufResult = createBuffer(
-                app,
-                bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer,
-                &stagingBufferMemory
+        VkDescriptorSetLayoutBinding bindings[PARTICLE_BINDING_COUNT];
+        for (uint32_t i = 0; i < PARTICLE_BINDING_COUNT; i++) {
+                bindings[i] = (VkDescriptorSetLayoutBinding) {
+                        .binding = i,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = 1,
+                        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                };
+        }
+
+        const VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .bindingCount = PARTICLE_BINDING_COUNT,
+                .pBindings = bindings,
+        };
+
+        VkResult result = vkCreateDescriptorSetLayout(
+                app->device,
+                &setLayoutInfo,
+                NULL,
+                &app->particleSetLayout
         );
 
-        if (sBufResult.code != 0)
-                return sBufResult;
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create particle descriptor set layout!");
 
-        void *data;
-        vkMapMemory(app->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, VERTICES, (size_t) bufferSize);
-        vkUnmapMemory(app->device, stagingBufferMemory);
+        const VkPushConstantRange pushConstantRange = {
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .offset = 0,
+                .size = sizeof(ParticleParams),
+        };
 
-        const Result vBufResult = createBuffer(
-                app,
-                bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &app->vertexBuffer,
-                &app->vertexBufferMemory
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount = 1,
+                .pSetLayouts = &app->particleSetLayout,
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange,
+        };
+
+        result = vkCreatePipelineLayout(
+                app->device,
+                &layoutInfo,
+                NULL,
+                &app->particlePipelineLayout
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create particle pipeline layout!");
+
+        VkPipeline pipeline;
+        Result res;
+        handle(buildParticlePipeline(app, &pipeline));
+        return registryAddPipeline(
+                &app->registry,
+                pipeline,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                &app->particlePipeline
         );
+}
+
+// What a changed shader source rebuilds
+enum {
+        RELOAD_SCENE, // the default pipeline and its variants
+        RELOAD_QUADS,
+        RELOAD_CULL,
+        RELOAD_PARTICLES,
+        RELOAD_TARGET_COUNT,
+};
+
+static const HotReloadShader RELOADED_SHADERS[] = {
+        { "shader.vert", "vert", NULL, RELOAD_SCENE },
+        { "shader.frag", "frag", NULL, RELOAD_SCENE },
+        { "shader.frag", "frag_untextured", "UNTEXTURED", RELOAD_SCENE },
+        { "quad.vert", "quad_vert", NULL, RELOAD_QUADS },
+        { "quad.frag", "quad_frag", NULL, RELOAD_QUADS },
+        { "cull.comp", "cull", NULL, RELOAD_CULL },
+        { "particles.comp", "particles", NULL, RELOAD_PARTICLES },
+};
+
+#define RELOADED_SHADER_COUNT (sizeof(RELOADED_SHADERS) / sizeof(RELOADED_SHADERS[0]))
+
+static bool reloadTargetInUse(const App *app, uint32_t target)
+{
+        switch (target) {
+        case RELOAD_QUADS:
+                return app->config.quadCount > 0;
+        case RELOAD_CULL:
+                return app->config.gpuCull;
+        case RELOAD_PARTICLES:
+                return app->config.particleCount > 0;
+        default:
+                return true;
+        }
+}
+
+static const Result buildReloadedQuadPipelines(
+        const App *app,
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES]
+) {
+        for (uint32_t i = 0; i < QUAD_PIPELINE_COUNT; i++) {
+                PipelineState state;
+                quadPipelineState(app, i, &state);
 
-        if (vBufResult.code != 0)
-                return vBufResult;
+                const Result res = buildPipeline(app, &state, &pipelines[i]);
+                if (res.code != 0) {
+                        for (uint32_t j = 0; j < i; j++)
+                                vkDestroyPipeline(app->device, pipelines[j], NULL);
 
-        copyBuffer(app, stagingBuffer, app->vertexBuffer, bufferSize);
+                        return res;
+                }
+        }
 
-        vkDestroyBuffer(app->device, stagingBuffer, NULL);
-        vkFreeMemory(app->device, stagingBufferMemory, NULL);
         return RESULT_SUCCESS;
 }
 
-static const Result createIndexBuffer(App *app)
+static const Result buildReloadedPipelines(
+        void *userData,
+        uint32_t target,
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES]
+) {
+        const App *app = userData;
+        switch (target) {
+        case RELOAD_SCENE:
+                return buildPipeline(app, &app->pipelineState, &pipelines[0]);
+        case RELOAD_QUADS:
+                return buildReloadedQuadPipelines(app, pipelines);
+        case RELOAD_CULL:
+                return buildCullPipeline(app, &pipelines[0]);
+        case RELOAD_PARTICLES:
+                return buildParticlePipeline(app, &pipelines[0]);
+        default:
+                return RESULT_ERROR(-1, "unknown hot reload target!");
+        }
+}
+
+// Development mode: recompiles the shader sources as they change and swaps
+// the rebuilt pipelines in between frames
+static const Result startHotReload(App *app)
 {
-        VkDeviceSize bufferSize = sizeof(INDICES[0]) * INDEX_COUNT;
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        const Result sBufResult = createBuffer(
-                app,
-                bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer,
-                &stagingBufferMemory
+        if (!app->config.hotReload)
+                return RESULT_SUCCESS;
+
+        // Fresh SPIR-V lands next to the sources, so load from there too
+        if (!app->config.shaderDir)
+                app->config.shaderDir = SHADER_SOURCE_DIR;
+
+        // Sources for pipelines the app never created are left unwatched
+        HotReloadShader shaders[RELOADED_SHADER_COUNT];
+        uint32_t shaderCount = 0;
+        for (uint32_t i = 0; i < RELOADED_SHADER_COUNT; i++) {
+                if (reloadTargetInUse(app, RELOADED_SHADERS[i].target))
+                        shaders[shaderCount++] = RELOADED_SHADERS[i];
+        }
+
+        return hotReloadStart(
+                &app->hotReload,
+                app->device,
+                SHADER_SOURCE_DIR,
+                app->config.shaderDir,
+                shaders,
+                shaderCount,
+                buildReloadedPipelines,
+                app
         );
+}
 
-        if (sBufResult.code != 0)
-                return sBufResult;
+static const char *pipelineCachePath(const App *app)
+{
+        if (app->config.noPipelineCache)
+                return NULL;
 
-        void *data;
-        vkMapMemory(app->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, INDICES, (size_t) bufferSize);
-        vkUnmapMemory(app->device, stagingBufferMemory);
+        return app->config.pipelineCachePath
+                ? app->config.pipelineCachePath
+                : DEFAULT_PIPELINE_CACHE_PATH;
+}
 
-        const Result iBufResult = createBuffer(
-                app,
-                bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                        | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &app->indexBuffer,
-                &app->indexBufferMemory
+static const Result createPipelineCache(App *app)
+{
+        return pipelineCacheLoad(
+                app->physicalDevice,
+                app->device,
+                pipelineCachePath(app),
+                &app->pipelineCache,
+                &app->pipelineCacheWarm
+        );
+}
+
+static const Result createFramebuffers(App *app)
+{
+        // Dynamic rendering draws straight into the image views, so a
+        // resize only has those to rebuild
+        if (app->cmdBeginRendering) {
+                app->swapchainFramebuffers = NULL;
+                return RESULT_SUCCESS;
+        }
+
+        app->swapchainFramebuffers = malloc(
+                app->swapchainImageCount * sizeof(VkFramebuffer)
         );
 
-        if (iBufResult.code != 0)
-                return iBufResult;
+        for (int i = 0; i < app->swapchainImageCount; i++) {
+                const VkImageView attachments[] = {
+                        app->swapchainImageViews[i],
+                };
+
+                const VkFramebufferCreateInfo createInfo = {
+                        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                        .renderPass = app->renderPass,
+                        .attachmentCount = 1,
+                        .pAttachments = attachments,
+                        .width = app->swapchainExtent.width,
+                        .height = app->swapchainExtent.height,
+                        .layers = 1,
+                };
+
+                VkResult result = vkCreateFramebuffer(
+                        app->device,
+                        &createInfo,
+                        NULL,
+                        &app->swapchainFramebuffers[i]
+                );
 
-        copyBuffer(app, stagingBuffer, app->indexBuffer, bufferSize);
+                if (result != VK_SUCCESS)
+                        return RESULT_ERROR(result, "failed to create framebuffer!");
+        }
 
-        vkDestroyBuffer(app->device, stagingBuffer, NULL);
-        vkFreeMemory(app->device, stagingBufferMemory, NULL);
         return RESULT_SUCCESS;
 }
 
-static const Result createCommandBuffers(App *app)
+// Particles step on the async compute queue when there is one, and in the
+// frame's own command buffer otherwise
+static bool asyncParticles(const App *app)
 {
-        app->commandBuffers = malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
-        const VkCommandBufferAllocateInfo allocInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                .commandPool = app->commandPool,
-                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
+        return app->config.particleCount > 0 && app->computeQueue != VK_NULL_HANDLE;
+}
+
+static const Result createCommandPool(App *app)
+{
+        const QueueFamilyIndices queueFamilyIndices = findQueueFamilies(
+                app->physicalDevice,
+                app->surface
+        );
+
+        const VkCommandPoolCreateInfo createInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = queueFamilyIndices.graphicsFamily,
         };
 
-        const VkResult result = vkAllocateCommandBuffers(
+        VkResult result = vkCreateCommandPool(
                 app->device,
-                &allocInfo,
-                app->commandBuffers
+                &createInfo,
+                NULL,
+                &app->commandPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create command pool");
+
+        if (!asyncParticles(app))
+                return RESULT_SUCCESS;
+
+        const VkCommandPoolCreateInfo computeCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = app->asyncComputeFamily,
+        };
+
+        result = vkCreateCommandPool(
+                app->device,
+                &computeCreateInfo,
+                NULL,
+                &app->computeCommandPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create compute command pool");
+        
+        return RESULT_SUCCESS;
+}
+
+// Buffers the upload manager fills from a dedicated transfer queue are
+// shared with the graphics family instead of needing ownership transfers.
+// queueFamilyIndices must outlive createInfo.
+static void setBufferSharing(
+        const App *app,
+        VkBufferCreateInfo *createInfo,
+        uint32_t *queueFamilyIndices
+) {
+        if (!(createInfo->usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+                || app->graphicsFamily == app->transferFamily
+        ) {
+                return;
+        }
+
+        queueFamilyIndices[0] = app->graphicsFamily;
+        queueFamilyIndices[1] = app->transferFamily;
+        createInfo->sharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo->queueFamilyIndexCount = 2;
+        createInfo->pQueueFamilyIndices = queueFamilyIndices;
+}
+
+static const Result createBuffer(
+        App *app,
+        const VkDeviceSize size,
+        const VkBufferUsageFlags usage,
+        const VkMemoryPropertyFlags properties,
+        VkBuffer *pBuffer,
+        Allocation *pAllocation
+) {
+        const VkBufferCreateInfo createInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = size,
+                .usage = usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        // Only ever touched by the graphics queue, even as a transfer
+        // destination, so exclusive
+        const VkResult createResult = vkCreateBuffer(
+                app->device,
+                &createInfo,
+                NULL,
+                pBuffer
+        );
+
+        if (createResult != VK_SUCCESS)
+                return RESULT_ERROR(createResult, "failed to create buffer!");
+
+        return allocatorAllocateBuffer(
+                &app->allocator,
+                *pBuffer,
+                properties,
+                pAllocation
+        );
+}
+
+// Same as createBuffer, but owned by the registry so it can be released
+// while frames are still in flight, and shared with the transfer queue
+// when it is an upload target
+static const Result createRegisteredBuffer(
+        App *app,
+        const VkDeviceSize size,
+        const VkBufferUsageFlags usage,
+        const VkMemoryPropertyFlags properties,
+        BufferHandle *pHandle
+) {
+        VkBufferCreateInfo createInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = size,
+                .usage = usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        uint32_t queueFamilyIndices[2];
+        setBufferSharing(app, &createInfo, queueFamilyIndices);
+
+        return registryCreateBuffer(&app->registry, &createInfo, properties, pHandle);
+}
+
+static const Result createUploadManager(App *app)
+{
+        return uploadCreate(
+                &app->uploads,
+                app->device,
+                &app->allocator,
+                app->transferFamily,
+                app->transferQueue,
+                UPLOAD_RING_SIZE
+        );
+}
+
+// Starts each texture at its coarse levels; finer ones stream in per frame
+static const Result createTextures(App *app)
+{
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+
+        float maxAnisotropy = 0.0f;
+        if (app->enabledFeatures.samplerAnisotropy) {
+                maxAnisotropy = properties.limits.maxSamplerAnisotropy < MAX_TEXTURE_ANISOTROPY
+                        ? properties.limits.maxSamplerAnisotropy
+                        : MAX_TEXTURE_ANISOTROPY;
+        }
+
+        const uint32_t budgetMiB = app->config.textureBudgetMiB
+                ? app->config.textureBudgetMiB
+                : DEFAULT_TEXTURE_BUDGET_MIB;
+
+        for (uint32_t i = 0; i < MAX_TEXTURE_FILES; i++)
+                app->textureSlots[i] = BINDLESS_INVALID;
+
+        Result res;
+        handle(textureManagerCreate(
+                &app->textures,
+                app->device,
+                app->physicalDevice,
+                &app->registry,
+                &app->uploads,
+                app->graphicsFamily,
+                app->graphicsQueue,
+                maxAnisotropy,
+                (VkDeviceSize) budgetMiB * 1024 * 1024
+        ));
+
+        for (uint32_t i = 0; i < app->config.textureFileCount; i++) {
+                uint32_t index;
+                handle(textureManagerLoad(&app->textures, app->config.texturePaths[i], &index));
+        }
+
+        return RESULT_SUCCESS;
+}
+
+static void builtinMesh(Mesh *mesh)
+{
+        *mesh = (Mesh) {
+                .header = {
+                        .vertexStride = sizeof(Vertex),
+                        .attributeCount = 2,
+                        .attributes = {
+                                {
+                                        .location = 0,
+                                        .format = VK_FORMAT_R32G32_SFLOAT,
+                                        .offset = offsetof(Vertex, pos),
+                                },
+                                {
+                                        .location = 1,
+                                        .format = VK_FORMAT_R32G32B32_SFLOAT,
+                                        .offset = offsetof(Vertex, color),
+                                },
+                        },
+                        .vertexCount = VERTEX_COUNT,
+                        .indexCount = INDEX_COUNT,
+                        .indexSize = sizeof(INDICES[0]),
+                },
+                .vertices = VERTICES,
+                .indices = INDICES,
+        };
+}
+
+// The vertex shader reads locations 0 and 1, and the ones after belong to
+// the instance binding
+static const Result checkMeshLayout(const Mesh *mesh)
+{
+        if (!meshFindAttribute(mesh, 0) || !meshFindAttribute(mesh, 1))
+                return RESULT_ERROR(-1, "mesh lacks a position or color attribute!");
+
+        for (uint32_t i = 0; i < mesh->header.attributeCount; i++) {
+                if (mesh->header.attributes[i].location >= FIRST_INSTANCE_LOCATION)
+                        return RESULT_ERROR(-1, "mesh attribute overlaps the instance attributes!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+static const Result createMesh(App *app)
+{
+        const double loadStart = benchNowMs();
+
+        Result res;
+        if (app->config.meshPath) {
+                handle(meshLoad(&app->mesh, app->config.meshPath));
+        } else {
+                builtinMesh(&app->mesh);
+        }
+
+        handle(checkMeshLayout(&app->mesh));
+
+        if (app->config.exportMeshPath) {
+                handle(meshSave(&app->mesh, app->config.exportMeshPath));
+        }
+
+        benchSetValue(&app->bench, "meshMapMs", benchNowMs() - loadStart);
+        return RESULT_SUCCESS;
+}
+
+static const Result createVertexBuffer(App *app)
+{
+        const VkDeviceSize bufferSize = meshVertexBytes(&app->mesh);
+
+        Result res;
+        handle(createRegisteredBuffer(
+                app,
+                bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->vertexBuffer
+        ));
+
+        return uploadBuffer(
+                &app->uploads,
+                registryGetBuffer(&app->registry, app->vertexBuffer)->buffer,
+                0,
+                app->mesh.vertices,
+                bufferSize
         );
+}
+
+static const Result createIndexBuffer(App *app)
+{
+        const VkDeviceSize bufferSize = meshIndexBytes(&app->mesh);
+
+        Result res;
+        handle(createRegisteredBuffer(
+                app,
+                bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                        | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->indexBuffer
+        ));
+
+        return uploadBuffer(
+                &app->uploads,
+                registryGetBuffer(&app->registry, app->indexBuffer)->buffer,
+                0,
+                app->mesh.indices,
+                bufferSize
+        );
+}
+
+static const Result createOffscreenTargets(App *app)
+{
+        app->swapchainImageCount = OFFSCREEN_IMAGE_COUNT;
+        app->swapchainImageFormat = OFFSCREEN_FORMAT;
+        app->swapchainExtent = (VkExtent2D) { .width = WIDTH, .height = HEIGHT };
+        app->offscreenImageIndex = 0;
+
+        app->swapchainImages = malloc(sizeof(VkImage) * app->swapchainImageCount);
+        app->offscreenImageAllocations = malloc(
+                sizeof(Allocation) * app->swapchainImageCount
+        );
+
+        for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+                const VkImageCreateInfo imageInfo = {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                        .imageType = VK_IMAGE_TYPE_2D,
+                        .format = app->swapchainImageFormat,
+                        .extent = {
+                                .width = app->swapchainExtent.width,
+                                .height = app->swapchainExtent.height,
+                                .depth = 1,
+                        },
+                        .mipLevels = 1,
+                        .arrayLayers = 1,
+                        .samples = VK_SAMPLE_COUNT_1_BIT,
+                        .tiling = VK_IMAGE_TILING_OPTIMAL,
+                        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                                | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                };
+
+                const VkResult imageResult = vkCreateImage(
+                        app->device,
+                        &imageInfo,
+                        NULL,
+                        &app->swapchainImages[i]
+                );
+
+                if (imageResult != VK_SUCCESS)
+                        return RESULT_ERROR(imageResult, "failed to create offscreen image!");
+
+                const Result allocResult = allocatorAllocateImage(
+                        &app->allocator,
+                        app->swapchainImages[i],
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &app->offscreenImageAllocations[i]
+                );
+
+                if (allocResult.code != 0)
+                        return allocResult;
+        }
+
+        if (!app->config.readbackPath)
+                return RESULT_SUCCESS;
+
+        // One host-visible buffer per image, mapped by the allocator for its lifetime
+        const VkDeviceSize readbackSize =
+                (VkDeviceSize) app->swapchainExtent.width
+                * app->swapchainExtent.height
+                * 4;
+
+        app->readbackBuffers = malloc(sizeof(VkBuffer) * app->swapchainImageCount);
+        app->readbackAllocations = malloc(
+                sizeof(Allocation) * app->swapchainImageCount
+        );
+
+        for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+                const Result bufResult = createBuffer(
+                        app,
+                        readbackSize,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        &app->readbackBuffers[i],
+                        &app->readbackAllocations[i]
+                );
+
+                if (bufResult.code != 0)
+                        return bufResult;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+static const Result createCommandBuffers(App *app)
+{
+        // Enough for one per frame in flight, or one per image when cached
+        app->commandBuffers = malloc(sizeof(VkCommandBuffer) * MAX_COMMAND_SLOTS);
+        const VkCommandBufferAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = app->commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = MAX_COMMAND_SLOTS,
+        };
+
+        VkResult result = vkAllocateCommandBuffers(
+                app->device,
+                &allocInfo,
+                app->commandBuffers
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate command buffers!");
+
+        if (!asyncParticles(app))
+                return RESULT_SUCCESS;
+
+        const VkCommandBufferAllocateInfo computeAllocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = app->computeCommandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = MAX_COMMAND_SLOTS,
+        };
+
+        result = vkAllocateCommandBuffers(
+                app->device,
+                &computeAllocInfo,
+                app->computeCommandBuffers
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate compute command buffers!");
+
+        return RESULT_SUCCESS;
+}
+
+// Lays the instances out on a square grid across the viewport. A single
+// instance is left untransformed and untinted.
+static void fillInstanceGrid(Instance *instances, uint32_t count)
+{
+        uint32_t side = 1;
+        while (side * side < count)
+                side++;
+
+        const float cell = 2.0f / side;
+        for (uint32_t i = 0; i < count; i++) {
+                const uint32_t column = i % side;
+                const uint32_t row = i / side;
+
+                Instance *instance = &instances[i];
+                glmc_mat4_identity(instance->transform);
+                instance->transform[0][0] = 1.0f / side;
+                instance->transform[1][1] = 1.0f / side;
+                instance->transform[3][0] = -1.0f + cell * (column + 0.5f);
+                instance->transform[3][1] = -1.0f + cell * (row + 0.5f);
+
+                instance->color[0] = 1.0f - 0.5f * column / side;
+                instance->color[1] = 1.0f - 0.5f * row / side;
+                instance->color[2] = 1.0f;
+                instance->color[3] = 1.0f;
+        }
+}
+
+// Command slots that can actually be in use, see prepareCommandBuffer
+static uint32_t commandSlotCount(const App *app)
+{
+        return app->config.cacheCommandBuffers
+                ? MAX_COMMAND_SLOTS
+                : app->pacer.framesInFlight;
+}
+
+// One buffer per command slot, so a frame can write its instances while
+// earlier frames still read theirs
+static const Result createInstanceBuffers(App *app)
+{
+        app->instanceCount = app->config.instanceCount > 0 ? app->config.instanceCount : 1;
+
+        const VkDeviceSize bufferSize = sizeof(Instance) * app->instanceCount;
+        for (uint32_t i = 0; i < commandSlotCount(app); i++) {
+                Result res;
+                handle(createBuffer(
+                        app,
+                        bufferSize,
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        &app->instanceBuffers[i],
+                        &app->instanceAllocations[i]
+                ));
+
+                fillInstanceGrid(appGetInstances(app, i), app->instanceCount);
+        }
+
+        return RESULT_SUCCESS;
+}
+
+Instance *appGetInstances(App *app, uint32_t slot)
+{
+        return app->instanceAllocations[slot].mapped;
+}
+
+// Animation radians per second about each instance's own centre
+static const float ANIMATE_SPIN_RATE = 1.0f;
+
+// Animated instances keep their grid position and scale, and have their
+// matrices rebuilt in SoA batches every frame
+static const Result createTransforms(App *app)
+{
+        if (!app->config.animate)
+                return RESULT_SUCCESS;
+
+        Result res;
+        handle(transformBatchCreate(&app->transforms, app->instanceCount));
+        app->transformKernel = transformKernelBest();
+
+        const Instance *instances = appGetInstances(app, 0);
+        for (uint32_t i = 0; i < app->instanceCount; i++) {
+                app->transforms.positionX[i] = instances[i].transform[3][0];
+                app->transforms.positionY[i] = instances[i].transform[3][1];
+                app->transforms.positionZ[i] = instances[i].transform[3][2];
+                app->transforms.scale[i] = instances[i].transform[0][0];
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Writes straight into the slot's mapped instance buffer; the slot's
+// previous submission has finished
+static void animateInstances(App *app, uint32_t slot)
+{
+        const double transformStart = benchNowMs();
+        const float angle = (float) ((transformStart - app->startTimeMs) / 1000.0) * ANIMATE_SPIN_RATE;
+        const float sine = sinf(angle * 0.5f);
+        const float cosine = cosf(angle * 0.5f);
+
+        TransformBatch *transforms = &app->transforms;
+        for (uint32_t i = 0; i < transforms->count; i++) {
+                transforms->rotationZ[i] = sine;
+                transforms->rotationW[i] = cosine;
+        }
+
+        // The camera is applied in the vertex shader, so model matrices only
+        Instance *instances = appGetInstances(app, slot);
+        transformBatchCompute(
+                transforms,
+                app->transformKernel,
+                NULL,
+                (char *) instances + offsetof(Instance, transform),
+                sizeof(Instance),
+                NULL
+        );
+
+        benchRecord(&app->bench, "transformMs", benchNowMs() - transformStart);
+}
+
+// Bounds come from the initial instance transforms, so instances moved
+// later through appGetInstances are still culled where they started
+static const Result uploadCullObjects(App *app)
+{
+        app->cullObjectCount = app->instanceCount;
+        const VkDeviceSize bufferSize = sizeof(CullObject) * app->cullObjectCount;
+
+        Result res;
+        handle(createRegisteredBuffer(
+                app,
+                bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                        | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->cullObjectBuffer
+        ));
+
+        CullObject *objects = malloc(bufferSize);
+        if (objects == NULL)
+                return RESULT_ERROR(-1, "failed to allocate cull objects!");
+
+        // Radius of the unit quad's corners, scaled by the larger axis
+        const float quadRadius = sqrtf(0.5f);
+        const Instance *instances = appGetInstances(app, 0);
+        for (uint32_t i = 0; i < app->cullObjectCount; i++) {
+                vec4 *const transform = (vec4 *) instances[i].transform;
+                const float scaleX = glmc_vec3_norm(transform[0]);
+                const float scaleY = glmc_vec3_norm(transform[1]);
+
+                objects[i] = (CullObject) {
+                        .sphere = {
+                                transform[3][0],
+                                transform[3][1],
+                                transform[3][2],
+                                quadRadius * fmaxf(scaleX, scaleY),
+                        },
+                        .indexCount = app->mesh.header.indexCount,
+                        .firstIndex = 0,
+                        .vertexOffset = 0,
+                        .instanceIndex = i,
+                };
+        }
+
+        const VkBuffer objectBuffer = registryGetBuffer(&app->registry, app->cullObjectBuffer)->buffer;
+        res = uploadBuffer(&app->uploads, objectBuffer, 0, objects, bufferSize);
+        free(objects);
+        return res;
+}
+
+// Per slot, since the cull output is consumed by that slot's draw
+static const Result createCullBuffers(App *app)
+{
+        if (!app->config.gpuCull)
+                return RESULT_SUCCESS;
+
+        if (app->computeFamily != app->graphicsFamily)
+                return RESULT_ERROR(-1, "GPU culling needs a graphics queue with compute!");
+
+        if (!app->enabledFeatures.drawIndirectFirstInstance)
+                return RESULT_ERROR(-1, "GPU culling needs drawIndirectFirstInstance!");
+
+        Result res;
+        handle(uploadCullObjects(app));
+
+        const VkBuffer objectBuffer = registryGetBuffer(&app->registry, app->cullObjectBuffer)->buffer;
+        const uint32_t slotCount = commandSlotCount(app);
+        const VkDescriptorPoolSize poolSize = {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = CULL_BINDING_COUNT * slotCount,
+        };
+
+        const VkDescriptorPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .maxSets = slotCount,
+                .poolSizeCount = 1,
+                .pPoolSizes = &poolSize,
+        };
+
+        VkResult result = vkCreateDescriptorPool(
+                app->device,
+                &poolInfo,
+                NULL,
+                &app->cullDescriptorPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create cull descriptor pool!");
+
+        VkDescriptorSetLayout setLayouts[MAX_COMMAND_SLOTS];
+        for (uint32_t i = 0; i < slotCount; i++)
+                setLayouts[i] = app->cullSetLayout;
+
+        const VkDescriptorSetAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = app->cullDescriptorPool,
+                .descriptorSetCount = slotCount,
+                .pSetLayouts = setLayouts,
+        };
+
+        result = vkAllocateDescriptorSets(app->device, &allocInfo, app->cullSets);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate cull descriptor sets!");
+
+        for (uint32_t i = 0; i < slotCount; i++) {
+                handle(createBuffer(
+                        app,
+                        sizeof(VkDrawIndexedIndirectCommand) * app->cullObjectCount,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &app->indirectBuffers[i],
+                        &app->indirectAllocations[i]
+                ));
+
+                // Transfer destination so each frame can zero the count
+                handle(createBuffer(
+                        app,
+                        sizeof(uint32_t),
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &app->drawCountBuffers[i],
+                        &app->drawCountAllocations[i]
+                ));
+
+                const VkDescriptorBufferInfo bufferInfos[CULL_BINDING_COUNT] = {
+                        { .buffer = objectBuffer, .offset = 0, .range = VK_WHOLE_SIZE },
+                        { .buffer = app->indirectBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE },
+                        { .buffer = app->drawCountBuffers[i], .offset = 0, .range = VK_WHOLE_SIZE },
+                };
+
+                VkWriteDescriptorSet writes[CULL_BINDING_COUNT];
+                for (uint32_t j = 0; j < CULL_BINDING_COUNT; j++) {
+                        writes[j] = (VkWriteDescriptorSet) {
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = app->cullSets[i],
+                                .dstBinding = j,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfos[j],
+                        };
+                }
+
+                vkUpdateDescriptorSets(app->device, CULL_BINDING_COUNT, writes, 0, NULL);
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Both buffers stay on the GPU: the first step seeds them in the shader
+// and nothing is ever read back. Every frame reads the buffer the previous
+// frame wrote, so the sets only differ in which way round they bind.
+static const Result createParticleBuffers(App *app)
+{
+        app->particleCount = app->config.particleCount;
+        if (app->particleCount == 0)
+                return RESULT_SUCCESS;
+
+        const bool async = asyncParticles(app);
+        if (!async && app->computeFamily != app->graphicsFamily)
+                return RESULT_ERROR(-1, "particles need a graphics queue with compute!");
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+
+        const uint32_t groupCount =
+                (app->particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE;
+        if (groupCount > properties.limits.maxComputeWorkGroupCount[0])
+                return RESULT_ERROR(-1, "too many particles for one dispatch!");
+
+        const VkDeviceSize bufferSize = sizeof(Instance) * (VkDeviceSize) app->particleCount;
+        if (bufferSize > properties.limits.maxStorageBufferRange)
+                return RESULT_ERROR(-1, "too many particles for one storage buffer!");
+
+        VkBufferCreateInfo bufferInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = bufferSize,
+                .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        // Written on the compute queue and drawn on the graphics one every
+        // frame, so shared rather than transferred back and forth
+        const uint32_t queueFamilyIndices[] = {
+                app->graphicsFamily,
+                app->asyncComputeFamily,
+        };
+
+        if (async) {
+                bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+                bufferInfo.queueFamilyIndexCount = 2;
+                bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+        }
+
+        Result res;
+        for (uint32_t i = 0; i < 2; i++) {
+                handle(registryCreateBuffer(
+                        &app->registry,
+                        &bufferInfo,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        &app->particleBuffers[i]
+                ));
+        }
+
+        const VkDescriptorPoolSize poolSize = {
+                .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = PARTICLE_BINDING_COUNT * 2,
+        };
+
+        const VkDescriptorPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .maxSets = 2,
+                .poolSizeCount = 1,
+                .pPoolSizes = &poolSize,
+        };
+
+        VkResult result = vkCreateDescriptorPool(
+                app->device,
+                &poolInfo,
+                NULL,
+                &app->particleDescriptorPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create particle descriptor pool!");
+
+        const VkDescriptorSetLayout setLayouts[2] = {
+                app->particleSetLayout,
+                app->particleSetLayout,
+        };
+
+        const VkDescriptorSetAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = app->particleDescriptorPool,
+                .descriptorSetCount = 2,
+                .pSetLayouts = setLayouts,
+        };
+
+        result = vkAllocateDescriptorSets(app->device, &allocInfo, app->particleSets);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate particle descriptor sets!");
+
+        for (uint32_t i = 0; i < 2; i++) {
+                const VkDescriptorBufferInfo bufferInfos[PARTICLE_BINDING_COUNT] = {
+                        {
+                                .buffer = registryGetBuffer(&app->registry, app->particleBuffers[i])->buffer,
+                                .offset = 0,
+                                .range = VK_WHOLE_SIZE,
+                        },
+                        {
+                                .buffer = registryGetBuffer(&app->registry, app->particleBuffers[1 - i])->buffer,
+                                .offset = 0,
+                                .range = VK_WHOLE_SIZE,
+                        },
+                };
+
+                VkWriteDescriptorSet writes[PARTICLE_BINDING_COUNT];
+                for (uint32_t j = 0; j < PARTICLE_BINDING_COUNT; j++) {
+                        writes[j] = (VkWriteDescriptorSet) {
+                                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                                .dstSet = app->particleSets[i],
+                                .dstBinding = j,
+                                .descriptorCount = 1,
+                                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                .pBufferInfo = &bufferInfos[j],
+                        };
+                }
+
+                vkUpdateDescriptorSets(app->device, PARTICLE_BINDING_COUNT, writes, 0, NULL);
+        }
+
+        // Which buffer a frame reads is baked into its recording, so cached
+        // command buffers would replay steps out of order
+        app->dynamicContent = true;
+        return RESULT_SUCCESS;
+}
+
+// A mapped vertex buffer per command slot, written by the batcher every
+// frame, and the one static index buffer they all share
+static const Result createQuadBuffers(App *app)
+{
+        if (app->config.quadCount == 0)
+                return RESULT_SUCCESS;
+
+        Result res;
+        handle(quadBatchCreate(&app->quads, app->config.quadCount));
+
+        const VkDeviceSize vertexBytes = sizeof(QuadVertex) * 4 * (VkDeviceSize) app->config.quadCount;
+        for (uint32_t i = 0; i < commandSlotCount(app); i++) {
+                handle(createBuffer(
+                        app,
+                        vertexBytes,
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        &app->quadVertexBuffers[i],
+                        &app->quadVertexAllocations[i]
+                ));
+        }
+
+        const VkDeviceSize indexBytes = sizeof(uint16_t) * QUAD_INDEX_COUNT;
+        handle(createRegisteredBuffer(
+                app,
+                indexBytes,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                        | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->quadIndexBuffer
+        ));
+
+        uint16_t *indices = malloc(indexBytes);
+        if (!indices)
+                return RESULT_ERROR(-1, "failed to allocate quad indices!");
+
+        quadBatchWriteIndices(indices);
+        res = uploadBuffer(
+                &app->uploads,
+                registryGetBuffer(&app->registry, app->quadIndexBuffer)->buffer,
+                0,
+                indices,
+                indexBytes
+        );
+        free(indices);
+
+        // How many draws the sort comes to is only known once it runs
+        app->dynamicContent = true;
+        return res;
+}
+
+static const Result createDrawList(App *app)
+{
+        // A single instanced draw unless more are asked for, in which case
+        // the instances are split between them to load up the recording side
+        app->drawCount = app->config.drawCount > 0 ? app->config.drawCount : 1;
+        if (app->drawCount > app->instanceCount)
+                app->drawCount = app->instanceCount;
+
+        // The culling pass writes the real draws; the list only stands in
+        // for the one indirect call
+        if (app->config.gpuCull)
+                app->drawCount = 1;
+
+        app->draws = malloc(sizeof(DrawCommand) * app->drawCount);
+        if (app->draws == NULL)
+                return RESULT_ERROR(-1, "failed to allocate draw list!");
+
+        const uint32_t perDraw = app->instanceCount / app->drawCount;
+        const uint32_t remainder = app->instanceCount % app->drawCount;
+        uint32_t firstInstance = 0;
+        for (uint32_t i = 0; i < app->drawCount; i++) {
+                const uint32_t instanceCount = perDraw + (i < remainder ? 1 : 0);
+                app->draws[i] = (DrawCommand) {
+                        .indexCount = app->mesh.header.indexCount,
+                        .instanceCount = instanceCount,
+                        .firstIndex = 0,
+                        .vertexOffset = 0,
+                        .firstInstance = firstInstance,
+                };
+
+                firstInstance += instanceCount;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// One per draw in the list, then the particles' own
+static uint32_t drawUniformCount(const App *app)
+{
+        return app->drawCount + 1;
+}
+
+static const Result createUniformRing(App *app)
+{
+        app->drawUniforms = malloc(sizeof(DrawUniforms) * drawUniformCount(app));
+        if (app->drawUniforms == NULL)
+                return RESULT_ERROR(-1, "failed to allocate draw uniforms!");
+
+        for (uint32_t i = 0; i < drawUniformCount(app); i++)
+                glmc_vec4_one(app->drawUniforms[i].tint);
+
+        // Looks at the [-1, 1] square the instances are laid out in
+        glmc_ortho(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, app->viewProjection);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+
+        const VkDeviceSize drawBytes = sizeof(DrawUniforms) * drawUniformCount(app);
+        Result res;
+        handle(uniformRingCreate(
+                &app->uniformRing,
+                app->device,
+                &app->allocator,
+                &properties.limits,
+                sizeof(FrameUniforms) + drawBytes + UNIFORM_RING_HEADROOM,
+                commandSlotCount(app)
+        ));
+
+        const VkDescriptorPoolSize poolSizes[FRAME_BINDING_COUNT] = {
+                { .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = 1 },
+                { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .descriptorCount = 1 },
+        };
+
+        const VkDescriptorPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .maxSets = 1,
+                .poolSizeCount = FRAME_BINDING_COUNT,
+                .pPoolSizes = poolSizes,
+        };
+
+        VkResult result = vkCreateDescriptorPool(
+                app->device,
+                &poolInfo,
+                NULL,
+                &app->frameDescriptorPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create frame descriptor pool!");
+
+        const VkDescriptorSetAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = app->frameDescriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &app->frameSetLayout,
+        };
+
+        result = vkAllocateDescriptorSets(app->device, &allocInfo, &app->frameSet);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate frame descriptor set!");
+
+        const VkDescriptorBufferInfo bufferInfos[FRAME_BINDING_COUNT] = {
+                { .buffer = app->uniformRing.buffer, .offset = 0, .range = sizeof(FrameUniforms) },
+                { .buffer = app->uniformRing.buffer, .offset = 0, .range = drawBytes },
+        };
+
+        VkWriteDescriptorSet writes[FRAME_BINDING_COUNT];
+        for (uint32_t i = 0; i < FRAME_BINDING_COUNT; i++) {
+                writes[i] = (VkWriteDescriptorSet) {
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = app->frameSet,
+                        .dstBinding = i,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType = poolSizes[i].type,
+                        .pBufferInfo = &bufferInfos[i],
+                };
+        }
+
+        vkUpdateDescriptorSets(app->device, FRAME_BINDING_COUNT, writes, 0, NULL);
+        return RESULT_SUCCESS;
+}
+
+DrawUniforms *appGetDrawUniforms(App *app)
+{
+        return app->drawUniforms;
+}
+
+// The slot's previous submission has finished, so its region is free.
+// Allocations happen in the same order every frame and so land at the
+// offsets cached command buffers were recorded with.
+static const Result writeFrameUniforms(App *app, uint32_t slot)
+{
+        UniformRing *ring = &app->uniformRing;
+        uniformRingBegin(ring, slot);
+
+        const double nowMs = benchNowMs();
+        FrameUniforms frame = {
+                .time = {
+                        (float) ((nowMs - app->startTimeMs) / 1000.0),
+                        app->lastUniformMs > 0.0
+                                ? (float) ((nowMs - app->lastUniformMs) / 1000.0)
+                                : 0.0f,
+                },
+        };
+        glmc_mat4_copy(app->viewProjection, frame.viewProjection);
+        app->lastUniformMs = nowMs;
+        app->frameDeltaSeconds = frame.time[1];
+
+        const VkDeviceSize drawBytes = sizeof(DrawUniforms) * drawUniformCount(app);
+        void *frameData = uniformRingAllocate(ring, sizeof(FrameUniforms), &app->frameUniformOffsets[slot]);
+        void *drawData = uniformRingAllocate(ring, drawBytes, &app->drawUniformOffsets[slot]);
+        if (frameData == NULL || drawData == NULL)
+                return RESULT_ERROR(-1, "uniform ring region overflowed!");
+
+        memcpy(frameData, &frame, sizeof(FrameUniforms));
+        memcpy(drawData, app->drawUniforms, drawBytes);
+        return RESULT_SUCCESS;
+}
+
+static const Result createRecorder(App *app)
+{
+        if (app->config.recordThreads == 0)
+                return RESULT_SUCCESS;
+
+        return recorderCreate(
+                &app->recorder,
+                app->device,
+                app->graphicsFamily,
+                app->config.recordThreads,
+                MAX_COMMAND_SLOTS
+        );
+}
+
+static void recordIndirectDraws(
+        const App *app,
+        VkCommandBuffer commandBuffer,
+        uint32_t slot
+) {
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        if (app->cmdDrawIndexedIndirectCount) {
+                app->cmdDrawIndexedIndirectCount(
+                        commandBuffer,
+                        app->indirectBuffers[slot],
+                        0,
+                        app->drawCountBuffers[slot],
+                        0,
+                        app->cullObjectCount,
+                        stride
+                );
+        } else if (app->enabledFeatures.multiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(
+                        commandBuffer,
+                        app->indirectBuffers[slot],
+                        0,
+                        app->cullObjectCount,
+                        stride
+                );
+        } else {
+                // Brings back the per-object CPU cost, but still renders
+                for (uint32_t i = 0; i < app->cullObjectCount; i++) {
+                        vkCmdDrawIndexedIndirect(
+                                commandBuffer,
+                                app->indirectBuffers[slot],
+                                i * stride,
+                                1,
+                                stride
+                        );
+                }
+        }
+}
+
+// Fills the slot's indirect buffer with the objects that survive frustum
+// culling. Without draw-indirect-count every object keeps its record and
+// culled ones get an instance count of zero.
+static void recordCull(App *app, VkCommandBuffer commandBuffer, uint32_t slot)
+{
+        const bool compact = app->cmdDrawIndexedIndirectCount != NULL;
+        if (compact) {
+                vkCmdFillBuffer(commandBuffer, app->drawCountBuffers[slot], 0, sizeof(uint32_t), 0);
+
+                const VkMemoryBarrier fillBarrier = {
+                        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                };
+
+                vkCmdPipelineBarrier(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        0,
+                        1, &fillBarrier,
+                        0, NULL,
+                        0, NULL
+                );
+        }
+
+        CullParams params = {
+                .objectCount = app->cullObjectCount,
+                .compact = compact,
+        };
+        glmc_frustum_planes(app->viewProjection, params.planes);
+
+        vkCmdBindPipeline(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                registryGetPipeline(&app->registry, app->cullPipeline)->pipeline
+        );
+        vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                app->cullPipelineLayout,
+                0,
+                1,
+                &app->cullSets[slot],
+                0,
+                NULL
+        );
+
+        vkCmdPushConstants(
+                commandBuffer,
+                app->cullPipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(CullParams),
+                &params
+        );
+
+        vkCmdDispatch(
+                commandBuffer,
+                (app->cullObjectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE,
+                1,
+                1
+        );
+
+        const VkMemoryBarrier cullBarrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        };
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                0,
+                1, &cullBarrier,
+                0, NULL,
+                0, NULL
+        );
+}
+
+// One simulation step, reading the buffer the previous step wrote and
+// writing the other, which this frame then draws. On the async compute
+// queue the draw is ordered by the compute timeline instead of barriers.
+static void recordParticles(App *app, VkCommandBuffer commandBuffer, uint32_t slot)
+{
+        const bool async = asyncParticles(app);
+        const uint32_t read = app->particleSteps % 2;
+        const uint32_t write = 1 - read;
+        const VkBuffer readBuffer = registryGetBuffer(&app->registry, app->particleBuffers[read])->buffer;
+        const VkBuffer writeBuffer = registryGetBuffer(&app->registry, app->particleBuffers[write])->buffer;
+
+        // The read side was written by the previous step, the write side two
+        // steps ago and drawn from since
+        const VkBufferMemoryBarrier stepBarriers[2] = {
+                {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = readBuffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                },
+                {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = writeBuffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                },
+        };
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                async
+                        ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                        : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                0, NULL,
+                2, stepBarriers,
+                0, NULL
+        );
+
+        const uint32_t firstQuery = slot * TIMESTAMPS_PER_FRAME + 2;
+        if (app->particleTimestamps) {
+                vkCmdResetQueryPool(commandBuffer, app->timestampQueryPool, firstQuery, 2);
+                vkCmdWriteTimestamp(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        app->timestampQueryPool,
+                        firstQuery
+                );
+        }
+
+        const ParticleParams params = {
+                .particleCount = app->particleCount,
+                .reset = app->particleSteps == 0,
+                .deltaSeconds = fminf(app->frameDeltaSeconds, PARTICLE_MAX_STEP_SECONDS),
+                .size = PARTICLE_SIZE,
+        };
+
+        vkCmdBindPipeline(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                registryGetPipeline(&app->registry, app->particlePipeline)->pipeline
+        );
+        vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                app->particlePipelineLayout,
+                0,
+                1,
+                &app->particleSets[read],
+                0,
+                NULL
+        );
+
+        vkCmdPushConstants(
+                commandBuffer,
+                app->particlePipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(ParticleParams),
+                &params
+        );
+
+        vkCmdDispatch(
+                commandBuffer,
+                (app->particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE,
+                1,
+                1
+        );
+
+        if (app->particleTimestamps) {
+                vkCmdWriteTimestamp(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        app->timestampQueryPool,
+                        firstQuery + 1
+                );
+        }
+
+        app->particleDrawBuffer = write;
+        app->particleSteps++;
+        if (async)
+                return;
+
+        const VkBufferMemoryBarrier drawBarrier = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = writeBuffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+        };
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                0,
+                0, NULL,
+                1, &drawBarrier,
+                0, NULL
+        );
+}
+
+static const Result recordComputeCommandBuffer(App *app, uint32_t slot)
+{
+        const VkCommandBuffer commandBuffer = app->computeCommandBuffers[slot];
+        vkResetCommandBuffer(commandBuffer, 0);
+
+        const VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+
+        VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to begin recording compute command buffer!");
+
+        recordParticles(app, commandBuffer, slot);
+
+        result = vkEndCommandBuffer(commandBuffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to record compute command buffer!");
+
+        return RESULT_SUCCESS;
+}
+
+static void pushDrawParams(
+        const App *app,
+        VkCommandBuffer commandBuffer,
+        uint32_t drawIndex,
+        uint32_t textureIndex
+) {
+        const DrawParams params = {
+                .drawIndex = drawIndex,
+                .textureIndex = textureIndex,
+        };
+
+        vkCmdPushConstants(
+                commandBuffer,
+                app->pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                0,
+                sizeof(DrawParams),
+                &params
+        );
+}
+
+static uint32_t pipelineVariantCount(const App *app)
+{
+        return app->config.pipelineVariants > 1 ? app->config.pipelineVariants : 1;
+}
+
+// Draws cycle through the loaded textures; none until one has been built
+static uint32_t drawTexture(const App *app, uint32_t drawIndex)
+{
+        const uint32_t textureCount = app->textures.textureCount;
+        return textureCount > 0
+                ? app->textureSlots[drawIndex % textureCount]
+                : BINDLESS_INVALID;
+}
+
+// The particles are instances of the mesh, through the same pipeline as
+// the draw list, with the tint after the list's and untextured
+static void recordParticleDraw(const App *app, VkCommandBuffer commandBuffer)
+{
+        const Registry *registry = &app->registry;
+        const VkBuffer vertexBuffers[] = {
+                registryGetBuffer(registry, app->vertexBuffer)->buffer,
+                registryGetBuffer(registry, app->particleBuffers[app->particleDrawBuffer])->buffer,
+        };
+        const VkDeviceSize offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+
+        pushDrawParams(app, commandBuffer, app->drawCount, BINDLESS_INVALID);
+        vkCmdDrawIndexed(commandBuffer, app->mesh.header.indexCount, app->particleCount, 0, 0, 0);
+}
+
+// Sprite speed across the window, in pixels per second
+static const float QUAD_DRIFT_RATE = 40.0f;
+static const float QUAD_SIZE = 24.0f;
+
+// Sprites drifting across the window, alternating between the pipelines
+// and cycling through the textures, so the batcher has sorting to do.
+// Written straight into the slot's mapped vertex buffer.
+static void batchQuads(App *app, uint32_t slot)
+{
+        const double batchStart = benchNowMs();
+        const float seconds = (float) ((batchStart - app->startTimeMs) / 1000.0);
+        const float width = (float) app->swapchainExtent.width;
+        const float height = (float) app->swapchainExtent.height;
+
+        quadBatchBegin(&app->quads);
+        for (uint32_t i = 0; i < app->config.quadCount; i++) {
+                const Quad quad = {
+                        .x = fmodf(i * 37.0f + seconds * QUAD_DRIFT_RATE, width),
+                        .y = fmodf(i * 0.618034f * height, height),
+                        .width = QUAD_SIZE,
+                        .height = QUAD_SIZE,
+                        .u0 = 0.0f,
+                        .v0 = 0.0f,
+                        .u1 = 1.0f,
+                        .v1 = 1.0f,
+                        .color = 0xc0000000u | ((i * 0x9e3779u) & 0xffffffu),
+                };
+
+                quadBatchAdd(&app->quads, &quad, i % QUAD_PIPELINE_COUNT, drawTexture(app, i));
+        }
+
+        quadBatchBuild(&app->quads, width, height, app->quadVertexAllocations[slot].mapped);
+        benchRecord(&app->bench, "quadBatchMs", benchNowMs() - batchStart);
+}
+
+// The batch is sorted by pipeline, so each is bound once
+static void recordQuadDraws(const App *app, VkCommandBuffer commandBuffer, uint32_t slot)
+{
+        const Registry *registry = &app->registry;
+        const VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &app->quadVertexBuffers[slot], &offset);
+        vkCmdBindIndexBuffer(
+                commandBuffer,
+                registryGetBuffer(registry, app->quadIndexBuffer)->buffer,
+                0,
+                VK_INDEX_TYPE_UINT16
+        );
+
+        uint32_t bound = QUAD_BATCH_MAX_PIPELINES;
+        for (uint32_t i = 0; i < app->quads.drawCount; i++) {
+                const QuadDraw *draw = &app->quads.draws[i];
+                if (draw->pipeline != bound) {
+                        const RegistryPipeline *pipeline =
+                                registryGetPipeline(registry, app->quadPipelines[draw->pipeline]);
+                        vkCmdBindPipeline(commandBuffer, pipeline->bindPoint, pipeline->pipeline);
+                        bound = draw->pipeline;
+                }
+
+                vkCmdDrawIndexed(commandBuffer, draw->indexCount, 1, 0, draw->vertexOffset, 0);
+        }
+}
+
+// Records a slice of the draw list along with all the state it needs, so it
+// works inline as well as in a secondary buffer (which inherits nothing but
+// the render pass). Only reads the app, workers call it concurrently.
+static void recordDraws(
+        VkCommandBuffer commandBuffer,
+        uint32_t slot,
+        uint32_t first,
+        uint32_t count,
+        void *userData
+) {
+        const App *app = userData;
+        const Registry *registry = &app->registry;
+
+        // Every variant shares the layout, so the sets survive a rebind
+        const RegistryPipeline *pipeline = registryGetPipeline(registry, app->graphicsPipeline);
+        const uint32_t variants = pipelineVariantCount(app);
+        VkPipeline bound = app->variantPipelines[first % variants];
+        vkCmdBindPipeline(commandBuffer, pipeline->bindPoint, bound);
+
+        const uint32_t dynamicOffsets[FRAME_BINDING_COUNT] = {
+                app->frameUniformOffsets[slot],
+                app->drawUniformOffsets[slot],
+        };
+
+        // The only descriptor binding in the frame, whatever the textures
+        const VkDescriptorSet sets[] = {
+                app->frameSet,
+                app->bindless.set,
+        };
+
+        vkCmdBindDescriptorSets(
+                commandBuffer,
+                pipeline->bindPoint,
+                app->pipelineLayout,
+                0,
+                app->descriptorIndexing ? 2 : 1,
+                sets,
+                FRAME_BINDING_COUNT,
+                dynamicOffsets
+        );
+
+        const VkBuffer vertexBuffers[] = {
+                registryGetBuffer(registry, app->vertexBuffer)->buffer,
+                app->instanceBuffers[slot],
+        };
+        const VkDeviceSize offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(
+                commandBuffer,
+                registryGetBuffer(registry, app->indexBuffer)->buffer,
+                0,
+                meshIndexType(&app->mesh)
+        );
+
+        const VkViewport viewport = {
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = (float) app->swapchainExtent.width,
+                .height = (float) app->swapchainExtent.height,
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f,
+        };
+
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        const VkRect2D scissor = {
+                .offset = { .x = 0, .y = 0 },
+                .extent = app->swapchainExtent,
+        };
+
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // Every culled draw belongs to the one entry in the draw list
+        if (app->config.gpuCull) {
+                pushDrawParams(app, commandBuffer, 0, drawTexture(app, 0));
+                recordIndirectDraws(app, commandBuffer, slot);
+        } else {
+                for (uint32_t i = first; i < first + count; i++) {
+                        const DrawCommand *draw = &app->draws[i];
+                        const VkPipeline variant = app->variantPipelines[i % variants];
+                        if (variant != bound) {
+                                vkCmdBindPipeline(commandBuffer, pipeline->bindPoint, variant);
+                                bound = variant;
+                        }
+
+                        pushDrawParams(app, commandBuffer, i, drawTexture(app, i));
+
+                        vkCmdDrawIndexed(
+                                commandBuffer,
+                                draw->indexCount,
+                                draw->instanceCount,
+                                draw->firstIndex,
+                                draw->vertexOffset,
+                                draw->firstInstance
+                        );
+                }
+        }
+
+        // Over the scene, and only from the slice that starts the list
+        if (app->particleCount > 0 && first == 0) {
+                if (bound != pipeline->pipeline)
+                        vkCmdBindPipeline(commandBuffer, pipeline->bindPoint, pipeline->pipeline);
+
+                recordParticleDraw(app, commandBuffer);
+        }
+
+        // Over everything, so from the slice that ends the list
+        if (app->config.quadCount > 0 && first + count == app->drawCount)
+                recordQuadDraws(app, commandBuffer, slot);
+}
+
+// Without a render pass the attachment's layout transitions are explicit:
+// into an attachment once the previous contents are no longer needed, and
+// out to wherever the image goes after the frame
+static void recordAttachmentBarrier(
+        const App *app,
+        VkCommandBuffer commandBuffer,
+        uint32_t imageIndex,
+        bool toAttachment
+) {
+        VkImageMemoryBarrier2KHR barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+                .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                .srcAccessMask = VK_ACCESS_2_NONE_KHR,
+                .dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                .dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = app->swapchainImages[imageIndex],
+                .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = 0,
+                        .levelCount = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+
+        if (!toAttachment) {
+                barrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                barrier.newLayout = presentLayout(app);
+
+                // Headless without readback leaves the image as it is
+                if (barrier.newLayout == barrier.oldLayout)
+                        return;
+
+                if (barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+                        barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+                        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT_KHR;
+                } else {
+                        // Presentation is ordered by the render finished semaphore
+                        barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+                        barrier.dstAccessMask = VK_ACCESS_2_NONE_KHR;
+                }
+        }
+
+        const VkDependencyInfoKHR dependencyInfo = {
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+                .imageMemoryBarrierCount = 1,
+                .pImageMemoryBarriers = &barrier,
+        };
+
+        app->cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+static void beginRendering(
+        const App *app,
+        VkCommandBuffer commandBuffer,
+        uint32_t imageIndex,
+        bool secondaries
+) {
+        const VkClearValue clearColor = {{{ 0.0f, 0.0f, 0.0f, 1.0f }}};
+        const VkRect2D renderArea = {
+                .offset = { .x = 0, .y = 0 },
+                .extent = app->swapchainExtent,
+        };
+
+        if (!app->cmdBeginRendering) {
+                const VkRenderPassBeginInfo renderPassInfo = {
+                        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                        .renderPass = app->renderPass,
+                        .framebuffer = app->swapchainFramebuffers[imageIndex],
+                        .renderArea = renderArea,
+                        .clearValueCount = 1,
+                        .pClearValues = &clearColor,
+                };
+
+                vkCmdBeginRenderPass(
+                        commandBuffer,
+                        &renderPassInfo,
+                        secondaries
+                                ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                : VK_SUBPASS_CONTENTS_INLINE
+                );
+                return;
+        }
+
+        recordAttachmentBarrier(app, commandBuffer, imageIndex, true);
+
+        const VkRenderingAttachmentInfoKHR colorAttachment = {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR,
+                .imageView = app->swapchainImageViews[imageIndex],
+                .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .resolveMode = VK_RESOLVE_MODE_NONE,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .clearValue = clearColor,
+        };
+
+        const VkRenderingInfoKHR renderingInfo = {
+                .sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+                .flags = secondaries
+                        ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR
+                        : 0,
+                .renderArea = renderArea,
+                .layerCount = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &colorAttachment,
+        };
+
+        app->cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+static void endRendering(const App *app, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+        if (!app->cmdBeginRendering) {
+                vkCmdEndRenderPass(commandBuffer);
+                return;
+        }
+
+        app->cmdEndRendering(commandBuffer);
+        recordAttachmentBarrier(app, commandBuffer, imageIndex, false);
+}
+
+static const Result recordCommandBuffer(
+        App *app,
+        VkCommandBuffer commandBuffer,
+        uint32_t imageIndex,
+        uint32_t slot
+) {
+        const VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = 0, // optional
+                .pInheritanceInfo = NULL, // optional
+        };
+
+        const VkResult commandBufferBeginResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if (commandBufferBeginResult != VK_SUCCESS) {
+                return RESULT_ERROR(
+                        commandBufferBeginResult,
+                        "failed to begin recording command buffer!"
+                );
+        }
+
+        const uint32_t firstQuery = slot * TIMESTAMPS_PER_FRAME;
+        if (app->timestampQueryPool != VK_NULL_HANDLE) {
+                // The particle step resets its own pair, on whichever queue
+                vkCmdResetQueryPool(
+                        commandBuffer,
+                        app->timestampQueryPool,
+                        firstQuery,
+                        2
+                );
+
+                vkCmdWriteTimestamp(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        app->timestampQueryPool,
+                        firstQuery
+                );
+        }
+
+        if (app->particleCount > 0 && !asyncParticles(app))
+                recordParticles(app, commandBuffer, slot);
+
+        if (app->config.gpuCull)
+                recordCull(app, commandBuffer, slot);
+
+        const bool recordSecondaries = app->recorder.threadCount > 0;
+        beginRendering(app, commandBuffer, imageIndex, recordSecondaries);
+
+        if (recordSecondaries) {
+                const VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance = {
+                        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR,
+                        .colorAttachmentCount = 1,
+                        .pColorAttachmentFormats = &app->swapchainImageFormat,
+                        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+                };
+
+                // The recorder blocks until the workers finish, so the
+                // rendering info outlives every use of the copied pNext
+                const VkCommandBufferInheritanceInfo inheritance = {
+                        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+                        .pNext = app->cmdBeginRendering ? &renderingInheritance : NULL,
+                        .renderPass = app->renderPass,
+                        .subpass = 0,
+                        .framebuffer = app->swapchainFramebuffers
+                                ? app->swapchainFramebuffers[imageIndex]
+                                : VK_NULL_HANDLE,
+                };
+
+                VkCommandBuffer secondaries[app->recorder.threadCount];
+                Result res;
+                handle(recorderRecord(
+                        &app->recorder,
+                        slot,
+                        &inheritance,
+                        app->drawCount,
+                        recordDraws,
+                        app,
+                        secondaries
+                ));
+
+                vkCmdExecuteCommands(commandBuffer, app->recorder.threadCount, secondaries);
+        } else {
+                recordDraws(commandBuffer, slot, 0, app->drawCount, app);
+        }
+
+        endRendering(app, commandBuffer, imageIndex);
+
+        if (app->config.headless && app->config.readbackPath) {
+                const VkBufferImageCopy region = {
+                        .bufferOffset = 0,
+                        .bufferRowLength = 0, // tightly packed
+                        .bufferImageHeight = 0,
+                        .imageSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = 0,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                        .imageOffset = { .x = 0, .y = 0, .z = 0 },
+                        .imageExtent = {
+                                .width = app->swapchainExtent.width,
+                                .height = app->swapchainExtent.height,
+                                .depth = 1,
+                        },
+                };
+
+                vkCmdCopyImageToBuffer(
+                        commandBuffer,
+                        app->swapchainImages[imageIndex],
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        app->readbackBuffers[imageIndex],
+                        1,
+                        &region
+                );
+
+                const VkBufferMemoryBarrier hostBarrier = {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = app->readbackBuffers[imageIndex],
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                };
+
+                vkCmdPipelineBarrier(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        VK_PIPELINE_STAGE_HOST_BIT,
+                        0,
+                        0, NULL,
+                        1, &hostBarrier,
+                        0, NULL
+                );
+        }
+
+        if (app->timestampQueryPool != VK_NULL_HANDLE) {
+                vkCmdWriteTimestamp(
+                        commandBuffer,
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        app->timestampQueryPool,
+                        firstQuery + 1
+                );
+        }
+
+        const VkResult cmdBufResult = vkEndCommandBuffer(commandBuffer);
+        if (cmdBufResult != VK_SUCCESS)
+                return RESULT_ERROR(cmdBufResult, "failed to record command buffer!");
+        
+        return RESULT_SUCCESS;
+}
+
+// Frames are tracked by number on one timeline semaphore; the binary
+// semaphores only exist because acquire and present cannot use timelines
+static const Result createSyncObjects(App *app)
+{
+        const VkSemaphoreTypeCreateInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+        };
+
+        const VkSemaphoreCreateInfo timelineCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                .pNext = &timelineInfo,
+        };
+
+        VkResult result = vkCreateSemaphore(
+                app->device,
+                &timelineCreateInfo,
+                NULL,
+                &app->graphicsTimeline
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create graphics timeline semaphore!");
+
+        // Reaches a frame's number once that frame's compute work finishes
+        if (asyncParticles(app)) {
+                result = vkCreateSemaphore(
+                        app->device,
+                        &timelineCreateInfo,
+                        NULL,
+                        &app->computeTimeline
+                );
+
+                if (result != VK_SUCCESS)
+                        return RESULT_ERROR(result, "failed to create compute timeline semaphore!");
+        }
+
+        const uint32_t framesInFlight = app->pacer.framesInFlight;
+        app->frameInFlight = calloc(framesInFlight, sizeof(uint64_t));
+        if (app->config.headless)
+                return RESULT_SUCCESS;
+
+        app->imageAvailableSemaphores = calloc(framesInFlight, sizeof(VkSemaphore));
+        app->renderFinishedSemaphores = calloc(framesInFlight, sizeof(VkSemaphore));
+        const VkSemaphoreCreateInfo semaphoreInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        };
+
+        for (uint32_t i = 0; i < framesInFlight; i++) {
+                result = vkCreateSemaphore(
+                        app->device,
+                        &semaphoreInfo,
+                        NULL,
+                        &app->imageAvailableSemaphores[i]
+                );
+
+                if (result == VK_SUCCESS) {
+                        result = vkCreateSemaphore(
+                                app->device,
+                                &semaphoreInfo,
+                                NULL,
+                                &app->renderFinishedSemaphores[i]
+                        );
+                }
+
+                if (result != VK_SUCCESS)
+                        return RESULT_ERROR(result, "failed to create semaphores!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+static const Result createTimestampQueries(App *app)
+{
+        app->timestampQueryPool = VK_NULL_HANDLE;
+        if (!app->config.bench)
+                return RESULT_SUCCESS;
+
+        const QueueFamilyIndices indices = findQueueFamilies(
+                app->physicalDevice,
+                app->surface
+        );
+
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(
+                app->physicalDevice,
+                &queueFamilyCount,
+                NULL
+        );
+
+        VkQueueFamilyProperties queueFamilies[queueFamilyCount];
+        vkGetPhysicalDeviceQueueFamilyProperties(
+                app->physicalDevice,
+                &queueFamilyCount,
+                queueFamilies
+        );
+
+        const uint32_t validBits =
+                queueFamilies[indices.graphicsFamily].timestampValidBits;
+
+        if (validBits == 0) {
+                fprintf(stderr, "WARN: graphics queue has no timestamp support, GPU time will not be reported.\n");
+                return RESULT_SUCCESS;
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+
+        app->timestampPeriod = properties.limits.timestampPeriod;
+        app->timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+        app->timestampsWritten = 0;
+
+        const VkQueryPoolCreateInfo createInfo = {
+                .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = MAX_COMMAND_SLOTS * TIMESTAMPS_PER_FRAME,
+        };
+
+        const VkResult result = vkCreateQueryPool(
+                app->device,
+                &createInfo,
+                NULL,
+                &app->timestampQueryPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create timestamp query pool!");
+
+        // Timed on whichever queue the step runs on
+        const uint32_t particleValidBits = asyncParticles(app)
+                ? queueFamilies[app->asyncComputeFamily].timestampValidBits
+                : validBits;
+
+        app->particleTimestamps = app->particleCount > 0 && particleValidBits > 0;
+        app->particleTimestampMask = particleValidBits >= 64
+                ? UINT64_MAX
+                : (1ull << particleValidBits) - 1;
+
+        return RESULT_SUCCESS;
+}
+
+// Must only be called once the slot's last submission has finished
+static void collectGpuTime(App *app, uint32_t slot)
+{
+        if (!(app->timestampsWritten & (1u << slot)))
+                return;
+
+        // The particle step's pair is only written when it can be timed
+        const uint32_t queryCount = app->particleTimestamps ? TIMESTAMPS_PER_FRAME : 2;
+        uint64_t timestamps[TIMESTAMPS_PER_FRAME];
+        const VkResult result = vkGetQueryPoolResults(
+                app->device,
+                app->timestampQueryPool,
+                slot * TIMESTAMPS_PER_FRAME,
+                queryCount,
+                sizeof(uint64_t) * queryCount,
+                timestamps,
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT
+        );
+
+        app->timestampsWritten &= ~(1u << slot);
+
+        if (result != VK_SUCCESS)
+                return;
+
+        const uint64_t ticks =
+                (timestamps[1] - timestamps[0]) & app->timestampMask;
+
+        benchRecord(&app->bench, "gpuMs", ticks * app->timestampPeriod / 1000000.0);
+
+        if (app->particleTimestamps) {
+                const uint64_t particleTicks =
+                        (timestamps[3] - timestamps[2]) & app->particleTimestampMask;
+                const double particleMs = particleTicks * app->timestampPeriod / 1000000.0;
+
+                benchRecord(&app->bench, "particleMs", particleMs);
+                app->particleGpuMs += particleMs;
+                app->particleTimedSteps++;
+        }
+}
+
+static const Result initVulkan(App *app)
+{
+        Result res;
+        handle(createInstance(app));
+        handle(setupDebugMessenger(app));
+        handle(createSurface(app));
+        handle(pickPhysicalDevice(app));
+        handle(createLogicalDevice(app));
+        pacerInit(
+                &app->pacer,
+                app->config.pacing,
+                app->config.targetFps,
+                app->waitForPresent != NULL
+        );
+        handle(allocatorCreate(&app->allocator, app->physicalDevice, app->device));
+        registryCreate(&app->registry, app->device, &app->allocator);
+        handle(createBindlessHeap(app));
+        handle(createPipelineCache(app));
+        handle(createMesh(app));
+        handle(app->config.headless
+                ? createOffscreenTargets(app)
+                : createSwapchain(app));
+        handle(createImageViews(app));
+        handle(createRenderPass(app));
+        handle(createGraphicsPipeline(app));
+        handle(createPipelineVariants(app));
+        handle(createQuadPipelines(app));
+        if (app->config.gpuCull) {
+                handle(createCullPipeline(app));
+        }
+
+        if (app->config.particleCount > 0) {
+                handle(createParticlePipeline(app));
+        }
+
+        handle(createFramebuffers(app));
+        handle(createCommandPool(app));
+        handle(createUploadManager(app));
+        const double meshCopyStart = benchNowMs();
+        handle(createVertexBuffer(app));
+        handle(createIndexBuffer(app));
+        benchSetValue(&app->bench, "meshCopyMs", benchNowMs() - meshCopyStart);
+        benchSetValue(
+                &app->bench,
+                "meshBytes",
+                meshVertexBytes(&app->mesh) + meshIndexBytes(&app->mesh)
+        );
+
+        // Both sections already sit in the staging ring
+        meshUnmap(&app->mesh);
+        handle(createInstanceBuffers(app));
+        handle(createTransforms(app));
+        handle(createCullBuffers(app));
+        handle(createParticleBuffers(app));
+        handle(createQuadBuffers(app));
+        handle(createDrawList(app));
+        handle(createUniformRing(app));
+
+        // Both buffers go out in one batch; the rest of init and the first
+        // frame's recording overlap the copy
+        handle(uploadFlush(&app->uploads, &app->geometryUploadTicket));
+        handle(createTextures(app));
+        handle(createCommandBuffers(app));
+        handle(createRecorder(app));
+        appInvalidateCommands(app);
+        handle(createSyncObjects(app));
+        handle(createTimestampQueries(app));
+        app->uploadWaitTicket = app->geometryUploadTicket;
+        handle(startHotReload(app));
+        return RESULT_SUCCESS;
+}
+
+static const Result cleanUpSwapchain(App *app)
+{
+        if (app->swapchainFramebuffers) {
+                for (int i = 0; i < app->swapchainImageCount; i++)
+                        vkDestroyFramebuffer(app->device, app->swapchainFramebuffers[i], NULL);
+
+                free(app->swapchainFramebuffers);
+        }
+
+        for (int i = 0; i < app->swapchainImageCount; i++)
+                vkDestroyImageView(app->device, app->swapchainImageViews[i], NULL);
+
+        free(app->swapchainImageViews);
+
+        if (app->config.headless) {
+                for (int i = 0; i < app->swapchainImageCount; i++) {
+                        vkDestroyImage(app->device, app->swapchainImages[i], NULL);
+                        allocatorFree(&app->allocator, &app->offscreenImageAllocations[i]);
+                }
+
+                free(app->offscreenImageAllocations);
+
+                if (app->config.readbackPath) {
+                        for (int i = 0; i < app->swapchainImageCount; i++) {
+                                vkDestroyBuffer(app->device, app->readbackBuffers[i], NULL);
+                                allocatorFree(&app->allocator, &app->readbackAllocations[i]);
+                        }
+
+                        free(app->readbackBuffers);
+                        free(app->readbackAllocations);
+                }
+        } else {
+                vkDestroySwapchainKHR(app->device, app->swapchain, NULL);
+        }
+
+        free(app->swapchainImages);
+
+        return RESULT_SUCCESS;
+}
+
+// Frames already submitted may still render into the old framebuffers, so
+// they are destroyed along with the old swapchain once those frames finish
+static void retireSwapchain(App *app)
+{
+        for (uint32_t i = 0; i < app->swapchainImageCount; i++) {
+                if (app->swapchainFramebuffers) {
+                        retireQueuePush(
+                                &app->retireQueue,
+                                app->frameNumber,
+                                VK_OBJECT_TYPE_FRAMEBUFFER,
+                                RETIRE_HANDLE(app->swapchainFramebuffers[i])
+                        );
+                }
+
+                retireQueuePush(
+                        &app->retireQueue,
+                        app->frameNumber,
+                        VK_OBJECT_TYPE_IMAGE_VIEW,
+                        RETIRE_HANDLE(app->swapchainImageViews[i])
+                );
+        }
+
+        // Still set, createSwapchain passes it on as the old swapchain
+        retireQueuePush(
+                &app->retireQueue,
+                app->frameNumber,
+                VK_OBJECT_TYPE_SWAPCHAIN_KHR,
+                RETIRE_HANDLE(app->swapchain)
+        );
+
+        free(app->swapchainFramebuffers);
+        free(app->swapchainImageViews);
+        free(app->swapchainImages);
+}
+
+static void retireVariantPipeline(void *userData, VkPipeline pipeline)
+{
+        App *app = userData;
+        retireQueuePush(
+                &app->retireQueue,
+                app->frameNumber,
+                VK_OBJECT_TYPE_PIPELINE,
+                RETIRE_HANDLE(pipeline)
+        );
+}
+
+// Frames already submitted keep the old pipeline until they finish
+static void swapPipeline(
+        App *app,
+        PipelineHandle *pHandle,
+        VkPipeline pipeline,
+        VkPipelineBindPoint bindPoint
+) {
+        PipelineHandle reloaded;
+        const Result res = registryAddPipeline(&app->registry, pipeline, bindPoint, &reloaded);
+        if (res.code != 0) {
+                vkDestroyPipeline(app->device, pipeline, NULL);
+                return;
+        }
+
+        registryReleasePipeline(&app->registry, *pHandle, app->frameNumber);
+        *pHandle = reloaded;
+}
+
+// A new swapchain format leaves the dynamic rendering pipelines built for
+// the old one. Hot reload builds from the states being replaced, so it
+// pauses meanwhile.
+static const Result rebuildForColorFormat(App *app)
+{
+        hotReloadStop(&app->hotReload);
+        defaultPipelineState(app, &app->pipelineState);
+
+        Result res;
+        VkPipeline pipeline;
+        handle(buildPipeline(app, &app->pipelineState, &pipeline));
+        swapPipeline(app, &app->graphicsPipeline, pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+        for (uint32_t i = 0; app->config.quadCount > 0 && i < QUAD_PIPELINE_COUNT; i++) {
+                PipelineState state;
+                quadPipelineState(app, i, &state);
+                handle(buildPipeline(app, &state, &pipeline));
+                swapPipeline(app, &app->quadPipelines[i], pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+        }
+
+        if (app->config.pipelineVariants > 1)
+                pipelineStateCacheFlush(&app->pipelineStates, retireVariantPipeline);
+
+        return startHotReload(app);
+}
+
+// A minimised window has no size to create a swapchain for; drawing is
+// suspended instead of blocking until it is restored.
+static const Result recreateSwapchain(App *app)
+{
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(app->window, &width, &height);
+        if (width == 0 || height == 0) {
+                app->swapchainSuspended = true;
+                return RESULT_SUCCESS;
+        }
+
+        const double recreateStart = benchNowMs();
+        retireSwapchain(app);
+        pacerDropQueued(&app->pacer);
+
+        // Cached command buffers still point at the old framebuffers. The
+        // image frames stay, a slot must not be re-recorded while pending.
+        appInvalidateCommands(app);
+
+        Result res;
+        handle(createSwapchain(app));
+        handle(createImageViews(app));
+        handle(createFramebuffers(app));
+
+        if (pipelineColorFormat(app) != app->pipelineState.colorFormat) {
+                handle(rebuildForColorFormat(app));
+        }
+
+        app->swapchainSuspended = false;
+        benchRecord(&app->bench, "recreateMs", benchNowMs() - recreateStart);
+        return RESULT_SUCCESS;
+}
+
+// Gives each texture whose image changed a fresh slot in the bindless
+// heap. The old slot is left alone until frames recorded with it finish,
+// since update-after-bind only covers slots no pending frame reads.
+static void updateTextureSlots(App *app)
+{
+        if (app->textureGeneration == app->textures.generation)
+                return;
+
+        bool complete = true;
+        bool changed = false;
+        for (uint32_t i = 0; i < app->textures.textureCount; i++) {
+                const VkImageView view = textureManagerView(&app->textures, i);
+                if (view == VK_NULL_HANDLE || view == app->textureViews[i])
+                        continue;
+
+                const uint32_t slot = bindlessAddTexture(
+                        &app->bindless,
+                        view,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        textureManagerSampler(&app->textures, i)
+                );
+
+                // A full heap keeps the texture at the image it had until a
+                // later frame finds a free slot
+                if (slot == BINDLESS_INVALID) {
+                        complete = false;
+                        continue;
+                }
+
+                bindlessReleaseTexture(&app->bindless, app->textureSlots[i], app->frameNumber);
+                app->textureSlots[i] = slot;
+                app->textureViews[i] = view;
+                changed = true;
+        }
+
+        if (complete)
+                app->textureGeneration = app->textures.generation;
+
+        if (changed)
+                appInvalidateCommands(app);
+}
+
+// Blocks until the graphics queue has finished the given frame
+static const Result waitForFrame(App *app, uint64_t frame)
+{
+        if (frame <= app->completedFrame)
+                return RESULT_SUCCESS;
+
+        const VkSemaphoreWaitInfo waitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                .semaphoreCount = 1,
+                .pSemaphores = &app->graphicsTimeline,
+                .pValues = &frame,
+        };
+
+        // Anything but success (a lost device, say) leaves the frame's
+        // resources possibly still in use
+        const VkResult result = vkWaitSemaphores(app->device, &waitInfo, UINT64_MAX);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to wait for frame!");
+
+        return RESULT_SUCCESS;
+}
+
+// Variant 0 is always the default pipeline, which also stands in for the
+// others until they finish compiling. Commands are re-recorded only when
+// one of them changes.
+static void resolvePipelineVariants(App *app)
+{
+        const VkPipeline defaultPipeline =
+                registryGetPipeline(&app->registry, app->graphicsPipeline)->pipeline;
+
+        bool changed = app->variantPipelines[0] != defaultPipeline;
+        app->variantPipelines[0] = defaultPipeline;
+
+        for (uint32_t i = 1; i < pipelineVariantCount(app); i++) {
+                PipelineState state;
+                variantPipelineState(app, i, &state);
+
+                const VkPipeline pipeline = pipelineStateCacheGet(
+                        &app->pipelineStates,
+                        &state,
+                        defaultPipeline
+                );
+
+                changed |= app->variantPipelines[i] != pipeline;
+                app->variantPipelines[i] = pipeline;
+        }
+
+        if (changed)
+                appInvalidateCommands(app);
+}
+
+static void takeReloadedPipelines(App *app, uint32_t target)
+{
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES];
+        double reloadMs;
+        if (!hotReloadTake(&app->hotReload, target, pipelines, &reloadMs))
+                return;
+
+        switch (target) {
+        case RELOAD_SCENE:
+                swapPipeline(app, &app->graphicsPipeline, pipelines[0], VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+                // Variants recompile from the new shaders, drawn with the
+                // new default until they are ready
+                if (app->config.pipelineVariants > 1)
+                        pipelineStateCacheFlush(&app->pipelineStates, retireVariantPipeline);
+                break;
+        case RELOAD_QUADS:
+                for (uint32_t i = 0; i < QUAD_PIPELINE_COUNT; i++)
+                        swapPipeline(app, &app->quadPipelines[i], pipelines[i], VK_PIPELINE_BIND_POINT_GRAPHICS);
+                break;
+        case RELOAD_CULL:
+                swapPipeline(app, &app->cullPipeline, pipelines[0], VK_PIPELINE_BIND_POINT_COMPUTE);
+                break;
+        case RELOAD_PARTICLES:
+                swapPipeline(app, &app->particlePipeline, pipelines[0], VK_PIPELINE_BIND_POINT_COMPUTE);
+                break;
+        }
+
+        benchRecord(&app->bench, "hotReloadMs", reloadMs);
+        appInvalidateCommands(app);
+}
+
+// Runs once the frame slot's previous frame has finished, before anything
+// is recorded
+static void beginFrame(App *app)
+{
+        vkGetSemaphoreCounterValue(app->device, app->graphicsTimeline, &app->completedFrame);
+        retireQueueCollect(&app->retireQueue, app->device, app->completedFrame);
+        registryCollect(&app->registry, app->completedFrame);
+        bindlessCollect(&app->bindless, app->completedFrame);
+
+        for (uint32_t target = 0; target < RELOAD_TARGET_COUNT; target++)
+                takeReloadedPipelines(app, target);
+
+        // A failed step leaves the texture at the levels it already has
+        const Result res = textureManagerUpdate(&app->textures, app->frameNumber);
+        if (res.code != 0)
+                fprintf(stderr, "WARN: %s\n", (const char *) res.data);
+
+        updateTextureSlots(app);
+        resolvePipelineVariants(app);
+}
+
+// Submits the frame's command buffer, signalling the graphics timeline with
+// the frame's number. The binary semaphores are for the swapchain only and
+// are VK_NULL_HANDLE headless.
+// The step overwrites the particles that frame - 2 drew, and frame waits
+// for the step before drawing its output
+static const Result submitCompute(App *app, uint32_t slot, uint64_t frame)
+{
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        const uint64_t waitValue = frame > 2 ? frame - 2 : 0;
+
+        const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .waitSemaphoreValueCount = 1,
+                .pWaitSemaphoreValues = &waitValue,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &frame,
+        };
+
+        const VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &app->graphicsTimeline,
+                .pWaitDstStageMask = &waitStage,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &app->computeCommandBuffers[slot],
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &app->computeTimeline,
+        };
 
+        const VkResult result = vkQueueSubmit(app->computeQueue, 1, &submitInfo, VK_NULL_HANDLE);
         if (result != VK_SUCCESS)
-                return RESULT_ERROR(result, "failed to allocate command buffers!");
+                return RESULT_ERROR(result, "failed to submit compute command buffer!");
 
         return RESULT_SUCCESS;
 }
 
-static const Result recordCommandBuffer(
+static const Result submitFrame(
         App *app,
-        VkCommandBuffer commandBuffer,
-        uint32_t imageIndex
+        uint32_t currentFrame,
+        uint32_t slot,
+        VkSemaphore imageAvailable,
+        VkSemaphore renderFinished
 ) {
-        const VkCommandBufferBeginInfo beginInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                .flags = 0, // optional
-                .pInheritanceInfo = NULL, // optional
-        };
+        const uint64_t frame = app->frameNumber + 1;
+        if (asyncParticles(app)) {
+                Result res;
+                handle(submitCompute(app, slot, frame));
+        }
 
-        const VkResult commandBufferBeginResult = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        if (commandBufferBeginResult != VK_SUCCESS) {
-                return RESULT_ERROR(
-                        commandBufferBeginResult,
-                        "failed to begin recording command buffer!"
-                );
+        VkSemaphore waitSemaphores[3];
+        VkPipelineStageFlags waitStages[3];
+        uint64_t waitValues[3];
+        uint32_t waitCount = 0;
+
+        if (imageAvailable != VK_NULL_HANDLE) {
+                waitSemaphores[waitCount] = imageAvailable;
+                waitStages[waitCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+                waitValues[waitCount++] = 0; // binary, ignored
         }
 
-        const VkClearValue clearColor = {{{ 0.0f, 0.0f, 0.0f, 1.0f }}};
-        VkRenderPassBeginInfo renderPassInfo = {
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .renderPass = app->renderPass,
-                .framebuffer = app->swapchainFramebuffers[imageIndex],
-                .renderArea = {
-                        .offset = { .x = 0, .y = 0 },
-                        .extent = app->swapchainExtent,
-                },
-                .clearValueCount = 1,
-                .pClearValues = &clearColor,
-        };
+        // Copies flushed since the last frame land before anything reads
+        // them, without the CPU waiting on the transfer queue
+        if (app->uploadWaitTicket > 0) {
+                waitSemaphores[waitCount] = app->uploads.timeline;
+                waitStages[waitCount] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                        | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+                waitValues[waitCount++] = app->uploadWaitTicket;
+        }
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->graphicsPipeline);
+        if (asyncParticles(app)) {
+                waitSemaphores[waitCount] = app->computeTimeline;
+                waitStages[waitCount] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+                waitValues[waitCount++] = frame;
+        }
 
-        const VkBuffer vertexBuffers[] = { app->vertexBuffer };
-        const VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, app->indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        const VkSemaphore signalSemaphores[] = { app->graphicsTimeline, renderFinished };
+        const uint64_t signalValues[] = { frame, 0 };
+        const uint32_t signalCount = renderFinished != VK_NULL_HANDLE ? 2 : 1;
 
-        const VkViewport viewport = {
-                .x = 0.0f,
-                .y = 0.0f,
-                .width = (float) app->swapchainExtent.width,
-                .height = (float) app->swapchainExtent.height,
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
+        const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .waitSemaphoreValueCount = waitCount,
+                .pWaitSemaphoreValues = waitValues,
+                .signalSemaphoreValueCount = signalCount,
+                .pSignalSemaphoreValues = signalValues,
         };
 
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        const VkRect2D scissor = {
-                .offset = { .x = 0, .y = 0 },
-                .extent = app->swapchainExtent,
+        const VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .waitSemaphoreCount = waitCount,
+                .pWaitSemaphores = waitSemaphores,
+                .pWaitDstStageMask = waitStages,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &app->commandBuffers[slot],
+                .signalSemaphoreCount = signalCount,
+                .pSignalSemaphores = signalSemaphores,
         };
 
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-        vkCmdDrawIndexed(commandBuffer, INDEX_COUNT, 1, 0, 0, 0);
+        const VkResult result = vkQueueSubmit(
+                app->graphicsQueue,
+                1,
+                &submitInfo,
+                VK_NULL_HANDLE
+        );
 
-        vkCmdEndRenderPass(commandBuffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to submit draw command buffer!");
 
-        const VkResult cmdBufResult = vkEndCommandBuffer(commandBuffer);
-        if (cmdBufResult != VK_SUCCESS)
-                return RESULT_ERROR(cmdBufResult, "failed to record command buffer!");
-        
+        app->uploadWaitTicket = 0;
+        app->frameInFlight[currentFrame] = ++app->frameNumber;
         return RESULT_SUCCESS;
 }
 
-static const Result createSyncObjects(App *app)
+void appInvalidateCommands(App *app)
 {
-        app->imageAvailableSemaphores = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
-        app->renderFinishedSemaphores= malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
-        app->inFlightFences = malloc(sizeof(VkFence) * MAX_FRAMES_IN_FLIGHT);
-        VkSemaphoreCreateInfo semaphoreInfo = {
-                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        };
-
-        VkFenceCreateInfo fenceInfo = {
-                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-                .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-        };
+        app->dirtySlots = (1u << MAX_COMMAND_SLOTS) - 1;
+}
 
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                const VkResult imageAvailableSemaphoreResult = vkCreateSemaphore(
-                        app->device,
-                        &semaphoreInfo,
-                        NULL,
-                        &app->imageAvailableSemaphores[i]
-                );
-                const VkResult renderFinishedSemaphoreResult = vkCreateSemaphore(
-                        app->device,
-                        &semaphoreInfo,
-                        NULL,
-                        &app->renderFinishedSemaphores[i]
-                );
-                const VkResult inFlightFenceResult = vkCreateFence(
-                        app->device,
-                        &fenceInfo,
-                        NULL,
-                        &app->inFlightFences[i]
-                );
+// Picks the command buffer to submit for this frame. In cached mode that is
+// the image's own buffer, which is only re-recorded when invalidated (or
+// when the content is dynamic); otherwise the frame's buffer is recorded
+// from scratch. Must be called after the frame slot's wait.
+static const Result prepareCommandBuffer(
+        App *app,
+        uint32_t imageIndex,
+        uint32_t currentFrame,
+        uint32_t *pSlot
+) {
+        const bool cached = app->config.cacheCommandBuffers;
+        const uint32_t slot = cached ? imageIndex : currentFrame;
 
-                if (imageAvailableSemaphoreResult != VK_SUCCESS
-                        && renderFinishedSemaphoreResult != VK_SUCCESS
-                        && inFlightFenceResult != VK_SUCCESS
-                ) {
-                        return RESULT_ERROR(
-                                inFlightFenceResult,
-                                "failed to create semaphores and fence!"
-                        );
-                }
+        // A cached buffer may still be pending from an older frame that used
+        // the same image, and must not be re-submitted or reset until done
+        Result res;
+        if (cached) {
+                handle(waitForFrame(app, app->imageFrames[imageIndex]));
+                app->imageFrames[imageIndex] = app->frameNumber + 1;
         }
 
-        return RESULT_SUCCESS;
-}
+        collectGpuTime(app, slot);
 
-static const Result initVulkan(App *app)
-{
-        Result res;
-        handle(createInstance(app));
-        handle(setupDebugMessenger(app));
-        handle(createSurface(app));
-        handle(pickPhysicalDevice(app));
-        handle(createLogicalDevice(app));
-        handle(createSwapchain(app));
-        handle(createImageViews(app));
-        handle(createRenderPass(app));
-        handle(createGraphicsPipeline(app));
-        handle(createFramebuffers(app));
-        handle(createCommandPool(app));
-        handle(createVertexBuffer(app));
-        handle(createIndexBuffer(app));
-        handle(createCommandBuffers(app));
-        handle(createSyncObjects(app));
-        return RESULT_SUCCESS;
-}
+        if (app->timestampQueryPool != VK_NULL_HANDLE)
+                app->timestampsWritten |= 1u << slot;
 
-static const Result cleanUpSwapchain(App *app)
-{
+        *pSlot = slot;
 
-        for (int i = 0; i < app->swapchainImageCount; i++)
-                vkDestroyFramebuffer(app->device, app->swapchainFramebuffers[i], NULL);
+        handle(writeFrameUniforms(app, slot));
+        if (app->config.animate)
+                animateInstances(app, slot);
 
-        free(app->swapchainFramebuffers);
+        if (app->config.quadCount > 0)
+                batchQuads(app, slot);
 
-        for (int i = 0; i < app->swapchainImageCount; i++)
-                vkDestroyImageView(app->device, app->swapchainImageViews[i], NULL);
+        // Decides which particle buffer the graphics recording draws
+        if (asyncParticles(app)) {
+                handle(recordComputeCommandBuffer(app, slot));
+        }
 
-        free(app->swapchainImages);
+        if (cached && !app->dynamicContent && !(app->dirtySlots & (1u << slot)))
+                return RESULT_SUCCESS;
+
+        const double recordStart = benchNowMs();
+        vkResetCommandBuffer(app->commandBuffers[slot], 0);
 
-        vkDestroySwapchainKHR(app->device, app->swapchain, NULL);
+        handle(recordCommandBuffer(app, app->commandBuffers[slot], imageIndex, slot));
 
+        benchRecord(&app->bench, "recordMs", benchNowMs() - recordStart);
+        app->dirtySlots &= ~(1u << slot);
         return RESULT_SUCCESS;
 }
 
-static const Result recreateSwapchain(App *app)
+// Headless counterpart of drawFrame: there is no acquire or present, the
+// offscreen images are simply used round-robin.
+static const Result drawOffscreenFrame(App *app, uint32_t *pCurrentFrame)
 {
-        int width = 0;
-        int height = 0;
-        glfwGetFramebufferSize(app->window, &width, &height);
-        while (width == 0 || height == 0) {
-                glfwGetFramebufferSize(app->window, &width, &height);
-                glfwWaitEvents();
-        }
+        Result res;
+        const double waitStart = benchNowMs();
+        handle(waitForFrame(app, app->frameInFlight[*pCurrentFrame]));
+        benchRecord(&app->bench, "frameWaitMs", benchNowMs() - waitStart);
+        beginFrame(app);
 
-        vkDeviceWaitIdle(app->device);
+        const uint32_t imageIndex = app->offscreenImageIndex;
+        app->offscreenImageIndex = (imageIndex + 1) % app->swapchainImageCount;
 
-        cleanUpSwapchain(app);
+        uint32_t slot;
+        handle(prepareCommandBuffer(app, imageIndex, *pCurrentFrame, &slot));
+        handle(submitFrame(app, *pCurrentFrame, slot, VK_NULL_HANDLE, VK_NULL_HANDLE));
 
-        Result res;
-        handle(createSwapchain(app));
-        handle(createImageViews(app));
-        handle(createFramebuffers(app));
+        *pCurrentFrame = (*pCurrentFrame + 1) % app->pacer.framesInFlight;
 
         return RESULT_SUCCESS;
 }
 
 static const Result drawFrame(App *app, uint32_t *pCurrentFrame)
 {
-        vkWaitForFences(app->device, 1, &app->inFlightFences[*pCurrentFrame], VK_TRUE, UINT64_MAX);
+        if (app->config.headless)
+                return drawOffscreenFrame(app, pCurrentFrame);
+
+        Result res;
+        if (app->swapchainSuspended) {
+                handle(recreateSwapchain(app));
+                if (app->swapchainSuspended)
+                        return RESULT_SUCCESS;
+        }
+
+        const double waitStart = benchNowMs();
+        handle(waitForFrame(app, app->frameInFlight[*pCurrentFrame]));
+        benchRecord(&app->bench, "frameWaitMs", benchNowMs() - waitStart);
+        beginFrame(app);
 
         uint32_t imageIndex;
+        const double acquireStart = benchNowMs();
         const VkResult acquireImageResult = vkAcquireNextImageKHR(
                 app->device,
                 app->swapchain,
@@ -1554,55 +4840,41 @@ static const Result drawFrame(App *app, uint32_t *pCurrentFrame)
                 NULL,
                 &imageIndex
         );
+        benchRecord(&app->bench, "acquireWaitMs", benchNowMs() - acquireStart);
 
         if (acquireImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
-                recreateSwapchain(app);
-                return RESULT_SUCCESS;
+                return recreateSwapchain(app);
         } else if (acquireImageResult != VK_SUCCESS
                 && acquireImageResult != VK_SUBOPTIMAL_KHR
         ) {
                 return RESULT_ERROR(acquireImageResult, "failed to acquire swapchain image!");
         }
 
-        // Only reset the fence if work is being submitted
-        vkResetFences(app->device, 1, &app->inFlightFences[*pCurrentFrame]);
+        uint32_t slot;
+        handle(prepareCommandBuffer(app, imageIndex, *pCurrentFrame, &slot));
 
-        vkResetCommandBuffer(app->commandBuffers[*pCurrentFrame], 0);
-        recordCommandBuffer(app, app->commandBuffers[*pCurrentFrame], imageIndex);
-
-        const VkSemaphore waitSemaphores[] = { app->imageAvailableSemaphores[*pCurrentFrame] };
-        const VkPipelineStageFlags waitStages[] = {
-                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        };
-
-        const VkSemaphore signalSemaphores[] = { app->renderFinishedSemaphores[*pCurrentFrame] };
+        const VkSemaphore renderFinished = app->renderFinishedSemaphores[*pCurrentFrame];
+        handle(submitFrame(
+                app,
+                *pCurrentFrame,
+                slot,
+                app->imageAvailableSemaphores[*pCurrentFrame],
+                renderFinished
+        ));
 
-        const VkSubmitInfo submitInfo = {
-                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                .waitSemaphoreCount = 1,
-                .pWaitSemaphores = waitSemaphores,
-                .pWaitDstStageMask = waitStages,
-                .commandBufferCount = 1,
-                .pCommandBuffers = &app->commandBuffers[*pCurrentFrame],
-                .signalSemaphoreCount = 1,
-                .pSignalSemaphores = signalSemaphores,
+        const uint64_t presentId = ++app->presentId;
+        const VkPresentIdKHR presentIdInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                .swapchainCount = 1,
+                .pPresentIds = &presentId,
         };
 
-        const VkResult submitResult = vkQueueSubmit(
-                app->graphicsQueue,
-                1,
-                &submitInfo,
-                app->inFlightFences[*pCurrentFrame]
-        );
-
-        if (submitResult != VK_SUCCESS)
-                return RESULT_ERROR(submitResult, "failed to submit draw command buffer!");
-
         const VkSwapchainKHR swapchains[] = { app->swapchain };
         const VkPresentInfoKHR presentInfo = {
                 .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .pNext = app->waitForPresent ? &presentIdInfo : NULL,
                 .waitSemaphoreCount = 1,
-                .pWaitSemaphores = signalSemaphores,
+                .pWaitSemaphores = &renderFinished,
                 .swapchainCount = 1,
                 .pSwapchains = swapchains,
                 .pImageIndices = &imageIndex,
@@ -1614,60 +4886,405 @@ static const Result drawFrame(App *app, uint32_t *pCurrentFrame)
                 &presentInfo
         );
 
+        // Without present wait, queueing the present is as far as latency
+        // can be followed
+        if (presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR) {
+                if (app->waitForPresent)
+                        pacerQueued(&app->pacer, presentId, app->inputSampleMs);
+                else
+                        benchRecord(&app->bench, "inputToPresentMs", benchNowMs() - app->inputSampleMs);
+        }
+
         if (presentResult == VK_ERROR_OUT_OF_DATE_KHR
                 || presentResult == VK_SUBOPTIMAL_KHR
                 || app->framebufferResized
         ) {
                 app->framebufferResized = false;
-                recreateSwapchain(app);
+                handle(recreateSwapchain(app));
         } else if (presentResult != VK_SUCCESS) {
                 return RESULT_ERROR(presentResult, "failed to rpesent swapchain image!");
         }
 
-        *pCurrentFrame = (*pCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        *pCurrentFrame = (*pCurrentFrame + 1) % app->pacer.framesInFlight;
+
+        return RESULT_SUCCESS;
+}
+
+// Takes note of presents that reached the screen. Low latency blocks until
+// the previous frame is shown so the next one can start just in time; the
+// other profiles only check, and so see a present up to a frame late.
+static const Result collectPresents(App *app, uint32_t currentFrame)
+{
+        if (app->waitForPresent == NULL)
+                return RESULT_SUCCESS;
+
+        const bool lowLatency = app->pacer.profile == PACING_LOW_LATENCY;
+        uint64_t presentId;
+        if (lowLatency
+                && pacerOldestQueued(&app->pacer, &presentId)
+                && presentId == app->presentId
+        ) {
+                // With a single frame in flight this is the frame just presented
+                Result res;
+                handle(waitForFrame(app, app->frameInFlight[currentFrame]));
+                pacerFrameWork(&app->pacer, benchNowMs() - app->inputSampleMs);
+        }
+
+        while (pacerOldestQueued(&app->pacer, &presentId)) {
+                const VkResult result = app->waitForPresent(
+                        app->device,
+                        app->swapchain,
+                        presentId,
+                        lowLatency ? PRESENT_WAIT_TIMEOUT_NS : 0
+                );
+
+                if (result == VK_TIMEOUT && !lowLatency)
+                        break;
+
+                if (result == VK_ERROR_DEVICE_LOST)
+                        return RESULT_ERROR(result, "device lost while waiting for present!");
+
+                // Out of date and timed out presents may never be shown
+                if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                        pacerDropQueued(&app->pacer);
+                        break;
+                }
+
+                benchRecord(
+                        &app->bench,
+                        "inputToPresentMs",
+                        pacerPresented(&app->pacer, benchNowMs())
+                );
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Runs before input is sampled, so any time spent waiting here does not
+// count towards the frame's latency
+static const Result paceFrame(App *app, uint32_t currentFrame)
+{
+        const double paceStart = benchNowMs();
+        if (!app->config.headless && !app->swapchainSuspended) {
+                Result res;
+                handle(collectPresents(app, currentFrame));
+        }
+
+        pacerWait(&app->pacer);
+        benchRecord(&app->bench, "paceWaitMs", benchNowMs() - paceStart);
+        return RESULT_SUCCESS;
+}
+
+static const Result writeReadback(App *app)
+{
+        // The most recently submitted image, which has finished after the idle wait
+        const uint32_t imageIndex =
+                (app->offscreenImageIndex + app->swapchainImageCount - 1)
+                % app->swapchainImageCount;
+
+        const uint8_t *pixels = app->readbackAllocations[imageIndex].mapped;
+        const uint32_t width = app->swapchainExtent.width;
+        const uint32_t height = app->swapchainExtent.height;
+
+        FILE *fp = fopen(app->config.readbackPath, "wb");
+        if (!fp)
+                return RESULT_ERROR(-1, "failed to open readback file!");
 
+        fprintf(fp, "P6\n%u %u\n255\n", width, height);
+        for (uint32_t i = 0; i < width * height; i++)
+                fwrite(&pixels[i * 4], 1, 3, fp); // drop alpha
+
+        fclose(fp);
         return RESULT_SUCCESS;
 }
 
+static const char *presentModeName(VkPresentModeKHR presentMode)
+{
+        switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+                return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+                return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+                return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+                return "fifoRelaxed";
+        default:
+                return "other";
+        }
+}
+
+static void reportBench(App *app, uint32_t framesDrawn, double elapsedMs)
+{
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(app->physicalDevice, &properties);
+
+        benchSetLabel(&app->bench, "device", properties.deviceName);
+        benchSetLabel(&app->bench, "mode", app->config.headless ? "headless" : "windowed");
+        benchSetValue(&app->bench, "frames", framesDrawn);
+        benchSetValue(&app->bench, "seconds", elapsedMs / 1000.0);
+        benchSetValue(&app->bench, "fps", framesDrawn / (elapsedMs / 1000.0));
+        benchSetLabel(&app->bench, "pipelineCache", app->pipelineCacheWarm ? "warm" : "cold");
+        benchSetValue(&app->bench, "recordThreads", app->recorder.threadCount);
+        benchSetValue(&app->bench, "draws", app->drawCount);
+        benchSetValue(&app->bench, "instances", app->instanceCount);
+
+        const char *indirectPath = "none";
+        if (app->config.gpuCull) {
+                indirectPath = app->cmdDrawIndexedIndirectCount
+                        ? "count"
+                        : app->enabledFeatures.multiDrawIndirect ? "multi" : "single";
+        }
+        benchSetLabel(&app->bench, "gpuCull", indirectPath);
+        benchSetLabel(&app->bench, "renderPath", app->cmdBeginRendering ? "dynamic" : "renderPass");
+        if (app->config.animate)
+                benchSetLabel(&app->bench, "transformKernel", transformKernelName(app->transformKernel));
+
+        if (app->particleCount > 0) {
+                benchSetLabel(&app->bench, "particleQueue", asyncParticles(app) ? "asyncCompute" : "graphics");
+                benchSetValue(&app->bench, "particles", app->particleCount);
+                if (app->particleGpuMs > 0.0) {
+                        benchSetValue(
+                                &app->bench,
+                                "particlesPerMs",
+                                app->particleCount * (double) app->particleTimedSteps / app->particleGpuMs
+                        );
+                }
+        }
+
+        if (app->textures.textureCount > 0) {
+                benchSetValue(&app->bench, "textures", app->textures.textureCount);
+                benchSetValue(&app->bench, "textureResidentBytes", app->textures.residentBytes);
+                benchSetValue(&app->bench, "textureUploadBytes", app->textures.uploadedBytes);
+                benchSetValue(&app->bench, "textureLevelsStreamed", app->textures.levelsStreamed);
+                benchSetValue(&app->bench, "samplers", app->textures.samplers.count);
+        }
+
+        if (pipelineVariantCount(app) > 1) {
+                const PipelineStateStats stats = pipelineStateCacheStats(&app->pipelineStates);
+                const uint32_t compiles = stats.compiled + stats.failed;
+                benchSetValue(&app->bench, "pipelineVariants", pipelineVariantCount(app));
+                benchSetValue(&app->bench, "pipelineHits", stats.hits);
+                benchSetValue(&app->bench, "pipelineMisses", stats.misses);
+                benchSetValue(&app->bench, "pipelineFallbacks", stats.fallbacks);
+                benchSetValue(&app->bench, "pipelineCompiles", compiles);
+                benchSetValue(&app->bench, "pipelineCompileMs", compiles > 0 ? stats.compileMs / compiles : 0.0);
+                benchSetValue(&app->bench, "pipelineMaxCompileMs", stats.maxCompileMs);
+        }
+
+        if (app->config.quadCount > 0) {
+                benchSetValue(&app->bench, "quads", app->config.quadCount);
+                benchSetValue(&app->bench, "quadDraws", app->quads.drawCount);
+        }
+
+        benchSetValue(&app->bench, "bindlessTextureSlots", app->bindless.textures.capacity);
+        benchSetValue(&app->bench, "bindlessTextures", atomic_load(&app->bindless.textures.liveCount));
+
+        benchSetLabel(&app->bench, "pacing", pacingProfileName(app->pacer.profile));
+        benchSetValue(&app->bench, "framesInFlight", app->pacer.framesInFlight);
+        benchSetValue(&app->bench, "uniformBytesPerFrame", app->uniformRing.peakBytes);
+        if (app->pacer.profile == PACING_FIXED_RATE)
+                benchSetValue(&app->bench, "targetFps", 1000.0 / app->pacer.targetFrameMs);
+
+        if (!app->config.headless) {
+                benchSetLabel(&app->bench, "presentMode", presentModeName(app->presentMode));
+                benchSetValue(&app->bench, "swapchainImages", app->swapchainImageCount);
+
+                const char *latencySource = "queuePresent";
+                if (app->waitForPresent) {
+                        latencySource = app->pacer.profile == PACING_LOW_LATENCY
+                                ? "presentWait"
+                                : "presentPoll";
+                }
+                benchSetLabel(&app->bench, "latencySource", latencySource);
+        }
+
+        const AllocatorStats memStats = allocatorGetStats(&app->allocator);
+        benchSetValue(&app->bench, "memoryBlocks", memStats.blockCount);
+        benchSetValue(&app->bench, "memoryBlockBytes", memStats.blockBytes);
+        benchSetValue(&app->bench, "memoryAllocations", memStats.allocationCount);
+        benchSetValue(&app->bench, "memoryAllocatedBytes", memStats.allocatedBytes);
+        benchSetValue(&app->bench, "memoryPeakAllocatedBytes", memStats.peakAllocatedBytes);
+        benchSetValue(&app->bench, "deviceMemoryAllocations", memStats.deviceMemoryAllocations);
+}
+
 static const Result mainLoop(App *app)
 {
-        while (!glfwWindowShouldClose(app->window)) {
-                glfwPollEvents();
-                static uint32_t currentFrame = 0;
-                drawFrame(app, &currentFrame);
+        const double durationMs = app->config.durationSeconds * 1000.0;
+        uint32_t frameCount = app->config.frameCount;
+        if (app->config.headless && frameCount == 0 && durationMs <= 0.0)
+                frameCount = HEADLESS_DEFAULT_FRAME_COUNT;
+
+        Result res;
+        uint32_t currentFrame = 0;
+        uint32_t frame = 0;
+        const uint64_t firstFrameNumber = app->frameNumber;
+        const double loopStart = benchNowMs();
+        for (; frameCount == 0 || frame < frameCount; frame++) {
+                if (durationMs > 0.0 && benchNowMs() - loopStart >= durationMs)
+                        break;
+
+                handle(paceFrame(app, currentFrame));
+                const double frameStart = benchNowMs();
+                app->inputSampleMs = frameStart;
+
+                if (!app->config.headless) {
+                        if (glfwWindowShouldClose(app->window))
+                                break;
+
+                        if (app->swapchainSuspended)
+                                glfwWaitEventsTimeout(SUSPENDED_WAIT_SECONDS);
+                        else
+                                glfwPollEvents();
+                }
+
+                // Alternates between two sizes to stress swapchain recreation
+                const uint32_t stormFrames = app->config.resizeStormFrames;
+                if (stormFrames > 0 && frame > 0 && frame % stormFrames == 0) {
+                        const bool shrink = (frame / stormFrames) % 2 == 1;
+                        glfwSetWindowSize(
+                                app->window,
+                                shrink ? WIDTH * 3 / 4 : WIDTH,
+                                shrink ? HEIGHT * 3 / 4 : HEIGHT
+                        );
+                }
+
+                // Suspended or recreating the swapchain, nothing was drawn
+                const uint64_t submitted = app->frameNumber;
+                handle(drawFrame(app, &currentFrame));
+                if (app->frameNumber == submitted)
+                        continue;
+
+                benchRecord(&app->bench, "cpuFrameMs", benchNowMs() - frameStart);
+
+                // Startup cost is measured up to the first frame actually finishing
+                if (submitted == firstFrameNumber && app->config.bench) {
+                        vkQueueWaitIdle(app->graphicsQueue);
+                        benchSetValue(
+                                &app->bench,
+                                "timeToFirstFrameMs",
+                                benchNowMs() - app->startTimeMs
+                        );
+                }
         }
 
         vkDeviceWaitIdle(app->device);
+        const double elapsedMs = benchNowMs() - loopStart;
+
+        // Frames still in flight at the idle wait have valid timestamps too
+        for (uint32_t i = 0; i < MAX_COMMAND_SLOTS; i++)
+                collectGpuTime(app, i);
+
+        if (app->config.bench) {
+                reportBench(app, (uint32_t) (app->frameNumber - firstFrameNumber), elapsedMs);
+                handle(benchWriteJson(&app->bench, app->config.benchOutputPath));
+        }
+
+        if (app->config.headless && app->config.readbackPath) {
+                handle(writeReadback(app));
+        }
+
         return RESULT_SUCCESS;
 }
 
 static const Result cleanUp(App *app)
 {
-        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        // Headless runs never create the swapchain semaphores
+        for (int i = 0; app->imageAvailableSemaphores && i < app->pacer.framesInFlight; i++) {
                 vkDestroySemaphore(app->device, app->imageAvailableSemaphores[i], NULL);
                 vkDestroySemaphore(app->device, app->renderFinishedSemaphores[i], NULL);
-                vkDestroyFence(app->device, app->inFlightFences[i], NULL);
         }
 
+        vkDestroySemaphore(app->device, app->graphicsTimeline, NULL);
+        vkDestroySemaphore(app->device, app->computeTimeline, NULL);
         free(app->imageAvailableSemaphores);
         free(app->renderFinishedSemaphores);
-        free(app->inFlightFences);
+        free(app->frameInFlight);
+
+        // After the idle wait in mainLoop nothing retired is still in use
+        hotReloadStop(&app->hotReload);
+        pipelineStateCacheDestroy(&app->pipelineStates);
+        retireQueueFlush(&app->retireQueue, app->device);
+        retireQueueDestroy(&app->retireQueue);
+
+        if (app->timestampQueryPool != VK_NULL_HANDLE)
+                vkDestroyQueryPool(app->device, app->timestampQueryPool, NULL);
+
+        benchDestroy(&app->bench);
 
+        recorderDestroy(&app->recorder);
         vkDestroyCommandPool(app->device, app->commandPool, NULL);
+        vkDestroyCommandPool(app->device, app->computeCommandPool, NULL);
+        free(app->draws);
+        free(app->drawUniforms);
+        transformBatchDestroy(&app->transforms);
+        quadBatchDestroy(&app->quads);
 
         cleanUpSwapchain(app);
 
-        vkDestroyBuffer(app->device, app->indexBuffer, NULL);
-        vkFreeMemory(app->device, app->indexBufferMemory, NULL);
+        uniformRingDestroy(&app->uniformRing, app->device, &app->allocator);
+        vkDestroyDescriptorPool(app->device, app->frameDescriptorPool, NULL);
+
+        for (uint32_t i = 0; i < commandSlotCount(app); i++) {
+                vkDestroyBuffer(app->device, app->instanceBuffers[i], NULL);
+                allocatorFree(&app->allocator, &app->instanceAllocations[i]);
+        }
+
+        if (app->config.gpuCull) {
+                for (uint32_t i = 0; i < commandSlotCount(app); i++) {
+                        vkDestroyBuffer(app->device, app->indirectBuffers[i], NULL);
+                        allocatorFree(&app->allocator, &app->indirectAllocations[i]);
+                        vkDestroyBuffer(app->device, app->drawCountBuffers[i], NULL);
+                        allocatorFree(&app->allocator, &app->drawCountAllocations[i]);
+                }
+
+                vkDestroyDescriptorPool(app->device, app->cullDescriptorPool, NULL);
+        }
+
+        if (app->particleCount > 0)
+                vkDestroyDescriptorPool(app->device, app->particleDescriptorPool, NULL);
+
+        for (uint32_t i = 0; app->config.quadCount > 0 && i < commandSlotCount(app); i++) {
+                vkDestroyBuffer(app->device, app->quadVertexBuffers[i], NULL);
+                allocatorFree(&app->allocator, &app->quadVertexAllocations[i]);
+        }
+
+        textureManagerDestroy(&app->textures);
+
+        // Every frame has finished, so released objects go along with live ones
+        registryDestroy(&app->registry);
+
+        if (app->config.gpuCull) {
+                vkDestroyPipelineLayout(app->device, app->cullPipelineLayout, NULL);
+                vkDestroyDescriptorSetLayout(app->device, app->cullSetLayout, NULL);
+        }
+
+        if (app->config.particleCount > 0) {
+                vkDestroyPipelineLayout(app->device, app->particlePipelineLayout, NULL);
+                vkDestroyDescriptorSetLayout(app->device, app->particleSetLayout, NULL);
+        }
+
+        const char *cachePath = pipelineCachePath(app);
+        if (cachePath) {
+                const Result saveResult = pipelineCacheSave(
+                        app->device,
+                        app->pipelineCache,
+                        cachePath
+                );
 
-        vkDestroyBuffer(app->device, app->vertexBuffer, NULL);
-        vkFreeMemory(app->device, app->vertexBufferMemory, NULL);
+                if (saveResult.code != 0)
+                        fprintf(stderr, "WARN: %s\n", (const char *) saveResult.data);
+        }
 
-        vkDestroyPipeline(app->device, app->graphicsPipeline, NULL);
+        vkDestroyPipelineCache(app->device, app->pipelineCache, NULL);
         vkDestroyPipelineLayout(app->device, app->pipelineLayout, NULL);
+        vkDestroyDescriptorSetLayout(app->device, app->frameSetLayout, NULL);
+        bindlessDestroy(&app->bindless);
 
         vkDestroyRenderPass(app->device, app->renderPass, NULL);
 
+        uploadDestroy(&app->uploads, &app->allocator);
+        allocatorDestroy(&app->allocator);
         vkDestroyDevice(app->device, NULL);
 
         if (ENABLE_VALIDATION_LAYERS) {
@@ -1678,18 +5295,28 @@ static const Result cleanUp(App *app)
                 );
         }
 
-        vkDestroySurfaceKHR(app->instance, app->surface, NULL);
+        if (!app->config.headless)
+                vkDestroySurfaceKHR(app->instance, app->surface, NULL);
+
         vkDestroyInstance(app->instance, NULL);
 
-        glfwDestroyWindow(app->window);
-        glfwTerminate();
+        if (!app->config.headless) {
+                glfwDestroyWindow(app->window);
+                glfwTerminate();
+        }
+
         return RESULT_SUCCESS;
 }
 
 const Result appRun(App *app)
 {
         Result res;
-        handle(initWindow(app));
+        app->startTimeMs = benchNowMs();
+        app->bench.enabled = app->config.bench;
+        if (!app->config.headless) {
+                handle(initWindow(app));
+        }
+
         handle(initVulkan(app));
         handle(mainLoop(app));
         handle(cleanUp(app));
@@ -3,46 +3,243 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <cglm/types.h>
 #include <stdbool.h>
 
+#include "allocator.h"
+#include "bench.h"
+#include "bindless.h"
+#include "hotreload.h"
+#include "mesh.h"
+#include "pacing.h"
+#include "pipeline_cache.h"
+#include "pipeline_state.h"
+#include "quad_batch.h"
+#include "recorder.h"
+#include "registry.h"
+#include "retire.h"
+#include "texture.h"
+#include "transform.h"
+#include "uniform_ring.h"
+#include "upload.h"
+#include "result.h"
+
+// Upper bound on swapchain images, and so on cached command buffers
+#define MAX_COMMAND_SLOTS 8
+
+#define MAX_TEXTURE_FILES 16
+
+// Pipeline states cycled through the draw list, the default included
+#define MAX_PIPELINE_VARIANTS 6
+
+// Alpha blended and additive sprites
+#define QUAD_PIPELINE_COUNT 2
+
+// Per-instance vertex attributes, binding 1
+typedef struct instance {
+        mat4 transform;
+        vec4 color; // multiplied with the vertex color
+} Instance;
+
+// Set 0 binding 0, written into the uniform ring every frame
+typedef struct frameUniforms {
+        mat4 viewProjection;
+        vec4 time; // seconds since start, seconds since the previous frame
+} FrameUniforms;
+
+// Set 0 binding 1, one per entry in the draw list
+typedef struct drawUniforms {
+        vec4 tint; // multiplied with the vertex and instance colors
+} DrawUniforms;
+
+// Mirrors the vkCmdDrawIndexed parameters
+typedef struct drawCommand {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t firstInstance;
+} DrawCommand;
+
+typedef struct appConfig {
+        bool headless;
+        uint32_t frameCount; // 0 runs until the window closes
+        const char *readbackPath; // headless only, written as PPM
+        bool bench;
+        double durationSeconds; // 0 disables the time limit
+        const char *benchOutputPath; // NULL writes the report to stdout
+        const char *pipelineCachePath;
+        bool noPipelineCache;
+        bool cacheCommandBuffers; // record once per image, reuse until invalidated
+        uint32_t recordThreads; // 0 records inline on the main thread
+        uint32_t drawCount; // 0 draws the scene once
+        uint32_t instanceCount; // 0 draws a single instance
+        bool gpuCull; // frustum cull on the GPU and draw indirect
+        const char *meshPath; // NULL draws the built-in quad
+        const char *exportMeshPath; // writes the loaded mesh back out
+        const char *shaderDir; // maps <dir>/<name>.spv over the embedded SPIR-V
+        bool hotReload; // rebuild pipelines when their shader sources change
+        uint32_t resizeStormFrames; // resize the window every N frames, 0 disables
+        PacingProfile pacing;
+        double targetFps; // fixed-rate pacing only, 0 uses the default
+        bool renderPass; // keep the render pass even where dynamic rendering works
+        bool animate; // spin the instances, rebuilding their matrices every frame
+        uint32_t transformBenchObjects; // runs the transform microbenchmark instead
+        const char *deviceOverride; // part of a device name, or its UUID
+        bool noAsyncCompute; // keep compute work on the graphics queue
+        uint32_t particleCount; // simulated on the GPU and drawn over the scene, 0 disables
+        const char *texturePaths[MAX_TEXTURE_FILES]; // KTX2 or raw, streamed in
+        uint32_t textureFileCount;
+        uint32_t textureBudgetMiB; // 0 uses the default
+        uint32_t pipelineVariants; // states the draws cycle through, 0 or 1 for the default alone
+        uint32_t quadCount; // sprites batched every frame and drawn over the scene, 0 disables
+        uint32_t quadBenchCount; // runs the quad batch microbenchmark instead
+} AppConfig;
+
 typedef struct app {
+        AppConfig config;
         GLFWwindow *window;
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkSurfaceKHR surface;
         VkPhysicalDevice physicalDevice;
         VkDevice device;
+        Allocator allocator;
         VkQueue graphicsQueue;
         VkQueue presentQueue;
+        VkQueue transferQueue;
+        VkQueue computeQueue; // async compute, VK_NULL_HANDLE without a family for it
+        uint32_t graphicsFamily;
+        uint32_t transferFamily;
+        uint32_t computeFamily;
+        uint32_t asyncComputeFamily;
+        VkPhysicalDeviceFeatures enabledFeatures;
+        bool descriptorIndexing; // false leaves the bindless heap empty and draws untextured
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount; // NULL if unsupported
+        PFN_vkWaitForPresentKHR waitForPresent; // NULL without present id and wait
+        PFN_vkCmdBeginRenderingKHR cmdBeginRendering; // NULL on the render pass path
+        PFN_vkCmdEndRenderingKHR cmdEndRendering;
+        PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;
+        Pacer pacer;
         VkSwapchainKHR swapchain;
+        VkPresentModeKHR presentMode;
+        uint64_t presentId; // last id passed to vkQueuePresentKHR
         uint32_t swapchainImageCount;
         VkImage *swapchainImages;
         VkFormat swapchainImageFormat;
         VkExtent2D swapchainExtent;
         VkImageView *swapchainImageViews;
-        VkRenderPass renderPass;
+        Allocation *offscreenImageAllocations;
+        VkBuffer *readbackBuffers;
+        Allocation *readbackAllocations;
+        uint32_t offscreenImageIndex;
+        VkRenderPass renderPass; // VK_NULL_HANDLE with dynamic rendering
+        VkPipelineCache pipelineCache;
+        bool pipelineCacheWarm;
         VkPipelineLayout pipelineLayout;
-        VkPipeline graphicsPipeline;
-        VkFramebuffer *swapchainFramebuffers;
+        PipelineHandle graphicsPipeline;
+        PipelineState pipelineState; // the default state graphicsPipeline is built from
+        PipelineStateCache pipelineStates; // compiles the variants, when there are any
+        VkPipeline variantPipelines[MAX_PIPELINE_VARIANTS]; // bound per draw, the fallback until ready
+        VkDescriptorSetLayout cullSetLayout;
+        VkPipelineLayout cullPipelineLayout;
+        PipelineHandle cullPipeline;
+        VkDescriptorSetLayout particleSetLayout;
+        VkPipelineLayout particlePipelineLayout;
+        PipelineHandle particlePipeline;
+        VkFramebuffer *swapchainFramebuffers; // NULL with dynamic rendering
         VkCommandPool commandPool;
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
+        Mesh mesh;
+        Registry registry;
+        BufferHandle vertexBuffer;
+        BufferHandle indexBuffer;
+        UploadManager uploads;
+        UploadTicket geometryUploadTicket;
+        VkBuffer instanceBuffers[MAX_COMMAND_SLOTS];
+        Allocation instanceAllocations[MAX_COMMAND_SLOTS];
+        uint32_t instanceCount;
+        BufferHandle cullObjectBuffer;
+        uint32_t cullObjectCount;
+        VkBuffer indirectBuffers[MAX_COMMAND_SLOTS];
+        Allocation indirectAllocations[MAX_COMMAND_SLOTS];
+        VkBuffer drawCountBuffers[MAX_COMMAND_SLOTS];
+        Allocation drawCountAllocations[MAX_COMMAND_SLOTS];
+        VkDescriptorPool cullDescriptorPool;
+        VkDescriptorSet cullSets[MAX_COMMAND_SLOTS];
+        uint32_t particleCount;
+        BufferHandle particleBuffers[2]; // Instance layout, read one and write the other
+        VkDescriptorPool particleDescriptorPool;
+        VkDescriptorSet particleSets[2]; // set i reads buffer i
+        uint64_t particleSteps; // simulation steps recorded so far
+        uint32_t particleDrawBuffer; // written by the step in the frame being recorded
+        double particleGpuMs; // summed over every timed step
+        uint32_t particleTimedSteps;
+        TextureManager textures;
+        BindlessHeap bindless;
+        uint32_t textureSlots[MAX_TEXTURE_FILES]; // bindless slot of each texture's current image
+        VkImageView textureViews[MAX_TEXTURE_FILES]; // what each slot was written with
+        uint32_t textureGeneration; // of the texture manager, when the slots were last updated
+        QuadBatch quads;
+        PipelineHandle quadPipelines[QUAD_PIPELINE_COUNT];
+        BufferHandle quadIndexBuffer; // QUAD_INDEX_COUNT 16-bit indices, shared by every frame
+        VkBuffer quadVertexBuffers[MAX_COMMAND_SLOTS];
+        Allocation quadVertexAllocations[MAX_COMMAND_SLOTS];
+        DrawCommand *draws;
+        uint32_t drawCount;
+        DrawUniforms *drawUniforms; // copied into the ring every frame
+        mat4 viewProjection;
+        double lastUniformMs;
+        float frameDeltaSeconds; // between the last two frames' uniforms
+        UniformRing uniformRing;
+        TransformBatch transforms; // animated instances only
+        TransformKernel transformKernel;
+        VkDescriptorSetLayout frameSetLayout;
+        VkDescriptorPool frameDescriptorPool;
+        VkDescriptorSet frameSet; // written once, moved with dynamic offsets
+        uint32_t frameUniformOffsets[MAX_COMMAND_SLOTS];
+        uint32_t drawUniformOffsets[MAX_COMMAND_SLOTS];
+        Recorder recorder;
         VkCommandBuffer *commandBuffers;
+        VkCommandPool computeCommandPool; // async compute family only
+        VkCommandBuffer computeCommandBuffers[MAX_COMMAND_SLOTS];
+        VkSemaphore computeTimeline; // reaches a frame's number once its compute work finishes
         VkSemaphore *imageAvailableSemaphores;
         VkSemaphore *renderFinishedSemaphores;
-        VkFence *inFlightFences;
+        VkSemaphore graphicsTimeline; // reaches a frame's number once it finishes
+        uint64_t *frameInFlight; // frame number last submitted in each frame slot
+        uint64_t frameNumber; // frames submitted so far
+        uint64_t completedFrame; // every frame up to this one has finished
+        UploadTicket uploadWaitTicket; // the next frame waits for this upload, 0 for none
+        RetireQueue retireQueue;
+        HotReload hotReload;
+        uint64_t imageFrames[MAX_COMMAND_SLOTS]; // frame last submitted with each cached slot
+        uint32_t dirtySlots; // cached command buffers needing a re-record
+        bool dynamicContent; // opts out of command buffer caching
+        VkQueryPool timestampQueryPool;
+        float timestampPeriod;
+        uint64_t timestampMask;
+        uint32_t timestampsWritten; // bit per frame in flight
+        bool particleTimestamps; // the queue running the particle step has timestamps
+        uint64_t particleTimestampMask;
         bool framebufferResized;
+        bool swapchainSuspended; // minimised, nothing to draw to
+        double inputSampleMs; // when events were last polled
+        Bench bench;
+        double startTimeMs;
 } App;
 
-typedef struct result {
-        int code;
-        void *data;
-} Result;
+const Result appRun(struct app *app);
 
-extern const Result RESULT_SUCCESS;
+// Call whenever anything recorded into the command buffers changes: the
+// swapchain, a pipeline, or the geometry that is bound and drawn.
+void appInvalidateCommands(struct app *app);
 
-const Result appRun(struct app *app);
+// Mapped instance data read by the given command slot. Only safe to write
+// once that slot's previous submission has finished.
+Instance *appGetInstances(struct app *app, uint32_t slot);
+
+// One entry per draw in the draw list, then one for the particles. Copied
+// to the GPU as each frame is prepared, so it can be written at any time.
+DrawUniforms *appGetDrawUniforms(struct app *app);
 
 #endif
@@ -0,0 +1,202 @@
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const uint32_t INITIAL_SAMPLE_CAPACITY = 1024;
+
+double benchNowMs()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec * 1000.0 + (double) ts.tv_nsec / 1000000.0;
+}
+
+static BenchSeries *findSeries(Bench *bench, const char *name)
+{
+        for (uint32_t i = 0; i < bench->seriesCount; i++) {
+                if (strcmp(bench->series[i].name, name) == 0)
+                        return &bench->series[i];
+        }
+
+        if (bench->seriesCount == BENCH_MAX_SERIES)
+                return NULL;
+
+        BenchSeries *series = &bench->series[bench->seriesCount++];
+        *series = (BenchSeries) { .name = name };
+        return series;
+}
+
+void benchRecord(Bench *bench, const char *name, double sample)
+{
+        if (!bench->enabled)
+                return;
+
+        BenchSeries *series = findSeries(bench, name);
+        if (!series)
+                return;
+
+        if (series->count == series->capacity) {
+                const uint32_t capacity = series->capacity
+                        ? series->capacity * 2
+                        : INITIAL_SAMPLE_CAPACITY;
+
+                double *samples = realloc(series->samples, sizeof(double) * capacity);
+                if (!samples)
+                        return;
+
+                series->samples = samples;
+                series->capacity = capacity;
+        }
+
+        series->samples[series->count++] = sample;
+}
+
+void benchSetValue(Bench *bench, const char *name, double value)
+{
+        if (!bench->enabled)
+                return;
+
+        for (uint32_t i = 0; i < bench->valueCount; i++) {
+                if (strcmp(bench->values[i].name, name) == 0) {
+                        bench->values[i].value = value;
+                        return;
+                }
+        }
+
+        if (bench->valueCount < BENCH_MAX_VALUES) {
+                bench->values[bench->valueCount++] = (BenchValue) {
+                        .name = name,
+                        .value = value,
+                };
+        }
+}
+
+void benchSetLabel(Bench *bench, const char *name, const char *value)
+{
+        if (!bench->enabled)
+                return;
+
+        BenchLabel *label = NULL;
+        for (uint32_t i = 0; i < bench->labelCount; i++) {
+                if (strcmp(bench->labels[i].name, name) == 0)
+                        label = &bench->labels[i];
+        }
+
+        if (!label) {
+                if (bench->labelCount == BENCH_MAX_LABELS)
+                        return;
+
+                label = &bench->labels[bench->labelCount++];
+                label->name = name;
+        }
+
+        snprintf(label->value, BENCH_LABEL_LENGTH, "%s", value);
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+        const double x = *(const double *) a;
+        const double y = *(const double *) b;
+        return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile over an already sorted array
+static double percentile(const double *sorted, uint32_t count, double p)
+{
+        uint32_t rank = (uint32_t) ceil(p / 100.0 * count);
+        if (rank == 0)
+                rank = 1;
+
+        return sorted[rank - 1];
+}
+
+static void writeSeries(FILE *fp, const BenchSeries *series)
+{
+        double *sorted = malloc(sizeof(double) * series->count);
+        memcpy(sorted, series->samples, sizeof(double) * series->count);
+        qsort(sorted, series->count, sizeof(double), compareDoubles);
+
+        double sum = 0.0;
+        for (uint32_t i = 0; i < series->count; i++)
+                sum += sorted[i];
+
+        fprintf(
+                fp,
+                "  \"%s\": { \"count\": %u, \"mean\": %.6f, \"p50\": %.6f, "
+                        "\"p95\": %.6f, \"p99\": %.6f, \"max\": %.6f }",
+                series->name,
+                series->count,
+                sum / series->count,
+                percentile(sorted, series->count, 50.0),
+                percentile(sorted, series->count, 95.0),
+                percentile(sorted, series->count, 99.0),
+                sorted[series->count - 1]
+        );
+
+        free(sorted);
+}
+
+const Result benchWriteJson(const Bench *bench, const char *path)
+{
+        if (!bench->enabled)
+                return RESULT_SUCCESS;
+
+        FILE *fp = path ? fopen(path, "w") : stdout;
+        if (!fp)
+                return RESULT_ERROR(-1, "failed to open bench output file!");
+
+        bool first = true;
+        fprintf(fp, "{\n");
+
+        for (uint32_t i = 0; i < bench->labelCount; i++) {
+                fprintf(fp, "%s  \"%s\": \"", first ? "" : ",\n", bench->labels[i].name);
+                for (const char *c = bench->labels[i].value; *c; c++) {
+                        if (*c == '"' || *c == '\\')
+                                fputc('\\', fp);
+                        fputc(*c, fp);
+                }
+                fputc('"', fp);
+                first = false;
+        }
+
+        for (uint32_t i = 0; i < bench->valueCount; i++) {
+                fprintf(
+                        fp,
+                        "%s  \"%s\": %.6f",
+                        first ? "" : ",\n",
+                        bench->values[i].name,
+                        bench->values[i].value
+                );
+                first = false;
+        }
+
+        for (uint32_t i = 0; i < bench->seriesCount; i++) {
+                if (bench->series[i].count == 0)
+                        continue;
+
+                fprintf(fp, "%s", first ? "" : ",\n");
+                writeSeries(fp, &bench->series[i]);
+                first = false;
+        }
+
+        fprintf(fp, "\n}\n");
+
+        if (path)
+                fclose(fp);
+
+        return RESULT_SUCCESS;
+}
+
+void benchDestroy(Bench *bench)
+{
+        for (uint32_t i = 0; i < bench->seriesCount; i++)
+                free(bench->series[i].samples);
+
+        bench->seriesCount = 0;
+        bench->valueCount = 0;
+        bench->labelCount = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "result.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BENCH_MAX_SERIES 16
+#define BENCH_MAX_VALUES 48
+#define BENCH_MAX_LABELS 12
+#define BENCH_LABEL_LENGTH 256
+
+typedef struct benchSeries {
+        const char *name;
+        double *samples;
+        uint32_t count;
+        uint32_t capacity;
+} BenchSeries;
+
+typedef struct benchValue {
+        const char *name;
+        double value;
+} BenchValue;
+
+typedef struct benchLabel {
+        const char *name;
+        char value[BENCH_LABEL_LENGTH];
+} BenchLabel;
+
+// Collects per-frame samples (reported as percentiles) plus one-off values
+// and labels, and writes them out as a flat JSON object. Every function is a
+// no-op while the bench is disabled so call sites need no guards.
+typedef struct bench {
+        bool enabled;
+        uint32_t seriesCount;
+        BenchSeries series[BENCH_MAX_SERIES];
+        uint32_t valueCount;
+        BenchValue values[BENCH_MAX_VALUES];
+        uint32_t labelCount;
+        BenchLabel labels[BENCH_MAX_LABELS];
+} Bench;
+
+double benchNowMs();
+
+void benchRecord(Bench *bench, const char *name, double sample);
+void benchSetValue(Bench *bench, const char *name, double value);
+void benchSetLabel(Bench *bench, const char *name, const char *value);
+
+// Writes to stdout when path is NULL
+const Result benchWriteJson(const Bench *bench, const char *path);
+void benchDestroy(Bench *bench);
+
+#endif
@@ -0,0 +1,347 @@
+#include "bindless.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Room left under the per-stage limits for the other sets in a layout
+static const uint32_t RESERVED_DESCRIPTORS = 8;
+
+static uint32_t minU32(uint32_t a, uint32_t b)
+{
+        return a < b ? a : b;
+}
+
+// What a per-stage limit leaves after the reservation, 0 below it
+static uint32_t usableDescriptors(uint32_t limit)
+{
+        return limit > RESERVED_DESCRIPTORS ? limit - RESERVED_DESCRIPTORS : 0;
+}
+
+static const Result slotsInit(BindlessSlots *slots, uint32_t capacity)
+{
+        slots->capacity = capacity;
+        atomic_init(&slots->unused, 0);
+        atomic_init(&slots->freeHead, 0);
+        atomic_init(&slots->retiredHead, 0);
+        atomic_init(&slots->liveCount, 0);
+
+        if (capacity == 0)
+                return RESULT_SUCCESS;
+
+        slots->next = calloc(capacity, sizeof(*slots->next));
+        slots->retireFrames = calloc(capacity, sizeof(uint64_t));
+        if (!slots->next || !slots->retireFrames)
+                return RESULT_ERROR(-1, "failed to allocate bindless slots!");
+
+        for (uint32_t i = 0; i < capacity; i++)
+                atomic_init(&slots->next[i], 0);
+
+        return RESULT_SUCCESS;
+}
+
+static void slotsDestroy(BindlessSlots *slots)
+{
+        free(slots->next);
+        free(slots->retireFrames);
+        slots->next = NULL;
+        slots->retireFrames = NULL;
+        slots->capacity = 0;
+}
+
+static uint32_t slotsAcquire(BindlessSlots *slots)
+{
+        // A stale next[] read only happens when another thread popped the
+        // slot first, and then the tag has moved on and the exchange fails
+        uint64_t head = atomic_load(&slots->freeHead);
+        while ((uint32_t) head != 0) {
+                const uint32_t slot = (uint32_t) head - 1;
+                const uint64_t below = atomic_load(&slots->next[slot]);
+                const uint64_t tag = (head >> 32) + 1;
+                if (atomic_compare_exchange_weak(&slots->freeHead, &head, tag << 32 | below)) {
+                        atomic_fetch_add(&slots->liveCount, 1);
+                        return slot;
+                }
+        }
+
+        uint32_t unused = atomic_load(&slots->unused);
+        while (unused < slots->capacity) {
+                if (atomic_compare_exchange_weak(&slots->unused, &unused, unused + 1)) {
+                        atomic_fetch_add(&slots->liveCount, 1);
+                        return unused;
+                }
+        }
+
+        return BINDLESS_INVALID;
+}
+
+static void slotsPushFree(BindlessSlots *slots, uint32_t slot)
+{
+        uint64_t head = atomic_load(&slots->freeHead);
+        do {
+                atomic_store(&slots->next[slot], (uint32_t) head);
+        } while (!atomic_compare_exchange_weak(
+                &slots->freeHead,
+                &head,
+                ((head >> 32) + 1) << 32 | (slot + 1)
+        ));
+}
+
+// Only ever drained whole, so this stack needs no tag
+static void slotsPushRetired(BindlessSlots *slots, uint32_t slot)
+{
+        uint32_t head = atomic_load(&slots->retiredHead);
+        do {
+                atomic_store(&slots->next[slot], head);
+        } while (!atomic_compare_exchange_weak(&slots->retiredHead, &head, slot + 1));
+}
+
+static void slotsRelease(BindlessSlots *slots, uint32_t slot, uint64_t lastUsedFrame)
+{
+        if (slot >= slots->capacity)
+                return;
+
+        slots->retireFrames[slot] = lastUsedFrame;
+        slotsPushRetired(slots, slot);
+        atomic_fetch_sub(&slots->liveCount, 1);
+}
+
+static void slotsCollect(BindlessSlots *slots, uint64_t completedFrame)
+{
+        uint32_t entry = atomic_exchange(&slots->retiredHead, 0);
+        while (entry != 0) {
+                const uint32_t slot = entry - 1;
+                entry = atomic_load(&slots->next[slot]);
+                if (slots->retireFrames[slot] <= completedFrame)
+                        slotsPushFree(slots, slot);
+                else
+                        slotsPushRetired(slots, slot);
+        }
+}
+
+const Result bindlessCreate(
+        BindlessHeap *heap,
+        VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        uint32_t textureCapacity,
+        uint32_t bufferCapacity
+) {
+        memset(heap, 0, sizeof(BindlessHeap));
+        heap->device = device;
+
+        VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES,
+        };
+
+        VkPhysicalDeviceProperties2 properties = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                .pNext = &indexingProperties,
+        };
+
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+        // Combined image samplers count against both image and sampler limits
+        textureCapacity = minU32(textureCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+        textureCapacity = minU32(textureCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindSamplers);
+        textureCapacity = minU32(
+                textureCapacity,
+                usableDescriptors(indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages)
+        );
+        textureCapacity = minU32(
+                textureCapacity,
+                usableDescriptors(indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers)
+        );
+
+        bufferCapacity = minU32(
+                bufferCapacity,
+                usableDescriptors(indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers)
+        );
+        bufferCapacity = minU32(
+                bufferCapacity,
+                usableDescriptors(indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers)
+        );
+
+        // Each combined image sampler is a single resource
+        const uint32_t resources = usableDescriptors(indexingProperties.maxPerStageUpdateAfterBindResources);
+        textureCapacity = minU32(textureCapacity, resources / 2);
+        bufferCapacity = minU32(bufferCapacity, resources - textureCapacity);
+
+        // The shaders sample the textures, where nothing reads the buffers
+        // yet, so only an empty texture binding is fatal
+        if (textureCapacity == 0)
+                return RESULT_ERROR(-1, "no room for bindless textures under the device limits!");
+
+        Result res;
+        handle(slotsInit(&heap->textures, textureCapacity));
+        handle(slotsInit(&heap->buffers, bufferCapacity));
+
+        const VkDescriptorSetLayoutBinding bindings[] = {
+                {
+                        .binding = BINDLESS_TEXTURE_BINDING,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .descriptorCount = textureCapacity,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+                                | VK_SHADER_STAGE_FRAGMENT_BIT,
+                },
+                {
+                        .binding = BINDLESS_BUFFER_BINDING,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = bufferCapacity,
+                        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT
+                                | VK_SHADER_STAGE_FRAGMENT_BIT,
+                },
+        };
+
+        const VkDescriptorBindingFlags bindingFlags[] = {
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                        | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                        | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT,
+        };
+
+        const VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+                .bindingCount = 2,
+                .pBindingFlags = bindingFlags,
+        };
+
+        const VkDescriptorSetLayoutCreateInfo layoutInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .pNext = &bindingFlagsInfo,
+                .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+                .bindingCount = 2,
+                .pBindings = bindings,
+        };
+
+        VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &heap->setLayout);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create bindless descriptor set layout!");
+
+        // Zero-count pool sizes are invalid, so an empty buffer binding
+        // gets none
+        const VkDescriptorPoolSize poolSizes[] = {
+                {
+                        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .descriptorCount = textureCapacity,
+                },
+                {
+                        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .descriptorCount = bufferCapacity,
+                },
+        };
+
+        const VkDescriptorPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+                .maxSets = 1,
+                .poolSizeCount = bufferCapacity > 0 ? 2 : 1,
+                .pPoolSizes = poolSizes,
+        };
+
+        result = vkCreateDescriptorPool(device, &poolInfo, NULL, &heap->pool);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create bindless descriptor pool!");
+
+        const VkDescriptorSetAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = heap->pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &heap->setLayout,
+        };
+
+        result = vkAllocateDescriptorSets(device, &allocInfo, &heap->set);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate bindless descriptor set!");
+
+        return RESULT_SUCCESS;
+}
+
+void bindlessDestroy(BindlessHeap *heap)
+{
+        vkDestroyDescriptorPool(heap->device, heap->pool, NULL);
+        vkDestroyDescriptorSetLayout(heap->device, heap->setLayout, NULL);
+        slotsDestroy(&heap->textures);
+        slotsDestroy(&heap->buffers);
+        heap->pool = VK_NULL_HANDLE;
+        heap->setLayout = VK_NULL_HANDLE;
+        heap->set = VK_NULL_HANDLE;
+}
+
+uint32_t bindlessAddTexture(
+        BindlessHeap *heap,
+        VkImageView view,
+        VkImageLayout layout,
+        VkSampler sampler
+) {
+        const uint32_t slot = slotsAcquire(&heap->textures);
+        if (slot == BINDLESS_INVALID)
+                return BINDLESS_INVALID;
+
+        const VkDescriptorImageInfo imageInfo = {
+                .sampler = sampler,
+                .imageView = view,
+                .imageLayout = layout,
+        };
+
+        // The slot is this thread's alone until released, which is all
+        // update-after-bind bindings ask of concurrent writers
+        const VkWriteDescriptorSet write = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = heap->set,
+                .dstBinding = BINDLESS_TEXTURE_BINDING,
+                .dstArrayElement = slot,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &imageInfo,
+        };
+
+        vkUpdateDescriptorSets(heap->device, 1, &write, 0, NULL);
+        return slot;
+}
+
+uint32_t bindlessAddBuffer(
+        BindlessHeap *heap,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkDeviceSize range
+) {
+        const uint32_t slot = slotsAcquire(&heap->buffers);
+        if (slot == BINDLESS_INVALID)
+                return BINDLESS_INVALID;
+
+        const VkDescriptorBufferInfo bufferInfo = {
+                .buffer = buffer,
+                .offset = offset,
+                .range = range,
+        };
+
+        const VkWriteDescriptorSet write = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = heap->set,
+                .dstBinding = BINDLESS_BUFFER_BINDING,
+                .dstArrayElement = slot,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &bufferInfo,
+        };
+
+        vkUpdateDescriptorSets(heap->device, 1, &write, 0, NULL);
+        return slot;
+}
+
+void bindlessReleaseTexture(BindlessHeap *heap, uint32_t slot, uint64_t lastUsedFrame)
+{
+        slotsRelease(&heap->textures, slot, lastUsedFrame);
+}
+
+void bindlessReleaseBuffer(BindlessHeap *heap, uint32_t slot, uint64_t lastUsedFrame)
+{
+        slotsRelease(&heap->buffers, slot, lastUsedFrame);
+}
+
+void bindlessCollect(BindlessHeap *heap, uint64_t completedFrame)
+{
+        slotsCollect(&heap->textures, completedFrame);
+        slotsCollect(&heap->buffers, completedFrame);
+}
@@ -0,0 +1,76 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include "result.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Never a valid slot; shaders skip sampling on it
+#define BINDLESS_INVALID UINT32_MAX
+
+#define BINDLESS_TEXTURE_BINDING 0
+#define BINDLESS_BUFFER_BINDING 1
+
+// Slot allocator for one binding. Free slots form a Treiber stack whose
+// head carries a tag against ABA; released slots wait on a second stack
+// until the frames that may read them have finished. Both are linked
+// through next[].
+typedef struct bindlessSlots {
+        uint32_t capacity;
+        _Atomic uint32_t unused; // first slot never handed out
+        _Atomic uint64_t freeHead; // tag << 32 | slot + 1, slot + 1 == 0 when empty
+        _Atomic uint32_t retiredHead; // slot + 1, 0 when empty
+        _Atomic uint32_t *next; // slot + 1 of the entry below, 0 at the bottom
+        uint64_t *retireFrames;
+        _Atomic uint32_t liveCount;
+} BindlessSlots;
+
+// One descriptor set holding every texture and storage buffer, bound once
+// per command buffer. Shaders index the arrays with slots passed in push
+// constants. The bindings are partially bound and update-after-bind, so
+// slots can be written while command buffers using other slots are
+// pending, and different slots can be written from different threads.
+typedef struct bindlessHeap {
+        VkDevice device;
+        VkDescriptorSetLayout setLayout;
+        VkDescriptorPool pool;
+        VkDescriptorSet set;
+        BindlessSlots textures; // combined image samplers
+        BindlessSlots buffers; // storage buffers
+} BindlessHeap;
+
+// The capacities are clamped to the device's update-after-bind limits
+const Result bindlessCreate(
+        BindlessHeap *heap,
+        VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        uint32_t textureCapacity,
+        uint32_t bufferCapacity
+);
+void bindlessDestroy(BindlessHeap *heap);
+
+// Thread-safe and lock-free. Return the slot written, or BINDLESS_INVALID
+// when the binding is full.
+uint32_t bindlessAddTexture(
+        BindlessHeap *heap,
+        VkImageView view,
+        VkImageLayout layout,
+        VkSampler sampler
+);
+uint32_t bindlessAddBuffer(
+        BindlessHeap *heap,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkDeviceSize range
+);
+
+// Thread-safe and lock-free. The slot is reused once lastUsedFrame has
+// completed, as seen by bindlessCollect.
+void bindlessReleaseTexture(BindlessHeap *heap, uint32_t slot, uint64_t lastUsedFrame);
+void bindlessReleaseBuffer(BindlessHeap *heap, uint32_t slot, uint64_t lastUsedFrame);
+
+// Frees retired slots whose frame has completed. One thread at a time.
+void bindlessCollect(BindlessHeap *heap, uint64_t completedFrame);
+
+#endif
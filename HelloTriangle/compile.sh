@@ -1,2 +1,16 @@
 /bin/glslc ./shaders/shader.vert -o ./shaders/vert.spv
 /bin/glslc ./shaders/shader.frag -o ./shaders/frag.spv
+/bin/glslc ./shaders/shader.frag -DUNTEXTURED -o ./shaders/frag_untextured.spv
+/bin/glslc ./shaders/cull.comp -o ./shaders/cull.spv
+/bin/glslc ./shaders/particles.comp -o ./shaders/particles.spv
+/bin/glslc ./shaders/quad.vert -o ./shaders/quad_vert.spv
+/bin/glslc ./shaders/quad.frag -o ./shaders/quad_frag.spv
+
+# Same SPIR-V as comma-separated words, included by shaders.c
+/bin/glslc ./shaders/shader.vert -mfmt=num -o ./shaders/vert.spv.inc
+/bin/glslc ./shaders/shader.frag -mfmt=num -o ./shaders/frag.spv.inc
+/bin/glslc ./shaders/shader.frag -DUNTEXTURED -mfmt=num -o ./shaders/frag_untextured.spv.inc
+/bin/glslc ./shaders/cull.comp -mfmt=num -o ./shaders/cull.spv.inc
+/bin/glslc ./shaders/particles.comp -mfmt=num -o ./shaders/particles.spv.inc
+/bin/glslc ./shaders/quad.vert -mfmt=num -o ./shaders/quad_vert.spv.inc
+/bin/glslc ./shaders/quad.frag -mfmt=num -o ./shaders/quad_frag.spv.inc
@@ -0,0 +1,40 @@
+#include "hash.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+uint64_t hashBytes(const void *data, size_t size)
+{
+        const unsigned char *bytes = data;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+        }
+
+        return hash != 0 ? hash : 1;
+}
+
+uint32_t hashFindSlot(
+        const void *entries,
+        size_t stride,
+        uint32_t capacity,
+        uint64_t hash,
+        const void *key,
+        size_t keyOffset,
+        size_t keySize
+) {
+        uint32_t index = (uint32_t) hash & (capacity - 1);
+        while (true) {
+                const char *entry = (const char *) entries + stride * index;
+                uint64_t entryHash;
+                memcpy(&entryHash, entry, sizeof(uint64_t));
+                if (entryHash == 0)
+                        return index;
+
+                if (entryHash == hash && memcmp(entry + keyOffset, key, keySize) == 0)
+                        return index;
+
+                index = (index + 1) & (capacity - 1);
+        }
+}
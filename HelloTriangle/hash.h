@@ -0,0 +1,24 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// FNV-1a over size bytes, never 0 so that can mark empty slots
+uint64_t hashBytes(const void *data, size_t size);
+
+// Linear probing over an open-addressed table of capacity (a power of two)
+// entries, stride bytes apart. Each entry starts with its uint64_t hash, 0
+// when empty, and holds its key keyOffset bytes in; keys are compared
+// bytewise. Returns the index holding key, or the empty one it would go in.
+uint32_t hashFindSlot(
+        const void *entries,
+        size_t stride,
+        uint32_t capacity,
+        uint64_t hash,
+        const void *key,
+        size_t keyOffset,
+        size_t keySize
+);
+
+#endif
@@ -0,0 +1,259 @@
+#include "hotreload.h"
+#include "bench.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// Editors save in bursts (truncate, write, rename), so wait for quiet
+static const int SETTLE_MS = 50;
+
+// glslc truncates and rewrites its output, which shaderLoad may be mapping
+// at the same time, so it writes beside the target and is renamed over it
+static bool compileShader(const HotReload *hotReload, const HotReloadShader *shader)
+{
+        char source[PATH_MAX];
+        char output[PATH_MAX];
+        char temporary[PATH_MAX];
+        char define[PATH_MAX];
+        snprintf(source, sizeof(source), "%s/%s", hotReload->sourceDir, shader->source);
+        snprintf(output, sizeof(output), "%s/%s.spv", hotReload->outputDir, shader->name);
+        snprintf(temporary, sizeof(temporary), "%s.tmp", output);
+        snprintf(define, sizeof(define), "-D%s", shader->define ? shader->define : "");
+
+        char *const argv[] = { "glslc", source, "-o", temporary, shader->define ? define : NULL, NULL };
+        pid_t pid;
+        if (posix_spawnp(&pid, "glslc", NULL, NULL, argv, environ) != 0) {
+                fprintf(stderr, "WARN: failed to run glslc\n");
+                return false;
+        }
+
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+                if (errno != EINTR)
+                        return false;
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                unlink(temporary);
+                return false;
+        }
+
+        if (rename(temporary, output) != 0) {
+                fprintf(stderr, "WARN: failed to replace %s\n", output);
+                unlink(temporary);
+                return false;
+        }
+
+        return true;
+}
+
+// Reads every queued event, marking the shaders they touch
+static void drainEvents(HotReload *hotReload, bool changed[HOT_RELOAD_MAX_SHADERS])
+{
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        for (;;) {
+                const ssize_t length = read(hotReload->inotifyFd, buffer, sizeof(buffer));
+                if (length <= 0)
+                        return;
+
+                for (char *p = buffer; p < buffer + length;) {
+                        const struct inotify_event *event = (const struct inotify_event *) p;
+                        for (uint32_t i = 0; event->len > 0 && i < hotReload->shaderCount; i++) {
+                                if (strcmp(event->name, hotReload->shaders[i].source) == 0)
+                                        changed[i] = true;
+                        }
+
+                        p += sizeof(struct inotify_event) + event->len;
+                }
+        }
+}
+
+static void reloadTarget(HotReload *hotReload, uint32_t target, double start)
+{
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES] = {0};
+        const Result result = hotReload->build(hotReload->userData, target, pipelines);
+        if (result.code != 0) {
+                fprintf(stderr, "WARN: hot reload: %s\n", (const char *) result.data);
+                return;
+        }
+
+        pthread_mutex_lock(&hotReload->mutex);
+
+        // Never submitted, so superseded pipelines can go right away
+        for (uint32_t i = 0; i < HOT_RELOAD_MAX_PIPELINES; i++) {
+                vkDestroyPipeline(hotReload->device, hotReload->pending[target][i], NULL);
+                hotReload->pending[target][i] = pipelines[i];
+        }
+
+        hotReload->pendingMs[target] = benchNowMs() - start;
+        pthread_mutex_unlock(&hotReload->mutex);
+}
+
+static void reload(HotReload *hotReload, const bool changed[HOT_RELOAD_MAX_SHADERS])
+{
+        const double start = benchNowMs();
+        bool touched[HOT_RELOAD_MAX_TARGETS] = {0};
+        bool failed[HOT_RELOAD_MAX_TARGETS] = {0};
+        for (uint32_t i = 0; i < hotReload->shaderCount; i++) {
+                if (!changed[i])
+                        continue;
+
+                // glslc has already printed why; the target keeps its old
+                // pipelines
+                const HotReloadShader *shader = &hotReload->shaders[i];
+                touched[shader->target] = true;
+                if (!compileShader(hotReload, shader))
+                        failed[shader->target] = true;
+        }
+
+        for (uint32_t target = 0; target < HOT_RELOAD_MAX_TARGETS; target++) {
+                if (touched[target] && !failed[target])
+                        reloadTarget(hotReload, target, start);
+        }
+}
+
+static void *reloadMain(void *arg)
+{
+        HotReload *hotReload = arg;
+        struct pollfd fds[] = {
+                { .fd = hotReload->inotifyFd, .events = POLLIN },
+                { .fd = hotReload->stopPipe[0], .events = POLLIN },
+        };
+
+        for (;;) {
+                if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        break;
+                }
+
+                if (fds[1].revents)
+                        break;
+
+                bool changed[HOT_RELOAD_MAX_SHADERS] = {0};
+                do {
+                        drainEvents(hotReload, changed);
+                } while (poll(fds, 1, SETTLE_MS) > 0);
+
+                reload(hotReload, changed);
+        }
+
+        return NULL;
+}
+
+const Result hotReloadStart(
+        HotReload *hotReload,
+        VkDevice device,
+        const char *sourceDir,
+        const char *outputDir,
+        const HotReloadShader *shaders,
+        uint32_t shaderCount,
+        HotReloadBuildFn build,
+        void *userData
+) {
+        if (shaderCount > HOT_RELOAD_MAX_SHADERS)
+                return RESULT_ERROR(-1, "too many shaders to hot reload!");
+
+        *hotReload = (HotReload) {
+                .device = device,
+                .sourceDir = sourceDir,
+                .outputDir = outputDir,
+                .shaderCount = shaderCount,
+                .build = build,
+                .userData = userData,
+                .inotifyFd = -1,
+                .stopPipe = { -1, -1 },
+        };
+
+        for (uint32_t i = 0; i < shaderCount; i++) {
+                if (shaders[i].target >= HOT_RELOAD_MAX_TARGETS)
+                        return RESULT_ERROR(-1, "hot reload target out of range!");
+
+                hotReload->shaders[i] = shaders[i];
+        }
+
+        hotReload->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (hotReload->inotifyFd < 0)
+                return RESULT_ERROR(-1, "failed to initialise inotify!");
+
+        // Covers both in-place writes and editors that save by renaming
+        if (inotify_add_watch(
+                hotReload->inotifyFd,
+                sourceDir,
+                IN_CLOSE_WRITE | IN_MOVED_TO
+        ) < 0) {
+                close(hotReload->inotifyFd);
+                return RESULT_ERROR(-1, "failed to watch the shader directory!");
+        }
+
+        if (pipe(hotReload->stopPipe) != 0) {
+                close(hotReload->inotifyFd);
+                return RESULT_ERROR(-1, "failed to create hot reload pipe!");
+        }
+
+        pthread_mutex_init(&hotReload->mutex, NULL);
+        if (pthread_create(&hotReload->thread, NULL, reloadMain, hotReload) != 0) {
+                pthread_mutex_destroy(&hotReload->mutex);
+                close(hotReload->stopPipe[0]);
+                close(hotReload->stopPipe[1]);
+                close(hotReload->inotifyFd);
+                return RESULT_ERROR(-1, "failed to start hot reload thread!");
+        }
+
+        hotReload->running = true;
+        return RESULT_SUCCESS;
+}
+
+void hotReloadStop(HotReload *hotReload)
+{
+        if (!hotReload->running)
+                return;
+
+        const char stop = 1;
+        if (write(hotReload->stopPipe[1], &stop, 1) != 1)
+                fprintf(stderr, "WARN: failed to signal hot reload thread\n");
+
+        pthread_join(hotReload->thread, NULL);
+        close(hotReload->stopPipe[0]);
+        close(hotReload->stopPipe[1]);
+        close(hotReload->inotifyFd);
+
+        for (uint32_t target = 0; target < HOT_RELOAD_MAX_TARGETS; target++) {
+                for (uint32_t i = 0; i < HOT_RELOAD_MAX_PIPELINES; i++)
+                        vkDestroyPipeline(hotReload->device, hotReload->pending[target][i], NULL);
+        }
+
+        pthread_mutex_destroy(&hotReload->mutex);
+        hotReload->running = false;
+}
+
+bool hotReloadTake(
+        HotReload *hotReload,
+        uint32_t target,
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES],
+        double *pReloadMs
+) {
+        if (!hotReload->running)
+                return false;
+
+        pthread_mutex_lock(&hotReload->mutex);
+        for (uint32_t i = 0; i < HOT_RELOAD_MAX_PIPELINES; i++) {
+                pipelines[i] = hotReload->pending[target][i];
+                hotReload->pending[target][i] = VK_NULL_HANDLE;
+        }
+
+        *pReloadMs = hotReload->pendingMs[target];
+        pthread_mutex_unlock(&hotReload->mutex);
+
+        return pipelines[0] != VK_NULL_HANDLE;
+}
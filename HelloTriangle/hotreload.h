@@ -0,0 +1,77 @@
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include "result.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define HOT_RELOAD_MAX_SHADERS 16
+#define HOT_RELOAD_MAX_TARGETS 8
+#define HOT_RELOAD_MAX_PIPELINES 4 // per target
+
+// One watched source file. glslc compiles it to <name>.spv in the output
+// directory, as shaderLoad expects, and target is rebuilt afterwards. A
+// source may be listed more than once, e.g. with different defines.
+typedef struct hotReloadShader {
+        const char *source;
+        const char *name;
+        const char *define; // passed as -D, NULL for none
+        uint32_t target; // below HOT_RELOAD_MAX_TARGETS
+} HotReloadShader;
+
+// Builds every pipeline of target from the freshly compiled shaders,
+// leaving the unused entries VK_NULL_HANDLE. Called on the reload thread,
+// so it may only read state the render thread does not modify.
+typedef const Result (*HotReloadBuildFn)(
+        void *userData,
+        uint32_t target,
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES]
+);
+
+// Watches the shader sources with inotify. A change is compiled with glslc
+// into the output directory and the targets using it are rebuilt, all on a
+// background thread; the render thread picks them up with hotReloadTake.
+typedef struct hotReload {
+        VkDevice device;
+        const char *sourceDir;
+        const char *outputDir;
+        HotReloadShader shaders[HOT_RELOAD_MAX_SHADERS];
+        uint32_t shaderCount;
+        HotReloadBuildFn build;
+        void *userData;
+
+        pthread_t thread;
+        bool running;
+        int inotifyFd;
+        int stopPipe[2];
+
+        pthread_mutex_t mutex;
+        // Built but not yet taken, with the time from compile to pipeline
+        VkPipeline pending[HOT_RELOAD_MAX_TARGETS][HOT_RELOAD_MAX_PIPELINES];
+        double pendingMs[HOT_RELOAD_MAX_TARGETS];
+} HotReload;
+
+const Result hotReloadStart(
+        HotReload *hotReload,
+        VkDevice device,
+        const char *sourceDir,
+        const char *outputDir,
+        const HotReloadShader *shaders,
+        uint32_t shaderCount,
+        HotReloadBuildFn build,
+        void *userData
+);
+void hotReloadStop(HotReload *hotReload);
+
+// Hands over target's newest pipelines and how long they took, if any were
+// built since the last call
+bool hotReloadTake(
+        HotReload *hotReload,
+        uint32_t target,
+        VkPipeline pipelines[HOT_RELOAD_MAX_PIPELINES],
+        double *pReloadMs
+);
+
+#endif
@@ -1,11 +1,136 @@
 #include "app.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-int main()
+static int parseArgs(AppConfig *config, int argc, char **argv)
 {
-        App app;
-        Result result = appRun(&app);
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--headless") == 0) {
+                        config->headless = true;
+                } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                        config->frameCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--readback") == 0 && i + 1 < argc) {
+                        config->readbackPath = argv[++i];
+                } else if (strcmp(argv[i], "--bench") == 0) {
+                        config->bench = true;
+                } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+                        config->durationSeconds = strtod(argv[++i], NULL);
+                } else if (strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc) {
+                        config->benchOutputPath = argv[++i];
+                } else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc) {
+                        config->pipelineCachePath = argv[++i];
+                } else if (strcmp(argv[i], "--no-pipeline-cache") == 0) {
+                        config->noPipelineCache = true;
+                } else if (strcmp(argv[i], "--cache-commands") == 0) {
+                        config->cacheCommandBuffers = true;
+                } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                        config->recordThreads = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+                        config->instanceCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+                        config->meshPath = argv[++i];
+                } else if (strcmp(argv[i], "--export-mesh") == 0 && i + 1 < argc) {
+                        config->exportMeshPath = argv[++i];
+                } else if (strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+                        config->shaderDir = argv[++i];
+                } else if (strcmp(argv[i], "--hot-reload") == 0) {
+                        config->hotReload = true;
+                } else if (strcmp(argv[i], "--resize-storm") == 0 && i + 1 < argc) {
+                        config->resizeStormFrames = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+                        if (!pacingParseProfile(argv[++i], &config->pacing)) {
+                                fprintf(stderr, "Unknown pacing profile: %s\n", argv[i]);
+                                return -1;
+                        }
+                } else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc) {
+                        config->targetFps = strtod(argv[++i], NULL);
+                } else if (strcmp(argv[i], "--animate") == 0) {
+                        config->animate = true;
+                } else if (strcmp(argv[i], "--bench-transforms") == 0 && i + 1 < argc) {
+                        config->transformBenchObjects = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--bench-quads") == 0 && i + 1 < argc) {
+                        config->quadBenchCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--quads") == 0 && i + 1 < argc) {
+                        config->quadCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+                        config->particleCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+                        if (config->textureFileCount == MAX_TEXTURE_FILES) {
+                                fprintf(stderr, "At most %d textures\n", MAX_TEXTURE_FILES);
+                                return -1;
+                        }
+
+                        config->texturePaths[config->textureFileCount++] = argv[++i];
+                } else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+                        config->textureBudgetMiB = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "--pipeline-variants") == 0 && i + 1 < argc) {
+                        config->pipelineVariants = (uint32_t) strtoul(argv[++i], NULL, 10);
+                        if (config->pipelineVariants > MAX_PIPELINE_VARIANTS) {
+                                fprintf(stderr, "At most %d pipeline variants\n", MAX_PIPELINE_VARIANTS);
+                                return -1;
+                        }
+                } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+                        config->deviceOverride = argv[++i];
+                } else if (strcmp(argv[i], "--no-async-compute") == 0) {
+                        config->noAsyncCompute = true;
+                } else if (strcmp(argv[i], "--render-pass") == 0) {
+                        config->renderPass = true;
+                } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+                        config->gpuCull = true;
+                } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+                        config->drawCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+                } else {
+                        fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+                        return -1;
+                }
+        }
+
+        if (config->readbackPath && !config->headless) {
+                fprintf(stderr, "--readback requires --headless\n");
+                return -1;
+        }
+
+        if (config->resizeStormFrames && config->headless) {
+                fprintf(stderr, "--resize-storm needs a window\n");
+                return -1;
+        }
+
+        return 0;
+}
+
+int main(int argc, char **argv)
+{
+        App app = {0};
+        if (parseArgs(&app.config, argc, argv) != 0)
+                return EXIT_FAILURE;
+
+        Result result;
+        if (app.config.transformBenchObjects > 0) {
+                // CPU only, with output laid out like the instance buffer
+                Bench bench = { .enabled = true };
+                result = transformBenchmark(&bench, app.config.transformBenchObjects, sizeof(Instance));
+                if (result.code == 0)
+                        result = benchWriteJson(&bench, app.config.benchOutputPath);
+
+                benchDestroy(&bench);
+        } else if (app.config.quadBenchCount > 0) {
+                // CPU only, batching as many pipelines and textures as the app can
+                Bench bench = { .enabled = true };
+                result = quadBatchBenchmark(
+                        &bench,
+                        app.config.quadBenchCount,
+                        QUAD_PIPELINE_COUNT,
+                        MAX_TEXTURE_FILES
+                );
+                if (result.code == 0)
+                        result = benchWriteJson(&bench, app.config.benchOutputPath);
+
+                benchDestroy(&bench);
+        } else {
+                result = appRun(&app);
+        }
+
         if (result.code != 0)
                 fprintf(stderr, "Error: %s\n", (const char *) result.data);
 
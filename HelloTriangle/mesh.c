@@ -0,0 +1,202 @@
+#include "mesh.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+        return (value + alignment - 1) & ~(alignment - 1);
+}
+
+VkDeviceSize meshVertexBytes(const Mesh *mesh)
+{
+        return (VkDeviceSize) mesh->header.vertexStride * mesh->header.vertexCount;
+}
+
+VkDeviceSize meshIndexBytes(const Mesh *mesh)
+{
+        return (VkDeviceSize) mesh->header.indexSize * mesh->header.indexCount;
+}
+
+VkIndexType meshIndexType(const Mesh *mesh)
+{
+        return mesh->header.indexSize == 4
+                ? VK_INDEX_TYPE_UINT32
+                : VK_INDEX_TYPE_UINT16;
+}
+
+const MeshAttribute *meshFindAttribute(const Mesh *mesh, uint32_t location)
+{
+        for (uint32_t i = 0; i < mesh->header.attributeCount; i++) {
+                if (mesh->header.attributes[i].location == location)
+                        return &mesh->header.attributes[i];
+        }
+
+        return NULL;
+}
+
+// Bytes per vertex attribute, 0 for formats the loader does not accept
+static uint32_t attributeFormatSize(uint32_t format)
+{
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+                return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+                return 8;
+        case VK_FORMAT_R32G32B32_SFLOAT:
+                return 12;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return 16;
+        default:
+                return 0;
+        }
+}
+
+static bool sectionFits(uint64_t offset, uint64_t size, size_t fileSize)
+{
+        return offset % MESH_SECTION_ALIGNMENT == 0
+                && offset <= fileSize
+                && size <= fileSize - offset;
+}
+
+static bool headerValid(const MeshHeader *header, size_t fileSize)
+{
+        if (header->magic != MESH_MAGIC || header->version != MESH_VERSION)
+                return false;
+
+        // Empty sections would mean zero-sized buffers, which Vulkan forbids
+        if (header->attributeCount == 0
+                || header->attributeCount > MESH_MAX_ATTRIBUTES
+                || header->vertexStride == 0
+                || header->vertexCount == 0
+                || header->indexCount == 0
+                || (header->indexSize != 2 && header->indexSize != 4)
+        ) {
+                return false;
+        }
+
+        for (uint32_t i = 0; i < header->attributeCount; i++) {
+                const MeshAttribute *attribute = &header->attributes[i];
+                const uint32_t size = attributeFormatSize(attribute->format);
+                if (size == 0 || (uint64_t) attribute->offset + size > header->vertexStride)
+                        return false;
+        }
+
+        const uint64_t vertexBytes = (uint64_t) header->vertexStride * header->vertexCount;
+        const uint64_t indexBytes = (uint64_t) header->indexSize * header->indexCount;
+        return sectionFits(header->vertexOffset, vertexBytes, fileSize)
+                && sectionFits(header->indexOffset, indexBytes, fileSize);
+}
+
+// An index past the last vertex would read outside the vertex buffer
+static bool indicesValid(const MeshHeader *header, const void *indices)
+{
+        for (uint32_t i = 0; i < header->indexCount; i++) {
+                const uint32_t index = header->indexSize == 4
+                        ? ((const uint32_t *) indices)[i]
+                        : ((const uint16_t *) indices)[i];
+
+                if (index >= header->vertexCount)
+                        return false;
+        }
+
+        return true;
+}
+
+const Result meshLoad(Mesh *mesh, const char *path)
+{
+        memset(mesh, 0, sizeof(Mesh));
+
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return RESULT_ERROR(-1, "failed to open mesh file!");
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(MeshHeader)) {
+                close(fd);
+                return RESULT_ERROR(-1, "mesh file is truncated!");
+        }
+
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+                return RESULT_ERROR(-1, "failed to map mesh file!");
+
+        // Read front to back exactly once, on its way into staging memory
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+        madvise(mapping, st.st_size, MADV_WILLNEED);
+
+        memcpy(&mesh->header, mapping, sizeof(MeshHeader));
+        if (!headerValid(&mesh->header, st.st_size)) {
+                munmap(mapping, st.st_size);
+                return RESULT_ERROR(-1, "invalid mesh file!");
+        }
+
+        const void *indices = (const char *) mapping + mesh->header.indexOffset;
+        if (!indicesValid(&mesh->header, indices)) {
+                munmap(mapping, st.st_size);
+                return RESULT_ERROR(-1, "mesh indices out of range!");
+        }
+
+        mesh->mapping = mapping;
+        mesh->mappingSize = st.st_size;
+        mesh->vertices = (const char *) mapping + mesh->header.vertexOffset;
+        mesh->indices = indices;
+        return RESULT_SUCCESS;
+}
+
+void meshUnmap(Mesh *mesh)
+{
+        if (mesh->mapping)
+                munmap(mesh->mapping, mesh->mappingSize);
+
+        mesh->mapping = NULL;
+        mesh->mappingSize = 0;
+        mesh->vertices = NULL;
+        mesh->indices = NULL;
+}
+
+static bool writePadded(FILE *fp, const void *data, size_t size, uint64_t paddedSize)
+{
+        static const char zeros[MESH_SECTION_ALIGNMENT] = {0};
+        if (fwrite(data, 1, size, fp) != size)
+                return false;
+
+        const size_t padding = paddedSize - size;
+        return fwrite(zeros, 1, padding, fp) == padding;
+}
+
+const Result meshSave(const Mesh *mesh, const char *path)
+{
+        MeshHeader header = mesh->header;
+        header.magic = MESH_MAGIC;
+        header.version = MESH_VERSION;
+        header.reserved = 0;
+
+        const uint64_t headerBytes = alignUp(sizeof(MeshHeader), MESH_SECTION_ALIGNMENT);
+        const uint64_t vertexBytes = meshVertexBytes(mesh);
+        const uint64_t indexBytes = meshIndexBytes(mesh);
+        header.vertexOffset = headerBytes;
+        header.indexOffset = headerBytes + alignUp(vertexBytes, MESH_SECTION_ALIGNMENT);
+
+        FILE *fp = fopen(path, "wb");
+        if (!fp)
+                return RESULT_ERROR(-1, "failed to open mesh file for writing!");
+
+        const bool written = writePadded(fp, &header, sizeof(header), headerBytes)
+                && writePadded(fp, mesh->vertices, vertexBytes, header.indexOffset - headerBytes)
+                && writePadded(fp, mesh->indices, indexBytes, indexBytes);
+
+        if (fclose(fp) != 0 || !written)
+                return RESULT_ERROR(-1, "failed to write mesh file!");
+
+        return RESULT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "result.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define MESH_MAGIC 0x4853454d // "MESH" little-endian
+#define MESH_VERSION 1
+#define MESH_SECTION_ALIGNMENT 16
+#define MESH_MAX_ATTRIBUTES 8
+
+typedef struct meshAttribute {
+        uint32_t location;
+        uint32_t format; // VkFormat
+        uint32_t offset;
+} MeshAttribute;
+
+// On-disk header, little-endian. The vertex and index sections follow at
+// MESH_SECTION_ALIGNMENT aligned offsets and hold exactly what the GPU
+// buffers will, so loading is a straight copy.
+typedef struct meshHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexStride;
+        uint32_t attributeCount;
+        MeshAttribute attributes[MESH_MAX_ATTRIBUTES];
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexSize; // 2 or 4 bytes
+        uint32_t reserved;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+} MeshHeader;
+
+typedef struct mesh {
+        MeshHeader header;
+        const void *vertices;
+        const void *indices;
+        void *mapping; // NULL when the data is not from a file
+        size_t mappingSize;
+} Mesh;
+
+// Maps the file and points the mesh at its sections; nothing is copied
+const Result meshLoad(Mesh *mesh, const char *path);
+// Drops the vertex and index data once uploaded, the header stays valid
+void meshUnmap(Mesh *mesh);
+const Result meshSave(const Mesh *mesh, const char *path);
+
+VkDeviceSize meshVertexBytes(const Mesh *mesh);
+VkDeviceSize meshIndexBytes(const Mesh *mesh);
+VkIndexType meshIndexType(const Mesh *mesh);
+const MeshAttribute *meshFindAttribute(const Mesh *mesh, uint32_t location);
+
+#endif
@@ -0,0 +1,212 @@
+#include "pacing.h"
+
+#include "bench.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+static const double DEFAULT_TARGET_FPS = 60.0;
+
+// Just-in-time starts aim this far ahead of the estimated work
+static const double JIT_MARGIN_MS = 1.0;
+static const double JIT_WORK_HEADROOM = 1.25;
+
+static const double ESTIMATE_SMOOTHING = 0.1;
+
+static const char *const PROFILE_NAMES[] = {
+        [PACING_BALANCED] = "balanced",
+        [PACING_LOW_LATENCY] = "low-latency",
+        [PACING_THROUGHPUT] = "throughput",
+        [PACING_FIXED_RATE] = "fixed-rate",
+};
+
+static const uint32_t PROFILE_COUNT = sizeof(PROFILE_NAMES) / sizeof(PROFILE_NAMES[0]);
+
+bool pacingParseProfile(const char *name, PacingProfile *profile)
+{
+        for (uint32_t i = 0; i < PROFILE_COUNT; i++) {
+                if (strcmp(name, PROFILE_NAMES[i]) == 0) {
+                        *profile = (PacingProfile) i;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+const char *pacingProfileName(PacingProfile profile)
+{
+        return PROFILE_NAMES[profile];
+}
+
+void pacerInit(Pacer *pacer, PacingProfile profile, double targetFps, bool presentTiming)
+{
+        memset(pacer, 0, sizeof(Pacer));
+        pacer->profile = profile;
+        pacer->presentTiming = presentTiming;
+
+        switch (profile) {
+        case PACING_LOW_LATENCY:
+                pacer->framesInFlight = 1;
+                break;
+        case PACING_THROUGHPUT:
+                pacer->framesInFlight = PACING_MAX_FRAMES_IN_FLIGHT;
+                break;
+        default:
+                pacer->framesInFlight = 2;
+                break;
+        }
+
+        if (profile == PACING_FIXED_RATE)
+                pacer->targetFrameMs = 1000.0 / (targetFps > 0.0 ? targetFps : DEFAULT_TARGET_FPS);
+}
+
+static bool hasPresentMode(
+        const VkPresentModeKHR *availableModes,
+        uint32_t availableCount,
+        VkPresentModeKHR mode
+) {
+        for (uint32_t i = 0; i < availableCount; i++) {
+                if (availableModes[i] == mode)
+                        return true;
+        }
+
+        return false;
+}
+
+VkPresentModeKHR pacerChoosePresentMode(
+        const Pacer *pacer,
+        const VkPresentModeKHR *availableModes,
+        uint32_t availableCount
+) {
+        // Just-in-time starts line up with vblank, which only FIFO guarantees
+        if (pacer->profile == PACING_LOW_LATENCY && pacer->presentTiming)
+                return VK_PRESENT_MODE_FIFO_KHR;
+
+        if (hasPresentMode(availableModes, availableCount, VK_PRESENT_MODE_MAILBOX_KHR))
+                return VK_PRESENT_MODE_MAILBOX_KHR;
+
+        if (pacer->profile == PACING_THROUGHPUT
+                && hasPresentMode(availableModes, availableCount, VK_PRESENT_MODE_IMMEDIATE_KHR)
+        ) {
+                return VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+
+        return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t pacerChooseImageCount(const Pacer *pacer, const VkSurfaceCapabilitiesKHR *capabilities)
+{
+        uint32_t imageCount = capabilities->minImageCount;
+        if (pacer->profile == PACING_THROUGHPUT)
+                imageCount += 2;
+        else if (pacer->profile != PACING_LOW_LATENCY)
+                imageCount += 1;
+
+        if (capabilities->maxImageCount > 0 && imageCount > capabilities->maxImageCount)
+                imageCount = capabilities->maxImageCount;
+
+        return imageCount;
+}
+
+static void sleepUntilMs(double targetMs)
+{
+        if (targetMs <= benchNowMs())
+                return;
+
+        struct timespec deadline = { .tv_sec = (time_t) (targetMs / 1000.0) };
+        deadline.tv_nsec = (long) ((targetMs - deadline.tv_sec * 1000.0) * 1000000.0);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+                ;
+}
+
+void pacerWait(Pacer *pacer)
+{
+        if (pacer->profile == PACING_FIXED_RATE) {
+                // A frame that overran resets the schedule rather than
+                // bursting to catch up
+                const double nowMs = benchNowMs();
+                if (pacer->nextStartMs == 0.0 || nowMs - pacer->nextStartMs > pacer->targetFrameMs)
+                        pacer->nextStartMs = nowMs;
+
+                sleepUntilMs(pacer->nextStartMs);
+                pacer->nextStartMs += pacer->targetFrameMs;
+                return;
+        }
+
+        if (pacer->profile != PACING_LOW_LATENCY
+                || !pacer->presentTiming
+                || pacer->refreshMs == 0.0
+        ) {
+                return;
+        }
+
+        // Start as late as possible while still making the next vblank
+        const double startMs = pacer->lastPresentMs
+                + pacer->refreshMs
+                - pacer->workMs * JIT_WORK_HEADROOM
+                - JIT_MARGIN_MS;
+
+        sleepUntilMs(startMs);
+}
+
+void pacerFrameWork(Pacer *pacer, double workMs)
+{
+        // Jumps up at once so a slow frame is not followed by a missed vblank,
+        // settles back down slowly
+        if (workMs > pacer->workMs)
+                pacer->workMs = workMs;
+        else
+                pacer->workMs += (workMs - pacer->workMs) * ESTIMATE_SMOOTHING;
+}
+
+void pacerQueued(Pacer *pacer, uint64_t presentId, double inputMs)
+{
+        if (pacer->queuedCount == PACING_MAX_QUEUED_PRESENTS) {
+                pacer->queuedFirst = (pacer->queuedFirst + 1) % PACING_MAX_QUEUED_PRESENTS;
+                pacer->queuedCount--;
+        }
+
+        const uint32_t index = (pacer->queuedFirst + pacer->queuedCount) % PACING_MAX_QUEUED_PRESENTS;
+        pacer->queued[index] = (QueuedPresent) {
+                .presentId = presentId,
+                .inputMs = inputMs,
+        };
+
+        pacer->queuedCount++;
+}
+
+bool pacerOldestQueued(const Pacer *pacer, uint64_t *presentId)
+{
+        if (pacer->queuedCount == 0)
+                return false;
+
+        *presentId = pacer->queued[pacer->queuedFirst].presentId;
+        return true;
+}
+
+double pacerPresented(Pacer *pacer, double presentMs)
+{
+        const QueuedPresent present = pacer->queued[pacer->queuedFirst];
+        pacer->queuedFirst = (pacer->queuedFirst + 1) % PACING_MAX_QUEUED_PRESENTS;
+        pacer->queuedCount--;
+
+        // Intervals that skipped a vblank or more would inflate the estimate
+        const double intervalMs = presentMs - pacer->lastPresentMs;
+        if (pacer->presentTiming && pacer->lastPresentMs > 0.0 && intervalMs > 0.0) {
+                if (pacer->refreshMs == 0.0 || intervalMs < pacer->refreshMs * 0.75)
+                        pacer->refreshMs = intervalMs;
+                else if (intervalMs < pacer->refreshMs * 1.5)
+                        pacer->refreshMs += (intervalMs - pacer->refreshMs) * ESTIMATE_SMOOTHING;
+        }
+
+        pacer->lastPresentMs = presentMs;
+        return presentMs - present.inputMs;
+}
+
+void pacerDropQueued(Pacer *pacer)
+{
+        pacer->queuedFirst = 0;
+        pacer->queuedCount = 0;
+        pacer->lastPresentMs = 0.0;
+}
@@ -0,0 +1,71 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define PACING_MAX_FRAMES_IN_FLIGHT 3
+#define PACING_MAX_QUEUED_PRESENTS 16
+
+typedef enum pacingProfile {
+        PACING_BALANCED, // two frames queued, mailbox when available
+        PACING_LOW_LATENCY, // one frame, started just in time for the next vblank
+        PACING_THROUGHPUT, // deepest queue, never waits on the display
+        PACING_FIXED_RATE, // capped to a target frame rate
+} PacingProfile;
+
+typedef struct queuedPresent {
+        uint64_t presentId;
+        double inputMs; // when the frame's input was sampled
+} QueuedPresent;
+
+// Decides how deep the frame queue is, which present mode and how many
+// swapchain images to ask for, and how long to hold the CPU back before
+// each frame. Knows nothing about Vulkan objects; the caller reports when
+// presents were queued and when they reached the screen.
+typedef struct pacer {
+        PacingProfile profile;
+        uint32_t framesInFlight;
+        bool presentTiming; // every present is reported the moment it completes
+        double targetFrameMs; // fixed rate only
+        double nextStartMs; // fixed rate deadline
+        double lastPresentMs;
+        double refreshMs; // estimated interval between presents, 0 until known
+        double workMs; // estimated input-to-GPU-done time
+        QueuedPresent queued[PACING_MAX_QUEUED_PRESENTS];
+        uint32_t queuedFirst;
+        uint32_t queuedCount;
+} Pacer;
+
+// Returns false for an unknown name
+bool pacingParseProfile(const char *name, PacingProfile *profile);
+const char *pacingProfileName(PacingProfile profile);
+
+// presentTiming tells the pacer it will see every present complete, which
+// the low latency profile needs to start frames just in time
+void pacerInit(Pacer *pacer, PacingProfile profile, double targetFps, bool presentTiming);
+
+VkPresentModeKHR pacerChoosePresentMode(
+        const Pacer *pacer,
+        const VkPresentModeKHR *availableModes,
+        uint32_t availableCount
+);
+uint32_t pacerChooseImageCount(const Pacer *pacer, const VkSurfaceCapabilitiesKHR *capabilities);
+
+// Sleeps until the next frame should sample input and start recording
+void pacerWait(Pacer *pacer);
+
+// Time from input sampling to the GPU finishing that frame
+void pacerFrameWork(Pacer *pacer, double workMs);
+
+// Oldest queue entry is dropped when full
+void pacerQueued(Pacer *pacer, uint64_t presentId, double inputMs);
+// False when nothing is waiting to be presented
+bool pacerOldestQueued(const Pacer *pacer, uint64_t *presentId);
+// The oldest queued present reached the screen; returns its input latency
+double pacerPresented(Pacer *pacer, double presentMs);
+// Presents of a replaced swapchain will never be reported
+void pacerDropQueued(Pacer *pacer);
+
+#endif
@@ -0,0 +1,155 @@
+#include "pipeline_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Layout of VkPipelineCacheHeaderVersionOne, read field by field so the
+// file's byte order is interpreted as the driver wrote it
+#define HEADER_SIZE (16 + VK_UUID_SIZE)
+
+static uint32_t readU32(const unsigned char *bytes)
+{
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+}
+
+static bool headerMatches(
+        const VkPhysicalDeviceProperties *properties,
+        const unsigned char *data,
+        size_t size
+) {
+        if (size < HEADER_SIZE)
+                return false;
+
+        const uint32_t headerSize = readU32(data);
+        const uint32_t headerVersion = readU32(data + 4);
+        const uint32_t vendorID = readU32(data + 8);
+        const uint32_t deviceID = readU32(data + 12);
+
+        return headerSize >= HEADER_SIZE
+                && headerSize <= size
+                && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                && vendorID == properties->vendorID
+                && deviceID == properties->deviceID
+                && memcmp(data + 16, properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static void *readCacheFile(const char *path, size_t *pSize)
+{
+        FILE *fp = fopen(path, "rb");
+        if (!fp)
+                return NULL;
+
+        fseek(fp, 0l, SEEK_END);
+        const long size = ftell(fp);
+        rewind(fp);
+
+        void *data = size > 0 ? malloc(size) : NULL;
+        if (data && fread(data, 1, size, fp) != (size_t) size) {
+                free(data);
+                data = NULL;
+        }
+
+        fclose(fp);
+        *pSize = data ? (size_t) size : 0;
+        return data;
+}
+
+const Result pipelineCacheLoad(
+        VkPhysicalDevice physicalDevice,
+        VkDevice device,
+        const char *path,
+        VkPipelineCache *pCache,
+        bool *pWarm
+) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        size_t size = 0;
+        void *data = path ? readCacheFile(path, &size) : NULL;
+
+        if (data && !headerMatches(&properties, data, size)) {
+                fprintf(stderr, "WARN: ignoring pipeline cache %s built for another device or driver.\n", path);
+                free(data);
+                data = NULL;
+                size = 0;
+        }
+
+        const VkPipelineCacheCreateInfo createInfo = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                .initialDataSize = size,
+                .pInitialData = data,
+        };
+
+        VkResult result = vkCreatePipelineCache(device, &createInfo, NULL, pCache);
+
+        // A driver may still reject data that passed the header check
+        if (result != VK_SUCCESS && data) {
+                const VkPipelineCacheCreateInfo emptyInfo = {
+                        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                };
+
+                result = vkCreatePipelineCache(device, &emptyInfo, NULL, pCache);
+                free(data);
+                data = NULL;
+        }
+
+        *pWarm = data != NULL;
+        free(data);
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create pipeline cache!");
+
+        return RESULT_SUCCESS;
+}
+
+const Result pipelineCacheSave(
+        VkDevice device,
+        VkPipelineCache cache,
+        const char *path
+) {
+        size_t size = 0;
+        VkResult result = vkGetPipelineCacheData(device, cache, &size, NULL);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to query pipeline cache size!");
+
+        // Nothing compiled into it, so the file on disk is as good as it gets
+        if (size == 0)
+                return RESULT_SUCCESS;
+
+        void *data = malloc(size);
+        if (!data)
+                return RESULT_ERROR(-1, "failed to allocate pipeline cache data!");
+
+        result = vkGetPipelineCacheData(device, cache, &size, data);
+        if (result != VK_SUCCESS) {
+                free(data);
+                return RESULT_ERROR(result, "failed to read pipeline cache data!");
+        }
+
+        char tmpPath[4096];
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+        FILE *fp = fopen(tmpPath, "wb");
+        if (!fp) {
+                free(data);
+                return RESULT_ERROR(-1, "failed to open pipeline cache file for writing!");
+        }
+
+        const bool written = fwrite(data, 1, size, fp) == size
+                && fflush(fp) == 0
+                && fsync(fileno(fp)) == 0;
+
+        fclose(fp);
+        free(data);
+
+        if (!written || rename(tmpPath, path) != 0) {
+                remove(tmpPath);
+                return RESULT_ERROR(-1, "failed to write pipeline cache file!");
+        }
+
+        return RESULT_SUCCESS;
+}
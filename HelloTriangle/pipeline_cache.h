@@ -0,0 +1,27 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include "result.h"
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+// Creates a pipeline cache seeded from path when the file exists and its
+// header matches this device (vendor, device and cache UUID). A missing or
+// stale file silently yields an empty cache; pWarm reports which happened.
+const Result pipelineCacheLoad(
+        VkPhysicalDevice physicalDevice,
+        VkDevice device,
+        const char *path,
+        VkPipelineCache *pCache,
+        bool *pWarm
+);
+
+// Writes the cache to a temporary file and renames it over path, so a
+// crash mid-write never leaves a truncated cache behind.
+const Result pipelineCacheSave(
+        VkDevice device,
+        VkPipelineCache cache,
+        const char *path
+);
+
+#endif
@@ -0,0 +1,211 @@
+#include "pipeline_state.h"
+
+#include "bench.h"
+#include "hash.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t findSlot(
+        const PipelineStateCache *cache,
+        uint64_t hash,
+        const PipelineState *state
+) {
+        return hashFindSlot(
+                cache->entries,
+                sizeof(PipelineEntry),
+                cache->capacity,
+                hash,
+                state,
+                offsetof(PipelineEntry, state),
+                sizeof(PipelineState)
+        );
+}
+
+static void *compileMain(void *arg)
+{
+        PipelineStateCache *cache = arg;
+
+        pthread_mutex_lock(&cache->mutex);
+        while (true) {
+                while (!cache->stopping && cache->queueCount == 0)
+                        pthread_cond_wait(&cache->queueCond, &cache->mutex);
+
+                if (cache->stopping)
+                        break;
+
+                const uint32_t index = cache->queue[cache->queueHead];
+                cache->queueHead = (cache->queueHead + 1) & (cache->capacity - 1);
+                cache->queueCount--;
+
+                // A flush may clear the entry while it compiles, so build
+                // from a copy
+                PipelineEntry *entry = &cache->entries[index];
+                const PipelineState state = entry->state;
+                const uint32_t generation = cache->generation;
+                pthread_mutex_unlock(&cache->mutex);
+
+                const double start = benchNowMs();
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                const Result res = cache->build(cache->userData, &state, &pipeline);
+                const double compileMs = benchNowMs() - start;
+
+                pthread_mutex_lock(&cache->mutex);
+                if (generation != cache->generation) {
+                        // Never handed out, so it can go right away
+                        if (res.code == 0)
+                                vkDestroyPipeline(cache->device, pipeline, NULL);
+                } else if (res.code == 0) {
+                        entry->pipeline = pipeline;
+                        entry->status = PIPELINE_ENTRY_READY;
+                        cache->stats.compiled++;
+                } else {
+                        entry->status = PIPELINE_ENTRY_FAILED;
+                        cache->stats.failed++;
+                }
+
+                cache->stats.compileMs += compileMs;
+                if (compileMs > cache->stats.maxCompileMs)
+                        cache->stats.maxCompileMs = compileMs;
+        }
+
+        pthread_mutex_unlock(&cache->mutex);
+        return NULL;
+}
+
+const Result pipelineStateCacheCreate(
+        PipelineStateCache *cache,
+        VkDevice device,
+        uint32_t maxStates,
+        uint32_t threadCount,
+        PipelineBuildFn build,
+        void *userData
+) {
+        memset(cache, 0, sizeof(PipelineStateCache));
+        cache->device = device;
+        cache->build = build;
+        cache->userData = userData;
+
+        // Before anything can fail, so destroy always finds them set up
+        pthread_mutex_init(&cache->mutex, NULL);
+        pthread_cond_init(&cache->queueCond, NULL);
+
+        // Kept under half full so probes stay short
+        cache->capacity = 16;
+        while (cache->capacity < maxStates * 2)
+                cache->capacity *= 2;
+
+        cache->entries = calloc(cache->capacity, sizeof(PipelineEntry));
+        cache->queue = calloc(cache->capacity, sizeof(uint32_t));
+        cache->threads = calloc(threadCount, sizeof(pthread_t));
+        if (!cache->entries || !cache->queue || !cache->threads) {
+                pipelineStateCacheDestroy(cache);
+                return RESULT_ERROR(-1, "failed to allocate pipeline state cache!");
+        }
+
+        for (uint32_t i = 0; i < threadCount; i++) {
+                if (pthread_create(&cache->threads[i], NULL, compileMain, cache) != 0) {
+                        pipelineStateCacheDestroy(cache);
+                        return RESULT_ERROR(-1, "failed to start pipeline compile thread!");
+                }
+
+                cache->threadCount++;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Stops the threads already started and frees everything, whatever
+// create got as far as
+void pipelineStateCacheDestroy(PipelineStateCache *cache)
+{
+        if (!cache->capacity)
+                return;
+
+        pthread_mutex_lock(&cache->mutex);
+        cache->stopping = true;
+        pthread_cond_broadcast(&cache->queueCond);
+        pthread_mutex_unlock(&cache->mutex);
+
+        for (uint32_t i = 0; i < cache->threadCount; i++)
+                pthread_join(cache->threads[i], NULL);
+
+        for (uint32_t i = 0; cache->entries && i < cache->capacity; i++) {
+                if (cache->entries[i].hash != 0 && cache->entries[i].status == PIPELINE_ENTRY_READY)
+                        vkDestroyPipeline(cache->device, cache->entries[i].pipeline, NULL);
+        }
+
+        pthread_cond_destroy(&cache->queueCond);
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache->entries);
+        free(cache->queue);
+        free(cache->threads);
+        cache->entries = NULL;
+        cache->queue = NULL;
+        cache->threads = NULL;
+        cache->threadCount = 0;
+        cache->capacity = 0;
+}
+
+VkPipeline pipelineStateCacheGet(
+        PipelineStateCache *cache,
+        const PipelineState *state,
+        VkPipeline fallback
+) {
+        const uint64_t hash = hashBytes(state, sizeof(PipelineState));
+        VkPipeline pipeline = fallback;
+
+        pthread_mutex_lock(&cache->mutex);
+        PipelineEntry *entry = &cache->entries[findSlot(cache, hash, state)];
+        if (entry->hash == 0) {
+                cache->stats.misses++;
+                cache->stats.fallbacks++;
+
+                // Past half full new states only ever get the fallback
+                if (cache->count * 2 < cache->capacity) {
+                        const uint32_t index = (uint32_t) (entry - cache->entries);
+                        *entry = (PipelineEntry) {
+                                .hash = hash,
+                                .state = *state,
+                                .status = PIPELINE_ENTRY_QUEUED,
+                        };
+
+                        cache->count++;
+                        cache->queue[(cache->queueHead + cache->queueCount) & (cache->capacity - 1)] = index;
+                        cache->queueCount++;
+                        pthread_cond_signal(&cache->queueCond);
+                }
+        } else if (entry->status == PIPELINE_ENTRY_READY) {
+                cache->stats.hits++;
+                pipeline = entry->pipeline;
+        } else {
+                cache->stats.fallbacks++;
+        }
+
+        pthread_mutex_unlock(&cache->mutex);
+        return pipeline;
+}
+
+void pipelineStateCacheFlush(PipelineStateCache *cache, PipelineRetireFn retire)
+{
+        pthread_mutex_lock(&cache->mutex);
+        for (uint32_t i = 0; i < cache->capacity; i++) {
+                if (cache->entries[i].hash != 0 && cache->entries[i].status == PIPELINE_ENTRY_READY)
+                        retire(cache->userData, cache->entries[i].pipeline);
+        }
+
+        memset(cache->entries, 0, sizeof(PipelineEntry) * cache->capacity);
+        cache->count = 0;
+        cache->queueHead = 0;
+        cache->queueCount = 0;
+        cache->generation++;
+        pthread_mutex_unlock(&cache->mutex);
+}
+
+PipelineStateStats pipelineStateCacheStats(PipelineStateCache *cache)
+{
+        pthread_mutex_lock(&cache->mutex);
+        const PipelineStateStats stats = cache->stats;
+        pthread_mutex_unlock(&cache->mutex);
+        return stats;
+}
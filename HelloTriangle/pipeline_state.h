@@ -0,0 +1,131 @@
+#ifndef PIPELINE_STATE_H
+#define PIPELINE_STATE_H
+
+#include "result.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define PIPELINE_STATE_MAX_BINDINGS 2
+#define PIPELINE_STATE_MAX_ATTRIBUTES 16
+#define PIPELINE_STATE_SHADER_NAME_SIZE 16
+
+typedef enum pipelineBlend {
+        PIPELINE_BLEND_OPAQUE,
+        PIPELINE_BLEND_ALPHA,
+        PIPELINE_BLEND_ADDITIVE,
+        PIPELINE_BLEND_COUNT,
+} PipelineBlend;
+
+// Everything that varies between graphics pipelines sharing a layout and
+// render target. Hashed and compared bytewise, so zero it before filling
+// it in; every field is 4 bytes wide or a char array, leaving no padding.
+typedef struct pipelineState {
+        char vertexShader[PIPELINE_STATE_SHADER_NAME_SIZE]; // as passed to shaderLoad
+        char fragmentShader[PIPELINE_STATE_SHADER_NAME_SIZE];
+        uint32_t topology; // VkPrimitiveTopology
+        uint32_t polygonMode; // VkPolygonMode
+        uint32_t cullMode; // VkCullModeFlags
+        uint32_t frontFace; // VkFrontFace
+        uint32_t blend; // PipelineBlend
+        uint32_t colorFormat; // VkFormat rendered to, VK_FORMAT_UNDEFINED with a render pass
+        uint32_t bindingCount;
+        VkVertexInputBindingDescription bindings[PIPELINE_STATE_MAX_BINDINGS];
+        uint32_t attributeCount;
+        VkVertexInputAttributeDescription attributes[PIPELINE_STATE_MAX_ATTRIBUTES];
+} PipelineState;
+
+// Builds the pipeline for a state. Called on the compile threads, so it
+// may only read state the render thread does not modify.
+typedef const Result (*PipelineBuildFn)(
+        void *userData,
+        const PipelineState *state,
+        VkPipeline *pPipeline
+);
+
+// Takes a pipeline the cache no longer hands out, which frames in flight
+// may still be using
+typedef void (*PipelineRetireFn)(void *userData, VkPipeline pipeline);
+
+typedef enum pipelineEntryStatus {
+        PIPELINE_ENTRY_QUEUED,
+        PIPELINE_ENTRY_READY,
+        PIPELINE_ENTRY_FAILED,
+} PipelineEntryStatus;
+
+typedef struct pipelineEntry {
+        uint64_t hash; // 0 marks an empty slot
+        PipelineState state;
+        PipelineEntryStatus status;
+        VkPipeline pipeline;
+} PipelineEntry;
+
+typedef struct pipelineStateStats {
+        uint64_t hits; // lookups answered with a compiled pipeline
+        uint64_t misses; // lookups of a state never seen before
+        uint64_t fallbacks; // lookups answered with the fallback instead
+        uint32_t compiled;
+        uint32_t failed;
+        double compileMs; // summed over every compile
+        double maxCompileMs;
+} PipelineStateStats;
+
+// Maps pipeline states to VkPipelines through an open-addressed hash
+// table of fixed capacity, so entries never move. A state missing from
+// the table is queued for the compile threads and the caller gets its
+// fallback until the pipeline is ready, so a new combination never
+// stalls the frame. Lookups take a mutex and may come from any thread.
+typedef struct pipelineStateCache {
+        VkDevice device;
+        PipelineBuildFn build;
+        void *userData;
+
+        PipelineEntry *entries;
+        uint32_t capacity; // power of two
+        uint32_t count;
+
+        uint32_t *queue; // entry indices waiting to compile, a ring
+        uint32_t queueHead;
+        uint32_t queueCount;
+
+        pthread_t *threads;
+        uint32_t threadCount;
+        pthread_mutex_t mutex;
+        pthread_cond_t queueCond;
+        bool stopping;
+        uint32_t generation; // bumped by a flush, discarding compiles in progress
+
+        PipelineStateStats stats;
+} PipelineStateCache;
+
+// Room for maxStates states, compiled by threadCount threads
+const Result pipelineStateCacheCreate(
+        PipelineStateCache *cache,
+        VkDevice device,
+        uint32_t maxStates,
+        uint32_t threadCount,
+        PipelineBuildFn build,
+        void *userData
+);
+
+// Waits for compiles in progress. Call once the device no longer uses
+// any of the pipelines.
+void pipelineStateCacheDestroy(PipelineStateCache *cache);
+
+// The pipeline for state, or fallback (which may be VK_NULL_HANDLE) while
+// it is compiling, failed to compile, or the table is full
+VkPipeline pipelineStateCacheGet(
+        PipelineStateCache *cache,
+        const PipelineState *state,
+        VkPipeline fallback
+);
+
+// Forgets every state, for when the shaders they name have been rebuilt.
+// Compiled pipelines go to retire, called with the cache's userData;
+// compiles still in progress are destroyed when they finish.
+void pipelineStateCacheFlush(PipelineStateCache *cache, PipelineRetireFn retire);
+
+PipelineStateStats pipelineStateCacheStats(PipelineStateCache *cache);
+
+#endif
@@ -0,0 +1,285 @@
+#include "quad_batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define KEY_PIPELINE_SHIFT 24
+#define KEY_TEXTURE_MASK ((1u << KEY_PIPELINE_SHIFT) - 1)
+#define RADIX_BITS 8
+#define RADIX_SIZE (1u << RADIX_BITS)
+#define RADIX_PASSES (32 / RADIX_BITS)
+
+// Each benchmark batch is rebuilt for at least this long
+static const double BENCHMARK_MS = 250.0;
+
+const Result quadBatchCreate(QuadBatch *batch, uint32_t capacity)
+{
+        memset(batch, 0, sizeof(QuadBatch));
+
+        // Draws address vertices through a signed 32-bit offset
+        if (capacity == 0 || capacity > INT32_MAX / 4)
+                return RESULT_ERROR(-1, "quad batch capacity out of range!");
+
+        batch->capacity = capacity;
+        batch->quads = malloc(sizeof(Quad) * capacity);
+        batch->keys = malloc(sizeof(uint32_t) * capacity);
+        batch->order = malloc(sizeof(uint32_t) * capacity);
+        batch->scratchKeys = malloc(sizeof(uint32_t) * capacity);
+        batch->scratchOrder = malloc(sizeof(uint32_t) * capacity);
+
+        // Every draw but the last ends at a pipeline change or a full index
+        // buffer
+        batch->draws = malloc(
+                sizeof(QuadDraw) * (QUAD_BATCH_MAX_PIPELINES + capacity / QUAD_INDEX_QUADS + 1)
+        );
+
+        if (!batch->quads
+                || !batch->keys
+                || !batch->order
+                || !batch->scratchKeys
+                || !batch->scratchOrder
+                || !batch->draws
+        ) {
+                quadBatchDestroy(batch);
+                return RESULT_ERROR(-1, "failed to allocate quad batch!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+void quadBatchDestroy(QuadBatch *batch)
+{
+        free(batch->quads);
+        free(batch->keys);
+        free(batch->order);
+        free(batch->scratchKeys);
+        free(batch->scratchOrder);
+        free(batch->draws);
+        memset(batch, 0, sizeof(QuadBatch));
+}
+
+void quadBatchWriteIndices(uint16_t *indices)
+{
+        for (uint32_t i = 0; i < QUAD_INDEX_QUADS; i++) {
+                const uint16_t base = (uint16_t) (i * 4);
+                indices[i * 6 + 0] = base;
+                indices[i * 6 + 1] = base + 1;
+                indices[i * 6 + 2] = base + 2;
+                indices[i * 6 + 3] = base + 2;
+                indices[i * 6 + 4] = base + 3;
+                indices[i * 6 + 5] = base;
+        }
+}
+
+void quadBatchBegin(QuadBatch *batch)
+{
+        batch->count = 0;
+        batch->drawCount = 0;
+}
+
+bool quadBatchAdd(QuadBatch *batch, const Quad *quad, uint32_t pipeline, uint32_t texture)
+{
+        if (batch->count == batch->capacity)
+                return false;
+
+        // Untextured quads take the all-ones texture and sort last
+        const uint32_t i = batch->count++;
+        batch->quads[i] = *quad;
+        batch->keys[i] = pipeline << KEY_PIPELINE_SHIFT | (texture & KEY_TEXTURE_MASK);
+        return true;
+}
+
+// Stable LSD radix sort of the keys, carrying quad indices along. Passes
+// over a byte every key shares are skipped, which with a few pipelines
+// and textures is most of them.
+static void sortQuads(QuadBatch *batch)
+{
+        const uint32_t count = batch->count;
+        uint32_t histograms[RADIX_PASSES][RADIX_SIZE];
+        memset(histograms, 0, sizeof(histograms));
+
+        for (uint32_t i = 0; i < count; i++) {
+                const uint32_t key = batch->keys[i];
+                for (uint32_t pass = 0; pass < RADIX_PASSES; pass++)
+                        histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+
+                batch->order[i] = i;
+        }
+
+        for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+                const uint32_t shift = pass * RADIX_BITS;
+                uint32_t *histogram = histograms[pass];
+                if (histogram[(batch->keys[0] >> shift) & (RADIX_SIZE - 1)] == count)
+                        continue;
+
+                uint32_t offset = 0;
+                for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+                        const uint32_t digitCount = histogram[digit];
+                        histogram[digit] = offset;
+                        offset += digitCount;
+                }
+
+                for (uint32_t i = 0; i < count; i++) {
+                        const uint32_t key = batch->keys[i];
+                        const uint32_t to = histogram[(key >> shift) & (RADIX_SIZE - 1)]++;
+                        batch->scratchKeys[to] = key;
+                        batch->scratchOrder[to] = batch->order[i];
+                }
+
+                uint32_t *keys = batch->keys;
+                batch->keys = batch->scratchKeys;
+                batch->scratchKeys = keys;
+
+                uint32_t *order = batch->order;
+                batch->order = batch->scratchOrder;
+                batch->scratchOrder = order;
+        }
+}
+
+void quadBatchBuild(
+        QuadBatch *batch,
+        float viewportWidth,
+        float viewportHeight,
+        QuadVertex *vertices
+) {
+        batch->drawCount = 0;
+        if (batch->count == 0)
+                return;
+
+        sortQuads(batch);
+
+        // Whole vertices written front to back, which suits write-combined
+        // mappings
+        const float scaleX = 2.0f / viewportWidth;
+        const float scaleY = 2.0f / viewportHeight;
+        for (uint32_t i = 0; i < batch->count; i++) {
+                const Quad *quad = &batch->quads[batch->order[i]];
+                uint32_t texture = batch->keys[i] & KEY_TEXTURE_MASK;
+                if (texture == KEY_TEXTURE_MASK)
+                        texture = QUAD_TEXTURE_NONE;
+
+                const float left = quad->x * scaleX - 1.0f;
+                const float right = (quad->x + quad->width) * scaleX - 1.0f;
+                const float top = quad->y * scaleY - 1.0f;
+                const float bottom = (quad->y + quad->height) * scaleY - 1.0f;
+
+                QuadVertex *vertex = vertices + (size_t) i * 4;
+                vertex[0] = (QuadVertex) { { left, top }, { quad->u0, quad->v0 }, quad->color, texture };
+                vertex[1] = (QuadVertex) { { right, top }, { quad->u1, quad->v0 }, quad->color, texture };
+                vertex[2] = (QuadVertex) { { right, bottom }, { quad->u1, quad->v1 }, quad->color, texture };
+                vertex[3] = (QuadVertex) { { left, bottom }, { quad->u0, quad->v1 }, quad->color, texture };
+        }
+
+        uint32_t first = 0;
+        while (first < batch->count) {
+                const uint32_t pipeline = batch->keys[first] >> KEY_PIPELINE_SHIFT;
+                uint32_t end = first + 1;
+                while (end < batch->count
+                        && end - first < QUAD_INDEX_QUADS
+                        && batch->keys[end] >> KEY_PIPELINE_SHIFT == pipeline
+                ) {
+                        end++;
+                }
+
+                batch->draws[batch->drawCount++] = (QuadDraw) {
+                        .pipeline = pipeline,
+                        .indexCount = (end - first) * 6,
+                        .vertexOffset = (int32_t) (first * 4),
+                };
+
+                first = end;
+        }
+}
+
+// Keys must not decrease, and equal keys must keep the order their quads
+// were added in
+static uint32_t countOrderErrors(const QuadBatch *batch)
+{
+        uint32_t errors = 0;
+        for (uint32_t i = 1; i < batch->count; i++) {
+                if (batch->keys[i] < batch->keys[i - 1]
+                        || (batch->keys[i] == batch->keys[i - 1] && batch->order[i] < batch->order[i - 1])
+                ) {
+                        errors++;
+                }
+        }
+
+        return errors;
+}
+
+const Result quadBatchBenchmark(
+        Bench *bench,
+        uint32_t quadCount,
+        uint32_t pipelineCount,
+        uint32_t textureCount
+) {
+        if (pipelineCount == 0 || pipelineCount > QUAD_BATCH_MAX_PIPELINES || textureCount == 0)
+                return RESULT_ERROR(-1, "quad benchmark needs pipelines and textures!");
+
+        QuadBatch batch;
+        Result res = quadBatchCreate(&batch, quadCount);
+        if (res.code != 0)
+                return res;
+
+        // Plain memory; a mapped upload heap behaves much the same for
+        // sequential whole-vertex writes
+        QuadVertex *vertices = malloc(sizeof(QuadVertex) * 4 * (size_t) quadCount);
+        if (!vertices) {
+                quadBatchDestroy(&batch);
+                return RESULT_ERROR(-1, "failed to allocate quad benchmark vertices!");
+        }
+
+        // Sprites on a 1080p grid with pipelines and textures shuffled by an
+        // LCG, so the sort has real work to do
+        const float viewportWidth = 1920.0f;
+        const float viewportHeight = 1080.0f;
+        uint64_t quads = 0;
+        uint32_t batches = 0;
+        double addMs = 0.0;
+        double buildMs = 0.0;
+        const double start = benchNowMs();
+        do {
+                const double addStart = benchNowMs();
+                quadBatchBegin(&batch);
+                uint32_t random = 12345;
+                for (uint32_t i = 0; i < quadCount; i++) {
+                        random = random * 1664525u + 1013904223u;
+                        const Quad quad = {
+                                .x = (float) (i % 120) * 16.0f,
+                                .y = (float) (i / 120 % 68) * 16.0f,
+                                .width = 16.0f,
+                                .height = 16.0f,
+                                .u0 = 0.0f,
+                                .v0 = 0.0f,
+                                .u1 = 1.0f,
+                                .v1 = 1.0f,
+                                .color = 0xffffffffu ^ (i & 0xff),
+                        };
+
+                        quadBatchAdd(&batch, &quad, (random >> 8) % pipelineCount, (random >> 16) % textureCount);
+                }
+
+                const double buildStart = benchNowMs();
+                quadBatchBuild(&batch, viewportWidth, viewportHeight, vertices);
+                const double end = benchNowMs();
+
+                addMs += buildStart - addStart;
+                buildMs += end - buildStart;
+                quads += quadCount;
+                batches++;
+        } while (benchNowMs() - start < BENCHMARK_MS);
+
+        const double elapsed = addMs + buildMs;
+        benchSetValue(bench, "quadsPerMs", quads / elapsed);
+        benchSetValue(bench, "quadAddMs", addMs / batches);
+        benchSetValue(bench, "quadBuildMs", buildMs / batches);
+        benchSetValue(bench, "quads", quadCount);
+        benchSetValue(bench, "quadPipelines", pipelineCount);
+        benchSetValue(bench, "quadTextures", textureCount);
+        benchSetValue(bench, "quadDraws", batch.drawCount);
+        benchSetValue(bench, "quadOrderErrors", countOrderErrors(&batch));
+
+        free(vertices);
+        quadBatchDestroy(&batch);
+        return res;
+}
@@ -0,0 +1,93 @@
+#ifndef QUAD_BATCH_H
+#define QUAD_BATCH_H
+
+#include "bench.h"
+#include "result.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Quads one draw reaches through 16-bit indices, 4 vertices each. Longer
+// runs are split into draws that move vertexOffset along.
+#define QUAD_INDEX_QUADS 16384
+#define QUAD_INDEX_COUNT (QUAD_INDEX_QUADS * 6)
+
+// Pipelines live in the top byte of the sort key, textures in the rest
+#define QUAD_BATCH_MAX_PIPELINES 256
+#define QUAD_TEXTURE_NONE UINT32_MAX
+
+// Vertex buffer layout, binding 0
+typedef struct quadVertex {
+        float position[2]; // clip space
+        float uv[2];
+        uint32_t color; // RGBA8 unorm, R in the low byte
+        uint32_t texture; // bindless slot, QUAD_TEXTURE_NONE for untextured
+} QuadVertex;
+
+typedef struct quad {
+        float x; // pixels from the top left of the viewport
+        float y;
+        float width;
+        float height;
+        float u0;
+        float v0;
+        float u1;
+        float v1;
+        uint32_t color;
+} Quad;
+
+// One vkCmdDrawIndexed with firstIndex 0 and a single instance
+typedef struct quadDraw {
+        uint32_t pipeline;
+        uint32_t indexCount;
+        int32_t vertexOffset;
+} QuadDraw;
+
+// Collects a frame's quads, then sorts them by pipeline and texture and
+// writes their vertices out in that order, usually straight into a mapped
+// vertex buffer. The texture goes in each vertex, so only a pipeline
+// change (or the index buffer running out) starts a new draw. Quads with
+// the same pipeline and texture keep the order they were added in.
+typedef struct quadBatch {
+        uint32_t capacity;
+        uint32_t count;
+        Quad *quads;
+        uint32_t *keys; // pipeline << 24 | texture, sorted along with order
+        uint32_t *order; // quad indices, sorted by key after a build
+        uint32_t *scratchKeys;
+        uint32_t *scratchOrder;
+        QuadDraw *draws;
+        uint32_t drawCount;
+} QuadBatch;
+
+const Result quadBatchCreate(QuadBatch *batch, uint32_t capacity);
+void quadBatchDestroy(QuadBatch *batch);
+
+// Fills the shared index buffer, QUAD_INDEX_COUNT indices
+void quadBatchWriteIndices(uint16_t *indices);
+
+// Starts an empty batch
+void quadBatchBegin(QuadBatch *batch);
+
+// Returns false once the batch is full. pipeline is below
+// QUAD_BATCH_MAX_PIPELINES and texture a bindless slot or QUAD_TEXTURE_NONE.
+bool quadBatchAdd(QuadBatch *batch, const Quad *quad, uint32_t pipeline, uint32_t texture);
+
+// Sorts the quads and writes 4 vertices each to vertices, which needs room
+// for count * 4. Fills in draws and drawCount.
+void quadBatchBuild(
+        QuadBatch *batch,
+        float viewportWidth,
+        float viewportHeight,
+        QuadVertex *vertices
+);
+
+// Adds and builds quadCount quads spread over pipelineCount pipelines and
+// textureCount textures, repeatedly, and reports quads per millisecond
+const Result quadBatchBenchmark(
+        Bench *bench,
+        uint32_t quadCount,
+        uint32_t pipelineCount,
+        uint32_t textureCount
+);
+
+#endif
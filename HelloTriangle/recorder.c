@@ -0,0 +1,227 @@
+#include "recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static VkResult recordSlice(RecorderWorker *worker, const RecorderJob *job)
+{
+        const Recorder *recorder = worker->recorder;
+        const uint32_t perThread = (job->drawCount + recorder->threadCount - 1)
+                / recorder->threadCount;
+        const uint32_t first = worker->index * perThread;
+        uint32_t count = 0;
+        if (first < job->drawCount) {
+                count = job->drawCount - first;
+                if (count > perThread)
+                        count = perThread;
+        }
+
+        VkResult result = vkResetCommandPool(
+                recorder->device,
+                worker->commandPools[job->slot],
+                0
+        );
+
+        if (result != VK_SUCCESS)
+                return result;
+
+        const VkCommandBuffer commandBuffer = worker->commandBuffers[job->slot];
+        const VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+                .pInheritanceInfo = &job->inheritance,
+        };
+
+        result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if (result != VK_SUCCESS)
+                return result;
+
+        // Empty slices still produce a (valid, empty) buffer so the caller
+        // always gets threadCount of them
+        if (count > 0)
+                job->recordDraws(commandBuffer, job->slot, first, count, job->userData);
+
+        return vkEndCommandBuffer(commandBuffer);
+}
+
+static void *workerMain(void *arg)
+{
+        RecorderWorker *worker = arg;
+        Recorder *recorder = worker->recorder;
+        uint64_t seenGeneration = 0;
+
+        pthread_mutex_lock(&recorder->mutex);
+        for (;;) {
+                while (!recorder->quit && recorder->generation == seenGeneration)
+                        pthread_cond_wait(&recorder->startCond, &recorder->mutex);
+
+                if (recorder->quit)
+                        break;
+
+                seenGeneration = recorder->generation;
+                const RecorderJob job = recorder->job;
+                pthread_mutex_unlock(&recorder->mutex);
+
+                const VkResult result = recordSlice(worker, &job);
+
+                pthread_mutex_lock(&recorder->mutex);
+                if (result != VK_SUCCESS)
+                        recorder->result = result;
+
+                if (--recorder->pending == 0)
+                        pthread_cond_signal(&recorder->doneCond);
+        }
+
+        pthread_mutex_unlock(&recorder->mutex);
+        return NULL;
+}
+
+static const Result createWorkerPools(
+        Recorder *recorder,
+        RecorderWorker *worker,
+        uint32_t queueFamily
+) {
+        worker->commandPools = calloc(recorder->slotCount, sizeof(VkCommandPool));
+        worker->commandBuffers = calloc(recorder->slotCount, sizeof(VkCommandBuffer));
+
+        const VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .queueFamilyIndex = queueFamily,
+        };
+
+        for (uint32_t slot = 0; slot < recorder->slotCount; slot++) {
+                VkResult result = vkCreateCommandPool(
+                        recorder->device,
+                        &poolInfo,
+                        NULL,
+                        &worker->commandPools[slot]
+                );
+
+                if (result != VK_SUCCESS)
+                        return RESULT_ERROR(result, "failed to create recorder command pool!");
+
+                const VkCommandBufferAllocateInfo allocInfo = {
+                        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                        .commandPool = worker->commandPools[slot],
+                        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                        .commandBufferCount = 1,
+                };
+
+                result = vkAllocateCommandBuffers(
+                        recorder->device,
+                        &allocInfo,
+                        &worker->commandBuffers[slot]
+                );
+
+                if (result != VK_SUCCESS)
+                        return RESULT_ERROR(result, "failed to allocate secondary command buffer!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const Result recorderCreate(
+        Recorder *recorder,
+        VkDevice device,
+        uint32_t queueFamily,
+        uint32_t threadCount,
+        uint32_t slotCount
+) {
+        memset(recorder, 0, sizeof(Recorder));
+        recorder->device = device;
+        recorder->threadCount = threadCount;
+        recorder->slotCount = slotCount;
+        recorder->workers = calloc(threadCount, sizeof(RecorderWorker));
+        pthread_mutex_init(&recorder->mutex, NULL);
+        pthread_cond_init(&recorder->startCond, NULL);
+        pthread_cond_init(&recorder->doneCond, NULL);
+
+        for (uint32_t i = 0; i < threadCount; i++) {
+                RecorderWorker *worker = &recorder->workers[i];
+                worker->recorder = recorder;
+                worker->index = i;
+
+                Result res;
+                handle(createWorkerPools(recorder, worker, queueFamily));
+
+                if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0)
+                        return RESULT_ERROR(-1, "failed to start recorder thread!");
+
+                recorder->startedThreads++;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+void recorderDestroy(Recorder *recorder)
+{
+        if (recorder->workers == NULL)
+                return;
+
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->quit = true;
+        pthread_cond_broadcast(&recorder->startCond);
+        pthread_mutex_unlock(&recorder->mutex);
+
+        for (uint32_t i = 0; i < recorder->startedThreads; i++)
+                pthread_join(recorder->workers[i].thread, NULL);
+
+        // Creation may have failed part way, so skip what was never made
+        for (uint32_t i = 0; i < recorder->threadCount; i++) {
+                RecorderWorker *worker = &recorder->workers[i];
+                if (worker->commandPools == NULL)
+                        continue;
+
+                for (uint32_t slot = 0; slot < recorder->slotCount; slot++) {
+                        if (worker->commandPools[slot] != VK_NULL_HANDLE)
+                                vkDestroyCommandPool(recorder->device, worker->commandPools[slot], NULL);
+                }
+
+                free(worker->commandPools);
+                free(worker->commandBuffers);
+        }
+
+        pthread_cond_destroy(&recorder->doneCond);
+        pthread_cond_destroy(&recorder->startCond);
+        pthread_mutex_destroy(&recorder->mutex);
+        free(recorder->workers);
+        recorder->workers = NULL;
+}
+
+const Result recorderRecord(
+        Recorder *recorder,
+        uint32_t slot,
+        const VkCommandBufferInheritanceInfo *inheritance,
+        uint32_t drawCount,
+        RecordDrawsFn recordDraws,
+        void *userData,
+        VkCommandBuffer *pSecondaries
+) {
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->job = (RecorderJob) {
+                .slot = slot,
+                .inheritance = *inheritance,
+                .drawCount = drawCount,
+                .recordDraws = recordDraws,
+                .userData = userData,
+        };
+
+        recorder->result = VK_SUCCESS;
+        recorder->pending = recorder->threadCount;
+        recorder->generation++;
+        pthread_cond_broadcast(&recorder->startCond);
+
+        while (recorder->pending > 0)
+                pthread_cond_wait(&recorder->doneCond, &recorder->mutex);
+
+        const VkResult result = recorder->result;
+        pthread_mutex_unlock(&recorder->mutex);
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to record secondary command buffers!");
+
+        for (uint32_t i = 0; i < recorder->threadCount; i++)
+                pSecondaries[i] = recorder->workers[i].commandBuffers[slot];
+
+        return RESULT_SUCCESS;
+}
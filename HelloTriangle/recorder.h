@@ -0,0 +1,78 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "result.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+// Records draws [first, first + count) of the caller's draw list for the
+// given slot. Runs on a worker thread, so it may only read shared state.
+typedef void (*RecordDrawsFn)(
+        VkCommandBuffer commandBuffer,
+        uint32_t slot,
+        uint32_t first,
+        uint32_t count,
+        void *userData
+);
+
+typedef struct recorderJob {
+        uint32_t slot;
+        VkCommandBufferInheritanceInfo inheritance;
+        uint32_t drawCount;
+        RecordDrawsFn recordDraws;
+        void *userData;
+} RecorderJob;
+
+typedef struct recorderWorker {
+        struct recorder *recorder;
+        pthread_t thread;
+        uint32_t index;
+        VkCommandPool *commandPools; // one per slot, reset as a whole
+        VkCommandBuffer *commandBuffers; // secondary, one per slot
+} RecorderWorker;
+
+// Pool of threads that each record a slice of a draw list into their own
+// secondary command buffer. Every worker owns one command pool per slot,
+// so a slot may only be re-recorded once its previous submission finished.
+typedef struct recorder {
+        VkDevice device;
+        uint32_t threadCount;
+        uint32_t startedThreads;
+        uint32_t slotCount;
+        RecorderWorker *workers;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t startCond;
+        pthread_cond_t doneCond;
+        uint64_t generation;
+        uint32_t pending;
+        bool quit;
+
+        RecorderJob job;
+        VkResult result;
+} Recorder;
+
+const Result recorderCreate(
+        Recorder *recorder,
+        VkDevice device,
+        uint32_t queueFamily,
+        uint32_t threadCount,
+        uint32_t slotCount
+);
+void recorderDestroy(Recorder *recorder);
+
+// Blocks until every worker has recorded its slice. pSecondaries receives
+// threadCount command buffers, to be executed in order inside the render
+// pass or dynamic rendering instance the inheritance info describes.
+const Result recorderRecord(
+        Recorder *recorder,
+        uint32_t slot,
+        const VkCommandBufferInheritanceInfo *inheritance,
+        uint32_t drawCount,
+        RecordDrawsFn recordDraws,
+        void *userData,
+        VkCommandBuffer *pSecondaries
+);
+
+#endif
@@ -0,0 +1,362 @@
+#include "registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t INDEX_MASK = REGISTRY_MAX_OBJECTS - 1;
+static const uint32_t GENERATION_LIMIT = UINT32_MAX >> REGISTRY_INDEX_BITS;
+
+// Set in a free slot's stored generation so no handle can match it
+static const uint32_t SLOT_FREE = 1u << 31;
+
+static void poolInit(RegistryPool *pool, size_t itemSize)
+{
+        memset(pool, 0, sizeof(RegistryPool));
+        pool->itemSize = itemSize;
+}
+
+static void poolDestroy(RegistryPool *pool)
+{
+        free(pool->items);
+        free(pool->generations);
+        free(pool->freeSlots);
+        poolInit(pool, pool->itemSize);
+}
+
+static void *poolItem(const RegistryPool *pool, uint32_t index)
+{
+        return (char *) pool->items + pool->itemSize * index;
+}
+
+static bool poolGrow(RegistryPool *pool)
+{
+        const uint32_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+        void *items = realloc(pool->items, pool->itemSize * capacity);
+        if (!items)
+                return false;
+
+        pool->items = items;
+
+        uint32_t *generations = realloc(pool->generations, sizeof(uint32_t) * capacity);
+        if (!generations)
+                return false;
+
+        pool->generations = generations;
+
+        uint32_t *freeSlots = realloc(pool->freeSlots, sizeof(uint32_t) * capacity);
+        if (!freeSlots)
+                return false;
+
+        pool->freeSlots = freeSlots;
+        pool->capacity = capacity;
+        return true;
+}
+
+// Copies item into a free slot and returns its id, 0 when out of slots
+static uint32_t poolInsert(RegistryPool *pool, const void *item)
+{
+        uint32_t index;
+        if (pool->freeCount > 0) {
+                index = pool->freeSlots[--pool->freeCount];
+                pool->generations[index] &= ~SLOT_FREE;
+        } else {
+                if (pool->slotCount == REGISTRY_MAX_OBJECTS)
+                        return 0;
+
+                if (pool->slotCount == pool->capacity && !poolGrow(pool))
+                        return 0;
+
+                index = pool->slotCount++;
+                pool->generations[index] = 1;
+        }
+
+        memcpy(poolItem(pool, index), item, pool->itemSize);
+        pool->liveCount++;
+        return (pool->generations[index] << REGISTRY_INDEX_BITS) | index;
+}
+
+static void *poolGet(const RegistryPool *pool, uint32_t id)
+{
+        const uint32_t index = id & INDEX_MASK;
+        const uint32_t generation = id >> REGISTRY_INDEX_BITS;
+        if (generation == 0 || index >= pool->slotCount)
+                return NULL;
+
+        if (pool->generations[index] != generation)
+                return NULL;
+
+        return poolItem(pool, index);
+}
+
+// Copies the item out and frees its slot under a new generation
+static bool poolRemove(RegistryPool *pool, uint32_t id, void *item)
+{
+        const void *stored = poolGet(pool, id);
+        if (!stored)
+                return false;
+
+        memcpy(item, stored, pool->itemSize);
+
+        // Wrapping back to 1 could make a very old handle resolve again, so
+        // a slot that has used up its generations is never handed out again
+        const uint32_t index = id & INDEX_MASK;
+        const uint32_t generation = pool->generations[index] + 1;
+        if (generation <= GENERATION_LIMIT) {
+                pool->generations[index] = generation | SLOT_FREE;
+                pool->freeSlots[pool->freeCount++] = index;
+        } else {
+                pool->generations[index] = SLOT_FREE;
+        }
+
+        pool->liveCount--;
+        return true;
+}
+
+static void destroyGarbage(Registry *registry, RegistryGarbage *garbage)
+{
+        switch (garbage->kind) {
+        case REGISTRY_KIND_BUFFER:
+                vkDestroyBuffer(registry->device, garbage->buffer.buffer, NULL);
+                allocatorFree(registry->allocator, &garbage->buffer.allocation);
+                break;
+        case REGISTRY_KIND_IMAGE:
+                vkDestroyImageView(registry->device, garbage->image.view, NULL);
+                vkDestroyImage(registry->device, garbage->image.image, NULL);
+                allocatorFree(registry->allocator, &garbage->image.allocation);
+                break;
+        case REGISTRY_KIND_PIPELINE:
+                vkDestroyPipeline(registry->device, garbage->pipeline.pipeline, NULL);
+                break;
+        }
+}
+
+static void pushGarbage(Registry *registry, RegistryGarbage garbage)
+{
+        if (registry->garbageCount == registry->garbageCapacity) {
+                const uint32_t capacity = registry->garbageCapacity
+                        ? registry->garbageCapacity * 2
+                        : 16;
+
+                RegistryGarbage *entries = realloc(
+                        registry->garbage,
+                        sizeof(RegistryGarbage) * capacity
+                );
+
+                // Leaking beats destroying something a frame may still read
+                if (!entries) {
+                        fprintf(stderr, "WARN: registry destruction queue full, object leaked\n");
+                        return;
+                }
+
+                registry->garbage = entries;
+                registry->garbageCapacity = capacity;
+        }
+
+        registry->garbage[registry->garbageCount++] = garbage;
+}
+
+void registryCreate(Registry *registry, VkDevice device, Allocator *allocator)
+{
+        memset(registry, 0, sizeof(Registry));
+        registry->device = device;
+        registry->allocator = allocator;
+        poolInit(&registry->buffers, sizeof(RegistryBuffer));
+        poolInit(&registry->images, sizeof(RegistryImage));
+        poolInit(&registry->pipelines, sizeof(RegistryPipeline));
+}
+
+void registryDestroy(Registry *registry)
+{
+        registryCollect(registry, UINT64_MAX);
+
+        // Whatever is still live goes the same way as released objects
+        RegistryGarbage garbage = { .kind = REGISTRY_KIND_BUFFER };
+        for (uint32_t i = 0; i < registry->buffers.slotCount; i++) {
+                const uint32_t id = (registry->buffers.generations[i] << REGISTRY_INDEX_BITS) | i;
+                if (poolRemove(&registry->buffers, id, &garbage.buffer))
+                        destroyGarbage(registry, &garbage);
+        }
+
+        garbage.kind = REGISTRY_KIND_IMAGE;
+        for (uint32_t i = 0; i < registry->images.slotCount; i++) {
+                const uint32_t id = (registry->images.generations[i] << REGISTRY_INDEX_BITS) | i;
+                if (poolRemove(&registry->images, id, &garbage.image))
+                        destroyGarbage(registry, &garbage);
+        }
+
+        garbage.kind = REGISTRY_KIND_PIPELINE;
+        for (uint32_t i = 0; i < registry->pipelines.slotCount; i++) {
+                const uint32_t id = (registry->pipelines.generations[i] << REGISTRY_INDEX_BITS) | i;
+                if (poolRemove(&registry->pipelines, id, &garbage.pipeline))
+                        destroyGarbage(registry, &garbage);
+        }
+
+        poolDestroy(&registry->buffers);
+        poolDestroy(&registry->images);
+        poolDestroy(&registry->pipelines);
+        free(registry->garbage);
+        registry->garbage = NULL;
+        registry->garbageCount = 0;
+        registry->garbageCapacity = 0;
+}
+
+const Result registryCreateBuffer(
+        Registry *registry,
+        const VkBufferCreateInfo *createInfo,
+        VkMemoryPropertyFlags properties,
+        BufferHandle *pHandle
+) {
+        RegistryBuffer buffer = { .size = createInfo->size };
+        VkResult result = vkCreateBuffer(registry->device, createInfo, NULL, &buffer.buffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create buffer!");
+
+        Result res = allocatorAllocateBuffer(
+                registry->allocator,
+                buffer.buffer,
+                properties,
+                &buffer.allocation
+        );
+
+        if (res.code != 0) {
+                vkDestroyBuffer(registry->device, buffer.buffer, NULL);
+                return res;
+        }
+
+        pHandle->id = poolInsert(&registry->buffers, &buffer);
+        if (pHandle->id == 0) {
+                vkDestroyBuffer(registry->device, buffer.buffer, NULL);
+                allocatorFree(registry->allocator, &buffer.allocation);
+                return RESULT_ERROR(-1, "out of buffer handles!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const Result registryCreateImage(
+        Registry *registry,
+        const VkImageCreateInfo *createInfo,
+        VkMemoryPropertyFlags properties,
+        const VkImageViewCreateInfo *viewInfo,
+        ImageHandle *pHandle
+) {
+        RegistryImage image = {0};
+        VkResult result = vkCreateImage(registry->device, createInfo, NULL, &image.image);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create image!");
+
+        Result res = allocatorAllocateImage(
+                registry->allocator,
+                image.image,
+                properties,
+                &image.allocation
+        );
+
+        if (res.code != 0) {
+                vkDestroyImage(registry->device, image.image, NULL);
+                return res;
+        }
+
+        if (viewInfo) {
+                VkImageViewCreateInfo imageViewInfo = *viewInfo;
+                imageViewInfo.image = image.image;
+                result = vkCreateImageView(registry->device, &imageViewInfo, NULL, &image.view);
+                if (result != VK_SUCCESS) {
+                        vkDestroyImage(registry->device, image.image, NULL);
+                        allocatorFree(registry->allocator, &image.allocation);
+                        return RESULT_ERROR(result, "failed to create image view!");
+                }
+        }
+
+        pHandle->id = poolInsert(&registry->images, &image);
+        if (pHandle->id == 0) {
+                vkDestroyImageView(registry->device, image.view, NULL);
+                vkDestroyImage(registry->device, image.image, NULL);
+                allocatorFree(registry->allocator, &image.allocation);
+                return RESULT_ERROR(-1, "out of image handles!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const Result registryAddPipeline(
+        Registry *registry,
+        VkPipeline pipeline,
+        VkPipelineBindPoint bindPoint,
+        PipelineHandle *pHandle
+) {
+        const RegistryPipeline item = {
+                .pipeline = pipeline,
+                .bindPoint = bindPoint,
+        };
+
+        pHandle->id = poolInsert(&registry->pipelines, &item);
+        if (pHandle->id == 0) {
+                vkDestroyPipeline(registry->device, pipeline, NULL);
+                return RESULT_ERROR(-1, "out of pipeline handles!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const RegistryBuffer *registryGetBuffer(const Registry *registry, BufferHandle handle)
+{
+        return poolGet(&registry->buffers, handle.id);
+}
+
+const RegistryImage *registryGetImage(const Registry *registry, ImageHandle handle)
+{
+        return poolGet(&registry->images, handle.id);
+}
+
+const RegistryPipeline *registryGetPipeline(const Registry *registry, PipelineHandle handle)
+{
+        return poolGet(&registry->pipelines, handle.id);
+}
+
+void registryReleaseBuffer(Registry *registry, BufferHandle handle, uint64_t lastUsedFrame)
+{
+        RegistryGarbage garbage = {
+                .frame = lastUsedFrame,
+                .kind = REGISTRY_KIND_BUFFER,
+        };
+
+        if (poolRemove(&registry->buffers, handle.id, &garbage.buffer))
+                pushGarbage(registry, garbage);
+}
+
+void registryReleaseImage(Registry *registry, ImageHandle handle, uint64_t lastUsedFrame)
+{
+        RegistryGarbage garbage = {
+                .frame = lastUsedFrame,
+                .kind = REGISTRY_KIND_IMAGE,
+        };
+
+        if (poolRemove(&registry->images, handle.id, &garbage.image))
+                pushGarbage(registry, garbage);
+}
+
+void registryReleasePipeline(Registry *registry, PipelineHandle handle, uint64_t lastUsedFrame)
+{
+        RegistryGarbage garbage = {
+                .frame = lastUsedFrame,
+                .kind = REGISTRY_KIND_PIPELINE,
+        };
+
+        if (poolRemove(&registry->pipelines, handle.id, &garbage.pipeline))
+                pushGarbage(registry, garbage);
+}
+
+void registryCollect(Registry *registry, uint64_t completedFrame)
+{
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < registry->garbageCount; i++) {
+                if (registry->garbage[i].frame <= completedFrame)
+                        destroyGarbage(registry, &registry->garbage[i]);
+                else
+                        registry->garbage[kept++] = registry->garbage[i];
+        }
+
+        registry->garbageCount = kept;
+}
@@ -0,0 +1,125 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "allocator.h"
+#include "result.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define REGISTRY_INDEX_BITS 20
+#define REGISTRY_MAX_OBJECTS (1u << REGISTRY_INDEX_BITS)
+
+// Slot index in the low bits, the slot's generation above them. An id of 0
+// is never handed out, so zeroed handles are null.
+typedef struct bufferHandle { uint32_t id; } BufferHandle;
+typedef struct imageHandle { uint32_t id; } ImageHandle;
+typedef struct pipelineHandle { uint32_t id; } PipelineHandle;
+
+typedef struct registryBuffer {
+        VkBuffer buffer;
+        Allocation allocation;
+        VkDeviceSize size;
+} RegistryBuffer;
+
+typedef struct registryImage {
+        VkImage image;
+        VkImageView view; // VK_NULL_HANDLE when created without one
+        Allocation allocation;
+} RegistryImage;
+
+typedef struct registryPipeline {
+        VkPipeline pipeline;
+        VkPipelineBindPoint bindPoint;
+} RegistryPipeline;
+
+// One kind of object in a dense array, with released slots reused through a
+// free list. A slot's generation changes when it is released, so handles to
+// whatever lived there before stop resolving.
+typedef struct registryPool {
+        void *items;
+        size_t itemSize;
+        uint32_t *generations;
+        uint32_t *freeSlots;
+        uint32_t freeCount;
+        uint32_t slotCount; // slots ever handed out
+        uint32_t capacity;
+        uint32_t liveCount;
+} RegistryPool;
+
+typedef enum registryKind {
+        REGISTRY_KIND_BUFFER,
+        REGISTRY_KIND_IMAGE,
+        REGISTRY_KIND_PIPELINE,
+} RegistryKind;
+
+typedef struct registryGarbage {
+        uint64_t frame; // last frame that may still use the objects
+        RegistryKind kind;
+        union {
+                RegistryBuffer buffer;
+                RegistryImage image;
+                RegistryPipeline pipeline;
+        };
+} RegistryGarbage;
+
+// Owns GPU objects behind generational handles. Releasing a handle
+// invalidates it at once but only destroys the objects after the last
+// frame that may use them has completed, so assets can come and go while
+// frames are in flight. Not thread-safe; lookups may run on other threads
+// only while nothing is created or released.
+typedef struct registry {
+        VkDevice device;
+        Allocator *allocator;
+        RegistryPool buffers;
+        RegistryPool images;
+        RegistryPool pipelines;
+        RegistryGarbage *garbage;
+        uint32_t garbageCount;
+        uint32_t garbageCapacity;
+} Registry;
+
+void registryCreate(Registry *registry, VkDevice device, Allocator *allocator);
+// Destroys everything, released or not; the device must be idle
+void registryDestroy(Registry *registry);
+
+const Result registryCreateBuffer(
+        Registry *registry,
+        const VkBufferCreateInfo *createInfo,
+        VkMemoryPropertyFlags properties,
+        BufferHandle *pHandle
+);
+
+// viewInfo may be NULL; its image field is filled in
+const Result registryCreateImage(
+        Registry *registry,
+        const VkImageCreateInfo *createInfo,
+        VkMemoryPropertyFlags properties,
+        const VkImageViewCreateInfo *viewInfo,
+        ImageHandle *pHandle
+);
+
+// Takes ownership of a pipeline created elsewhere
+const Result registryAddPipeline(
+        Registry *registry,
+        VkPipeline pipeline,
+        VkPipelineBindPoint bindPoint,
+        PipelineHandle *pHandle
+);
+
+// NULL for null or released handles. Pointers stay valid until the next
+// object of the same kind is created.
+const RegistryBuffer *registryGetBuffer(const Registry *registry, BufferHandle handle);
+const RegistryImage *registryGetImage(const Registry *registry, ImageHandle handle);
+const RegistryPipeline *registryGetPipeline(const Registry *registry, PipelineHandle handle);
+
+// lastUsedFrame is the last frame submitted that may reference the object
+void registryReleaseBuffer(Registry *registry, BufferHandle handle, uint64_t lastUsedFrame);
+void registryReleaseImage(Registry *registry, ImageHandle handle, uint64_t lastUsedFrame);
+void registryReleasePipeline(Registry *registry, PipelineHandle handle, uint64_t lastUsedFrame);
+
+// Destroys everything released at or before completedFrame
+void registryCollect(Registry *registry, uint64_t completedFrame);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+typedef struct result {
+        int code;
+        void *data;
+} Result;
+
+extern const Result RESULT_SUCCESS;
+
+#define RESULT_ERROR(c, msg) (Result) { .code = c, .data = msg }
+
+#define handle(result) \
+        res = result; \
+        if (res.code != 0) \
+                return res;
+
+#endif
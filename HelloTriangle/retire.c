@@ -0,0 +1,84 @@
+#include "retire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void destroyObject(VkDevice device, const RetireEntry *entry)
+{
+        switch (entry->type) {
+        case VK_OBJECT_TYPE_PIPELINE:
+                vkDestroyPipeline(device, (VkPipeline) (uintptr_t) entry->handle, NULL);
+                break;
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+                vkDestroyPipelineLayout(device, (VkPipelineLayout) (uintptr_t) entry->handle, NULL);
+                break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+                vkDestroyFramebuffer(device, (VkFramebuffer) (uintptr_t) entry->handle, NULL);
+                break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+                vkDestroyImageView(device, (VkImageView) (uintptr_t) entry->handle, NULL);
+                break;
+        case VK_OBJECT_TYPE_BUFFER:
+                vkDestroyBuffer(device, (VkBuffer) (uintptr_t) entry->handle, NULL);
+                break;
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+                vkDestroySwapchainKHR(device, (VkSwapchainKHR) (uintptr_t) entry->handle, NULL);
+                break;
+        default:
+                fprintf(stderr, "WARN: cannot retire object type %d\n", entry->type);
+                break;
+        }
+}
+
+void retireQueuePush(
+        RetireQueue *queue,
+        uint64_t frame,
+        VkObjectType type,
+        uint64_t handle
+) {
+        if (queue->count == queue->capacity) {
+                const uint32_t capacity = queue->capacity ? queue->capacity * 2 : 16;
+                RetireEntry *entries = realloc(queue->entries, sizeof(RetireEntry) * capacity);
+
+                if (!entries) {
+                        fprintf(stderr, "WARN: retire queue full, object leaked\n");
+                        return;
+                }
+
+                queue->entries = entries;
+                queue->capacity = capacity;
+        }
+
+        queue->entries[queue->count++] = (RetireEntry) {
+                .frame = frame,
+                .type = type,
+                .handle = handle,
+        };
+}
+
+void retireQueueCollect(RetireQueue *queue, VkDevice device, uint64_t completedFrame)
+{
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < queue->count; i++) {
+                if (queue->entries[i].frame <= completedFrame)
+                        destroyObject(device, &queue->entries[i]);
+                else
+                        queue->entries[kept++] = queue->entries[i];
+        }
+
+        queue->count = kept;
+}
+
+void retireQueueFlush(RetireQueue *queue, VkDevice device)
+{
+        for (uint32_t i = 0; i < queue->count; i++)
+                destroyObject(device, &queue->entries[i]);
+
+        queue->count = 0;
+}
+
+void retireQueueDestroy(RetireQueue *queue)
+{
+        free(queue->entries);
+        *queue = (RetireQueue) {0};
+}
@@ -0,0 +1,38 @@
+#ifndef RETIRE_H
+#define RETIRE_H
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define RETIRE_HANDLE(handle) ((uint64_t) (uintptr_t) (handle))
+
+typedef struct retireEntry {
+        uint64_t frame; // last frame that may still use the object
+        VkObjectType type;
+        uint64_t handle;
+} RetireEntry;
+
+// Objects that are no longer used by new frames but may still be read by
+// frames in flight. They are destroyed once the frame they were last
+// submitted in has completed, instead of waiting for the device to idle.
+typedef struct retireQueue {
+        RetireEntry *entries;
+        uint32_t count;
+        uint32_t capacity;
+} RetireQueue;
+
+void retireQueuePush(
+        RetireQueue *queue,
+        uint64_t frame,
+        VkObjectType type,
+        uint64_t handle
+);
+
+// Destroys everything retired at or before completedFrame
+void retireQueueCollect(RetireQueue *queue, VkDevice device, uint64_t completedFrame);
+
+// Destroys everything regardless of frame; the device must be idle
+void retireQueueFlush(RetireQueue *queue, VkDevice device);
+void retireQueueDestroy(RetireQueue *queue);
+
+#endif
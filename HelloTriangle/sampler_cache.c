@@ -0,0 +1,125 @@
+#include "sampler_cache.h"
+
+#include "hash.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const uint32_t INITIAL_CAPACITY = 16;
+
+static SamplerKey samplerKey(const VkSamplerCreateInfo *info)
+{
+        return (SamplerKey) {
+                .flags = info->flags,
+                .magFilter = info->magFilter,
+                .minFilter = info->minFilter,
+                .mipmapMode = info->mipmapMode,
+                .addressModeU = info->addressModeU,
+                .addressModeV = info->addressModeV,
+                .addressModeW = info->addressModeW,
+                .mipLodBias = info->mipLodBias,
+                .anisotropyEnable = info->anisotropyEnable,
+                .maxAnisotropy = info->maxAnisotropy,
+                .compareEnable = info->compareEnable,
+                .compareOp = info->compareOp,
+                .minLod = info->minLod,
+                .maxLod = info->maxLod,
+                .borderColor = info->borderColor,
+                .unnormalizedCoordinates = info->unnormalizedCoordinates,
+        };
+}
+
+static SamplerEntry *findSlot(
+        SamplerEntry *entries,
+        uint32_t capacity,
+        uint64_t hash,
+        const SamplerKey *key
+) {
+        return &entries[hashFindSlot(
+                entries,
+                sizeof(SamplerEntry),
+                capacity,
+                hash,
+                key,
+                offsetof(SamplerEntry, key),
+                sizeof(SamplerKey)
+        )];
+}
+
+static bool grow(SamplerCache *cache)
+{
+        const uint32_t capacity = cache->capacity ? cache->capacity * 2 : INITIAL_CAPACITY;
+        SamplerEntry *entries = calloc(capacity, sizeof(SamplerEntry));
+        if (!entries)
+                return false;
+
+        for (uint32_t i = 0; i < cache->capacity; i++) {
+                const SamplerEntry *entry = &cache->entries[i];
+                if (entry->hash != 0)
+                        *findSlot(entries, capacity, entry->hash, &entry->key) = *entry;
+        }
+
+        free(cache->entries);
+        cache->entries = entries;
+        cache->capacity = capacity;
+        return true;
+}
+
+void samplerCacheCreate(SamplerCache *cache, VkDevice device)
+{
+        memset(cache, 0, sizeof(SamplerCache));
+        cache->device = device;
+}
+
+void samplerCacheDestroy(SamplerCache *cache)
+{
+        for (uint32_t i = 0; i < cache->capacity; i++) {
+                if (cache->entries[i].hash != 0)
+                        vkDestroySampler(cache->device, cache->entries[i].sampler, NULL);
+        }
+
+        free(cache->entries);
+        cache->entries = NULL;
+        cache->capacity = 0;
+        cache->count = 0;
+}
+
+const Result samplerCacheGet(
+        SamplerCache *cache,
+        const VkSamplerCreateInfo *info,
+        VkSampler *pSampler
+) {
+        if (info->pNext != NULL)
+                return RESULT_ERROR(-1, "cached samplers cannot have extension structs!");
+
+        const SamplerKey key = samplerKey(info);
+        const uint64_t hash = hashBytes(&key, sizeof(SamplerKey));
+
+        // Kept under three quarters full so probes stay short
+        if ((cache->count + 1) * 4 > cache->capacity * 3 && !grow(cache))
+                return RESULT_ERROR(-1, "failed to grow sampler cache!");
+
+        SamplerEntry *entry = findSlot(cache->entries, cache->capacity, hash, &key);
+        if (entry->hash != 0) {
+                cache->hits++;
+                *pSampler = entry->sampler;
+                return RESULT_SUCCESS;
+        }
+
+        VkSampler sampler;
+        const VkResult result = vkCreateSampler(cache->device, info, NULL, &sampler);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create sampler!");
+
+        *entry = (SamplerEntry) {
+                .hash = hash,
+                .key = key,
+                .sampler = sampler,
+        };
+
+        cache->count++;
+        cache->misses++;
+        *pSampler = sampler;
+        return RESULT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include "result.h"
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// Every VkSamplerCreateInfo field that affects the sampler, all 4 bytes
+// wide so the struct has no padding to hash or compare
+typedef struct samplerKey {
+        uint32_t flags;
+        uint32_t magFilter;
+        uint32_t minFilter;
+        uint32_t mipmapMode;
+        uint32_t addressModeU;
+        uint32_t addressModeV;
+        uint32_t addressModeW;
+        float mipLodBias;
+        uint32_t anisotropyEnable;
+        float maxAnisotropy;
+        uint32_t compareEnable;
+        uint32_t compareOp;
+        float minLod;
+        float maxLod;
+        uint32_t borderColor;
+        uint32_t unnormalizedCoordinates;
+} SamplerKey;
+
+typedef struct samplerEntry {
+        uint64_t hash; // 0 marks an empty slot
+        SamplerKey key;
+        VkSampler sampler;
+} SamplerEntry;
+
+// Deduplicates samplers: identical descriptions share one VkSampler, kept
+// in an open-addressed hash table until the cache is destroyed. Devices
+// only guarantee maxSamplerAllocationCount (as low as 4000) samplers.
+typedef struct samplerCache {
+        VkDevice device;
+        SamplerEntry *entries;
+        uint32_t capacity; // power of two
+        uint32_t count;
+        uint32_t hits;
+        uint32_t misses;
+} SamplerCache;
+
+void samplerCacheCreate(SamplerCache *cache, VkDevice device);
+void samplerCacheDestroy(SamplerCache *cache);
+
+// Returns the sampler for an identical description, creating it on first
+// use. info->pNext must be NULL, since chained structs are not hashed.
+const Result samplerCacheGet(
+        SamplerCache *cache,
+        const VkSamplerCreateInfo *info,
+        VkSampler *pSampler
+);
+
+#endif
@@ -0,0 +1,123 @@
+#include "shaders.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SPIRV_MAGIC 0x07230203
+
+// Generated by compile.sh with glslc -mfmt=num
+static const uint32_t VERT_SPV[] = {
+#include "shaders/vert.spv.inc"
+};
+
+static const uint32_t FRAG_SPV[] = {
+#include "shaders/frag.spv.inc"
+};
+
+static const uint32_t FRAG_UNTEXTURED_SPV[] = {
+#include "shaders/frag_untextured.spv.inc"
+};
+
+static const uint32_t CULL_SPV[] = {
+#include "shaders/cull.spv.inc"
+};
+
+static const uint32_t PARTICLES_SPV[] = {
+#include "shaders/particles.spv.inc"
+};
+
+static const uint32_t QUAD_VERT_SPV[] = {
+#include "shaders/quad_vert.spv.inc"
+};
+
+static const uint32_t QUAD_FRAG_SPV[] = {
+#include "shaders/quad_frag.spv.inc"
+};
+
+typedef struct embeddedShader {
+        const char *name;
+        const uint32_t *code;
+        size_t size;
+} EmbeddedShader;
+
+static const EmbeddedShader EMBEDDED_SHADERS[] = {
+        { "vert", VERT_SPV, sizeof(VERT_SPV) },
+        { "frag", FRAG_SPV, sizeof(FRAG_SPV) },
+        { "frag_untextured", FRAG_UNTEXTURED_SPV, sizeof(FRAG_UNTEXTURED_SPV) },
+        { "cull", CULL_SPV, sizeof(CULL_SPV) },
+        { "particles", PARTICLES_SPV, sizeof(PARTICLES_SPV) },
+        { "quad_vert", QUAD_VERT_SPV, sizeof(QUAD_VERT_SPV) },
+        { "quad_frag", QUAD_FRAG_SPV, sizeof(QUAD_FRAG_SPV) },
+};
+
+static const uint32_t EMBEDDED_SHADER_COUNT =
+        sizeof(EMBEDDED_SHADERS) / sizeof(EMBEDDED_SHADERS[0]);
+
+static const Result mapShader(const char *path, ShaderCode *pCode)
+{
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return RESULT_ERROR(-1, "failed to open shader override!");
+
+        struct stat st;
+        if (fstat(fd, &st) != 0
+                || st.st_size < (off_t) sizeof(uint32_t)
+                || st.st_size % sizeof(uint32_t) != 0
+        ) {
+                close(fd);
+                return RESULT_ERROR(-1, "shader override is not SPIR-V!");
+        }
+
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+                return RESULT_ERROR(-1, "failed to map shader override!");
+
+        if (*(const uint32_t *) mapping != SPIRV_MAGIC) {
+                munmap(mapping, st.st_size);
+                return RESULT_ERROR(-1, "shader override is not SPIR-V!");
+        }
+
+        *pCode = (ShaderCode) {
+                .code = mapping,
+                .size = st.st_size,
+                .mapping = mapping,
+        };
+
+        return RESULT_SUCCESS;
+}
+
+const Result shaderLoad(const char *overrideDir, const char *name, ShaderCode *pCode)
+{
+        if (overrideDir) {
+                char path[PATH_MAX];
+                snprintf(path, sizeof(path), "%s/%s.spv", overrideDir, name);
+                return mapShader(path, pCode);
+        }
+
+        for (uint32_t i = 0; i < EMBEDDED_SHADER_COUNT; i++) {
+                if (strcmp(EMBEDDED_SHADERS[i].name, name) == 0) {
+                        *pCode = (ShaderCode) {
+                                .code = EMBEDDED_SHADERS[i].code,
+                                .size = EMBEDDED_SHADERS[i].size,
+                        };
+
+                        return RESULT_SUCCESS;
+                }
+        }
+
+        return RESULT_ERROR(-1, "no embedded shader with that name!");
+}
+
+void shaderRelease(ShaderCode *code)
+{
+        if (code->mapping)
+                munmap(code->mapping, code->size);
+
+        *code = (ShaderCode) {0};
+}
@@ -0,0 +1,19 @@
+#ifndef SHADERS_H
+#define SHADERS_H
+
+#include "result.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct shaderCode {
+        const uint32_t *code;
+        size_t size; // in bytes
+        void *mapping; // NULL for embedded code
+} ShaderCode;
+
+// Looks up SPIR-V by name ("vert", "frag", ...). Embedded code is returned
+// in place; with an override directory <dir>/<name>.spv is mapped instead.
+const Result shaderLoad(const char *overrideDir, const char *name, ShaderCode *pCode);
+void shaderRelease(ShaderCode *code);
+
+#endif
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) flat in uint fragTexture;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+void main()
+{
+        vec4 color = fragColor;
+
+        // One draw covers many textures, so the index may vary within it
+        if (fragTexture != 0xffffffffu)
+                color *= texture(textures[nonuniformEXT(fragTexture)], fragUV);
+
+        outColor = color;
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// Already in clip space, written by the quad batcher every frame
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inTexture;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
+
+void main()
+{
+        gl_Position = vec4(inPosition, 0.0, 1.0);
+        fragColor = inColor;
+        fragUV = inUV;
+        fragTexture = inTexture;
+}
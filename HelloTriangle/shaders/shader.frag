@@ -1,9 +1,32 @@
 #version 450
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
 layout(location = 0) out vec4 outColor;
 
+// Built a second time with UNTEXTURED for devices without descriptor
+// indexing, where the pipeline layout has no set 1
+#ifndef UNTEXTURED
+#extension GL_EXT_nonuniform_qualifier : require
+
+// The bindless heap; only the slots in use are written
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+#endif
+
+layout(push_constant) uniform DrawParams {
+        uint drawIndex;
+        uint textureIndex; // 0xffffffff for none
+} params;
+
 void main()
 {
-        outColor = vec4(fragColor, 1.0);
+        vec3 color = fragColor;
+
+#ifndef UNTEXTURED
+        // Constant across the draw, so no nonuniformEXT
+        if (params.textureIndex != 0xffffffffu)
+                color *= texture(textures[params.textureIndex], fragUV).rgb;
+#endif
+
+        outColor = vec4(color, 1.0);
 }
@@ -3,10 +3,36 @@
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
+// Per instance, a mat4 takes up locations 2 through 5
+layout(location = 2) in mat4 inTransform;
+layout(location = 6) in vec4 inInstanceColor;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+layout(set = 0, binding = 0) uniform Frame {
+        mat4 viewProjection;
+        vec4 time; // seconds since start, seconds since the previous frame
+} frame;
+
+struct DrawUniforms {
+        vec4 tint;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Draws {
+        DrawUniforms draws[];
+};
+
+layout(push_constant) uniform DrawParams {
+        uint drawIndex;
+        uint textureIndex; // read by the fragment shader
+} params;
 
 void main()
 {
-        gl_Position = vec4(inPosition, 0.0, 1.0);
-        fragColor = inColor;
+        gl_Position = frame.viewProjection * inTransform * vec4(inPosition, 0.0, 1.0);
+        fragColor = inColor * inInstanceColor.rgb * draws[params.drawIndex].tint.rgb;
+
+        // The built-in quad spans -0.5 to 0.5
+        fragUV = inPosition + 0.5;
 }
@@ -0,0 +1,882 @@
+#include "texture.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The first build uploads levels no larger than this, so loading is quick
+static const uint32_t INITIAL_EXTENT = 64;
+
+static const unsigned char KTX2_IDENTIFIER[12] = {
+        0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n',
+};
+
+static const size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+static const size_t KTX2_LEVEL_ENTRY_SIZE = 24;
+
+typedef struct formatInfo {
+        VkFormat format;
+        uint32_t blockSize;
+        uint32_t blockBytes;
+} FormatInfo;
+
+static const uint32_t FORMAT_COUNT = 15;
+static const FormatInfo FORMATS[] = {
+        { VK_FORMAT_R8_UNORM, 1, 1 },
+        { VK_FORMAT_R8G8_UNORM, 1, 2 },
+        { VK_FORMAT_R8G8B8A8_UNORM, 1, 4 },
+        { VK_FORMAT_R8G8B8A8_SRGB, 1, 4 },
+        { VK_FORMAT_B8G8R8A8_UNORM, 1, 4 },
+        { VK_FORMAT_B8G8R8A8_SRGB, 1, 4 },
+        { VK_FORMAT_R16G16B16A16_SFLOAT, 1, 8 },
+        { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4, 8 },
+        { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4, 8 },
+        { VK_FORMAT_BC3_UNORM_BLOCK, 4, 16 },
+        { VK_FORMAT_BC3_SRGB_BLOCK, 4, 16 },
+        { VK_FORMAT_BC4_UNORM_BLOCK, 4, 8 },
+        { VK_FORMAT_BC5_UNORM_BLOCK, 4, 16 },
+        { VK_FORMAT_BC7_UNORM_BLOCK, 4, 16 },
+        { VK_FORMAT_BC7_SRGB_BLOCK, 4, 16 },
+};
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+        return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static const FormatInfo *findFormat(VkFormat format)
+{
+        for (uint32_t i = 0; i < FORMAT_COUNT; i++) {
+                if (FORMATS[i].format == format)
+                        return &FORMATS[i];
+        }
+
+        return NULL;
+}
+
+static uint32_t levelExtent(uint32_t extent, uint32_t level)
+{
+        const uint32_t levelSize = extent >> level;
+        return levelSize ? levelSize : 1;
+}
+
+// Down to 1x1
+static uint32_t fullChainLevels(uint32_t width, uint32_t height)
+{
+        uint32_t levels = 1;
+        while ((width | height) >> levels)
+                levels++;
+
+        return levels;
+}
+
+static uint64_t levelBytes(const TextureFile *file, uint32_t level)
+{
+        const uint32_t width = levelExtent(file->width, level);
+        const uint32_t height = levelExtent(file->height, level);
+        const uint64_t blocksWide = (width + file->blockSize - 1) / file->blockSize;
+        const uint64_t blocksHigh = (height + file->blockSize - 1) / file->blockSize;
+        return blocksWide * blocksHigh * file->blockBytes;
+}
+
+static uint32_t readU32(const unsigned char *bytes)
+{
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+}
+
+static uint64_t readU64(const unsigned char *bytes)
+{
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+}
+
+static bool parseKtx2(TextureFile *file)
+{
+        const unsigned char *bytes = file->mapping;
+        if (file->mappingSize < KTX2_LEVEL_INDEX_OFFSET)
+                return false;
+
+        file->format = readU32(bytes + 12);
+        file->width = readU32(bytes + 20);
+        file->height = readU32(bytes + 24);
+        const uint32_t depth = readU32(bytes + 28);
+        const uint32_t layerCount = readU32(bytes + 32);
+        const uint32_t faceCount = readU32(bytes + 36);
+        const uint32_t levelCount = readU32(bytes + 40);
+        const uint32_t supercompression = readU32(bytes + 44);
+        if (depth != 0 || layerCount > 1 || faceCount != 1 || supercompression != 0)
+                return false;
+
+        // 0 asks for the rest of the chain to be generated on load
+        file->levelCount = levelCount ? levelCount : 1;
+        if (file->levelCount > TEXTURE_MAX_LEVELS)
+                return false;
+
+        if (KTX2_LEVEL_INDEX_OFFSET + KTX2_LEVEL_ENTRY_SIZE * file->levelCount > file->mappingSize)
+                return false;
+
+        for (uint32_t i = 0; i < file->levelCount; i++) {
+                const unsigned char *entry = bytes + KTX2_LEVEL_INDEX_OFFSET + KTX2_LEVEL_ENTRY_SIZE * i;
+                file->levels[i] = (TextureLevel) {
+                        .offset = readU64(entry),
+                        .size = readU64(entry + 8),
+                };
+        }
+
+        return true;
+}
+
+static bool parseRaw(TextureFile *file)
+{
+        TextureRawHeader header;
+        if (file->mappingSize < sizeof(TextureRawHeader))
+                return false;
+
+        memcpy(&header, file->mapping, sizeof(TextureRawHeader));
+        if (header.magic != TEXTURE_RAW_MAGIC || header.version != TEXTURE_RAW_VERSION)
+                return false;
+
+        const FormatInfo *info = findFormat(header.format);
+        if (!info || header.levelCount == 0 || header.levelCount > TEXTURE_MAX_LEVELS)
+                return false;
+
+        file->format = header.format;
+        file->width = header.width;
+        file->height = header.height;
+        file->levelCount = header.levelCount;
+        file->blockSize = info->blockSize;
+        file->blockBytes = info->blockBytes;
+
+        uint64_t offset = sizeof(TextureRawHeader);
+        for (uint32_t i = 0; i < file->levelCount; i++) {
+                offset = alignUp(offset, TEXTURE_RAW_ALIGNMENT);
+                file->levels[i] = (TextureLevel) {
+                        .offset = offset,
+                        .size = levelBytes(file, i),
+                };
+
+                offset += file->levels[i].size;
+        }
+
+        return true;
+}
+
+static bool fileValid(TextureFile *file)
+{
+        const FormatInfo *info = findFormat(file->format);
+        if (!info || file->width == 0 || file->height == 0)
+                return false;
+
+        file->blockSize = info->blockSize;
+        file->blockBytes = info->blockBytes;
+
+        if (file->levelCount > fullChainLevels(file->width, file->height))
+                return false;
+
+        for (uint32_t i = 0; i < file->levelCount; i++) {
+                const TextureLevel *level = &file->levels[i];
+                if (level->size != levelBytes(file, i)
+                        || level->offset > file->mappingSize
+                        || level->size > file->mappingSize - level->offset
+                ) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+const Result textureFileLoad(TextureFile *file, const char *path)
+{
+        memset(file, 0, sizeof(TextureFile));
+
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return RESULT_ERROR(-1, "failed to open texture file!");
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(KTX2_IDENTIFIER)) {
+                close(fd);
+                return RESULT_ERROR(-1, "texture file is truncated!");
+        }
+
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+                return RESULT_ERROR(-1, "failed to map texture file!");
+
+        // Levels are read one at a time as they stream in, not front to back
+        madvise(mapping, st.st_size, MADV_RANDOM);
+
+        file->mapping = mapping;
+        file->mappingSize = st.st_size;
+
+        const bool parsed = memcmp(mapping, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0
+                ? parseKtx2(file)
+                : parseRaw(file);
+
+        if (!parsed || !fileValid(file)) {
+                textureFileUnmap(file);
+                return RESULT_ERROR(-1, "invalid or unsupported texture file!");
+        }
+
+        return RESULT_SUCCESS;
+}
+
+void textureFileUnmap(TextureFile *file)
+{
+        if (file->mapping)
+                munmap(file->mapping, file->mappingSize);
+
+        file->mapping = NULL;
+        file->mappingSize = 0;
+}
+
+const Result textureManagerCreate(
+        TextureManager *manager,
+        VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        Registry *registry,
+        UploadManager *uploads,
+        uint32_t queueFamily,
+        VkQueue queue,
+        float maxAnisotropy,
+        VkDeviceSize budget
+) {
+        memset(manager, 0, sizeof(TextureManager));
+        manager->device = device;
+        manager->physicalDevice = physicalDevice;
+        manager->registry = registry;
+        manager->uploads = uploads;
+        manager->maxAnisotropy = maxAnisotropy;
+        manager->queue = queue;
+        manager->budget = budget;
+        samplerCacheCreate(&manager->samplers, device);
+
+        manager->queueFamilies[manager->queueFamilyCount++] = queueFamily;
+        if (uploads->queueFamily != queueFamily)
+                manager->queueFamilies[manager->queueFamilyCount++] = uploads->queueFamily;
+
+        const VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = queueFamily,
+        };
+
+        VkResult result = vkCreateCommandPool(device, &poolInfo, NULL, &manager->commandPool);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create texture command pool!");
+
+        const VkSemaphoreTypeCreateInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+        };
+
+        const VkSemaphoreCreateInfo semaphoreInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                .pNext = &timelineInfo,
+        };
+
+        result = vkCreateSemaphore(device, &semaphoreInfo, NULL, &manager->timeline);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create texture timeline semaphore!");
+
+        return RESULT_SUCCESS;
+}
+
+void textureManagerDestroy(TextureManager *manager)
+{
+        for (uint32_t i = 0; i < manager->textureCount; i++) {
+                Texture *texture = &manager->textures[i];
+                registryReleaseImage(manager->registry, texture->image, 0);
+                registryReleaseImage(manager->registry, texture->pendingImage, 0);
+                textureFileUnmap(&texture->file);
+        }
+
+        samplerCacheDestroy(&manager->samplers);
+        vkDestroySemaphore(manager->device, manager->timeline, NULL);
+        vkDestroyCommandPool(manager->device, manager->commandPool, NULL);
+        free(manager->textures);
+        manager->textures = NULL;
+        manager->textureCount = 0;
+        manager->textureCapacity = 0;
+}
+
+// Every level of an image starting at firstLevel
+static VkDeviceSize chainBytes(const Texture *texture, uint32_t firstLevel)
+{
+        VkDeviceSize bytes = 0;
+        for (uint32_t level = firstLevel; level < texture->chainLevels; level++)
+                bytes += levelBytes(&texture->file, level);
+
+        return bytes;
+}
+
+static const Result createLevelImage(
+        TextureManager *manager,
+        Texture *texture,
+        uint32_t firstLevel
+) {
+        const TextureFile *file = &texture->file;
+        const uint32_t mipLevels = texture->chainLevels - firstLevel;
+        const bool shared = manager->queueFamilyCount > 1;
+
+        const VkImageCreateInfo imageInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = file->format,
+                .extent = {
+                        .width = levelExtent(file->width, firstLevel),
+                        .height = levelExtent(file->height, firstLevel),
+                        .depth = 1,
+                },
+                .mipLevels = mipLevels,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+                        | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                        | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = shared ? manager->queueFamilyCount : 0,
+                .pQueueFamilyIndices = shared ? manager->queueFamilies : NULL,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+
+        const VkImageViewCreateInfo viewInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = file->format,
+                .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = 0,
+                        .levelCount = mipLevels,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+
+        Result res;
+        handle(registryCreateImage(
+                manager->registry,
+                &imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &viewInfo,
+                &texture->pendingImage
+        ));
+
+        texture->pendingLevel = firstLevel;
+        texture->pendingBytes = registryGetImage(manager->registry, texture->pendingImage)->allocation.size;
+        manager->residentBytes += texture->pendingBytes;
+        return RESULT_SUCCESS;
+}
+
+static void levelBarrier(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        uint32_t baseLevel,
+        uint32_t levelCount,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        VkPipelineStageFlags srcStage,
+        VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage,
+        VkAccessFlags dstAccess
+) {
+        const VkImageMemoryBarrier barrier = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = srcAccess,
+                .dstAccessMask = dstAccess,
+                .oldLayout = oldLayout,
+                .newLayout = newLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = {
+                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel = baseLevel,
+                        .levelCount = levelCount,
+                        .baseArrayLayer = 0,
+                        .layerCount = 1,
+                },
+        };
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                srcStage,
+                dstStage,
+                0,
+                0, NULL,
+                0, NULL,
+                1, &barrier
+        );
+}
+
+// Stages file levels firstLevel to endLevel - 1 into the image's mips from 0
+static const Result uploadLevels(
+        TextureManager *manager,
+        Texture *texture,
+        VkImage image,
+        uint32_t firstLevel,
+        uint32_t endLevel
+) {
+        const TextureFile *file = &texture->file;
+        Result res;
+        for (uint32_t level = firstLevel; level < endLevel; level++) {
+                const VkExtent2D extent = {
+                        .width = levelExtent(file->width, level),
+                        .height = levelExtent(file->height, level),
+                };
+
+                handle(uploadImage(
+                        manager->uploads,
+                        image,
+                        level - firstLevel,
+                        extent,
+                        file->blockSize,
+                        file->blockBytes,
+                        (const char *) file->mapping + file->levels[level].offset
+                ));
+
+                manager->uploadedBytes += file->levels[level].size;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Uploaded mips arrive in TRANSFER_DST; any the file lacks are blitted down
+// from the one above, then everything goes to SHADER_READ_ONLY
+static void recordInitialBuild(const Texture *texture, VkImage image)
+{
+        const VkCommandBuffer commandBuffer = texture->commandBuffer;
+        const uint32_t first = texture->pendingLevel;
+        const uint32_t uploaded = texture->file.levelCount - first;
+        const uint32_t mipLevels = texture->chainLevels - first;
+
+        if (mipLevels == uploaded) {
+                levelBarrier(
+                        commandBuffer, image, 0, mipLevels,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+                );
+
+                return;
+        }
+
+        levelBarrier(
+                commandBuffer, image, uploaded, mipLevels - uploaded,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+        );
+
+        for (uint32_t mip = uploaded; mip < mipLevels; mip++) {
+                levelBarrier(
+                        commandBuffer, image, mip - 1, 1,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+                );
+
+                const VkImageBlit blit = {
+                        .srcSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = mip - 1,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                        .srcOffsets = {
+                                { 0, 0, 0 },
+                                {
+                                        (int32_t) levelExtent(texture->file.width, first + mip - 1),
+                                        (int32_t) levelExtent(texture->file.height, first + mip - 1),
+                                        1,
+                                },
+                        },
+                        .dstSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = mip,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                        .dstOffsets = {
+                                { 0, 0, 0 },
+                                {
+                                        (int32_t) levelExtent(texture->file.width, first + mip),
+                                        (int32_t) levelExtent(texture->file.height, first + mip),
+                                        1,
+                                },
+                        },
+                };
+
+                vkCmdBlitImage(
+                        commandBuffer,
+                        image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        1, &blit,
+                        VK_FILTER_LINEAR
+                );
+        }
+
+        // Every blit source, then the last level, then uploads above them
+        levelBarrier(
+                commandBuffer, image, uploaded - 1, mipLevels - uploaded,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+
+        levelBarrier(
+                commandBuffer, image, mipLevels - 1, 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+
+        if (uploaded > 1) {
+                levelBarrier(
+                        commandBuffer, image, 0, uploaded - 1,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+                );
+        }
+}
+
+// Mip 0 of the new image was uploaded; the coarser mips are copied over
+// from the current image, which frames keep sampling until the swap
+static void recordStreamBuild(const Texture *texture, VkImage oldImage, VkImage newImage)
+{
+        const VkCommandBuffer commandBuffer = texture->commandBuffer;
+        const uint32_t copied = texture->chainLevels - texture->residentLevel;
+
+        levelBarrier(
+                commandBuffer, newImage, 1, copied,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+        );
+
+        levelBarrier(
+                commandBuffer, oldImage, 0, copied,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+        );
+
+        VkImageCopy regions[TEXTURE_MAX_LEVELS];
+        for (uint32_t mip = 0; mip < copied; mip++) {
+                const uint32_t level = texture->residentLevel + mip;
+                regions[mip] = (VkImageCopy) {
+                        .srcSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = mip,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                        .dstSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = mip + 1,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                        .extent = {
+                                .width = levelExtent(texture->file.width, level),
+                                .height = levelExtent(texture->file.height, level),
+                                .depth = 1,
+                        },
+                };
+        }
+
+        vkCmdCopyImage(
+                commandBuffer,
+                oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                copied, regions
+        );
+
+        levelBarrier(
+                commandBuffer, oldImage, 0, copied,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+
+        levelBarrier(
+                commandBuffer, newImage, 0, copied + 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT
+        );
+}
+
+// Uploads the pending image's new levels, then records and submits the
+// graphics side of the build behind the upload's ticket
+static const Result submitPendingImage(TextureManager *manager, Texture *texture)
+{
+        const Registry *registry = manager->registry;
+        const VkImage image = registryGetImage(registry, texture->pendingImage)->image;
+        const bool streaming = texture->image.id != 0;
+        Result res;
+
+        handle(uploadLevels(
+                manager,
+                texture,
+                image,
+                texture->pendingLevel,
+                streaming ? texture->pendingLevel + 1 : texture->file.levelCount
+        ));
+
+        UploadTicket ticket;
+        handle(uploadFlush(manager->uploads, &ticket));
+
+        const VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+
+        const VkResult resetResult = vkResetCommandBuffer(texture->commandBuffer, 0);
+        if (resetResult != VK_SUCCESS)
+                return RESULT_ERROR(resetResult, "failed to reset texture command buffer!");
+
+        const VkResult beginResult = vkBeginCommandBuffer(texture->commandBuffer, &beginInfo);
+        if (beginResult != VK_SUCCESS)
+                return RESULT_ERROR(beginResult, "failed to begin texture command buffer!");
+
+        if (streaming)
+                recordStreamBuild(texture, registryGetImage(registry, texture->image)->image, image);
+        else
+                recordInitialBuild(texture, image);
+
+        const VkResult endResult = vkEndCommandBuffer(texture->commandBuffer);
+        if (endResult != VK_SUCCESS)
+                return RESULT_ERROR(endResult, "failed to record texture command buffer!");
+
+        const uint64_t value = manager->timelineValue + 1;
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .waitSemaphoreValueCount = 1,
+                .pWaitSemaphoreValues = &ticket,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &value,
+        };
+
+        const VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &manager->uploads->timeline,
+                .pWaitDstStageMask = &waitStage,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &texture->commandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &manager->timeline,
+        };
+
+        const VkResult submitResult = vkQueueSubmit(manager->queue, 1, &submitInfo, VK_NULL_HANDLE);
+        if (submitResult != VK_SUCCESS)
+                return RESULT_ERROR(submitResult, "failed to submit texture build!");
+
+        manager->timelineValue = value;
+        texture->pendingValue = value;
+        return RESULT_SUCCESS;
+}
+
+// A failed build drops the pending image, so the texture keeps the levels
+// it has and the next attempt starts clean. Copies into the image may
+// still be queued or running on the upload queue; they drain first.
+static const Result buildPendingImage(TextureManager *manager, Texture *texture, uint64_t frameNumber)
+{
+        const Result res = submitPendingImage(manager, texture);
+        if (res.code == 0)
+                return res;
+
+        UploadTicket ticket;
+        if (uploadFlush(manager->uploads, &ticket).code == 0)
+                uploadWait(manager->uploads, ticket);
+
+        registryReleaseImage(manager->registry, texture->pendingImage, frameNumber);
+        manager->residentBytes -= texture->pendingBytes;
+        texture->pendingImage = (ImageHandle) {0};
+        texture->pendingBytes = 0;
+        return res;
+}
+
+static const Result pushTexture(TextureManager *manager, Texture **pTexture)
+{
+        if (manager->textureCount == manager->textureCapacity) {
+                const uint32_t capacity = manager->textureCapacity
+                        ? manager->textureCapacity * 2
+                        : 8;
+
+                Texture *textures = realloc(manager->textures, sizeof(Texture) * capacity);
+                if (!textures)
+                        return RESULT_ERROR(-1, "failed to grow texture list!");
+
+                manager->textures = textures;
+                manager->textureCapacity = capacity;
+        }
+
+        *pTexture = &manager->textures[manager->textureCount];
+        memset(*pTexture, 0, sizeof(Texture));
+        return RESULT_SUCCESS;
+}
+
+const Result textureManagerLoad(TextureManager *manager, const char *path, uint32_t *pIndex)
+{
+        Texture *texture;
+        Result res;
+        handle(pushTexture(manager, &texture));
+        handle(textureFileLoad(&texture->file, path));
+
+        // Counted from here so destroy unmaps it whatever fails next
+        *pIndex = manager->textureCount++;
+        const TextureFile *file = &texture->file;
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(manager->physicalDevice, file->format, &formatProperties);
+        const VkFormatFeatureFlags features = formatProperties.optimalTilingFeatures;
+        if (!(features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+                return RESULT_ERROR(-1, "texture format cannot be sampled!");
+
+        // Block-compressed formats cannot be blitted to, so they get the
+        // levels in the file and no more
+        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT
+                | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+        texture->chainLevels = (features & blitFeatures) == blitFeatures
+                ? fullChainLevels(file->width, file->height)
+                : file->levelCount;
+
+        if (texture->chainLevels > TEXTURE_MAX_LEVELS)
+                return RESULT_ERROR(-1, "texture too large!");
+
+        const bool anisotropic = manager->maxAnisotropy > 0.0f;
+        const VkSamplerCreateInfo samplerInfo = {
+                .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                .magFilter = VK_FILTER_LINEAR,
+                .minFilter = VK_FILTER_LINEAR,
+                .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                .anisotropyEnable = anisotropic,
+                .maxAnisotropy = anisotropic ? manager->maxAnisotropy : 1.0f,
+                .minLod = 0.0f,
+                .maxLod = VK_LOD_CLAMP_NONE,
+                .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+        };
+
+        handle(samplerCacheGet(&manager->samplers, &samplerInfo, &texture->sampler));
+
+        const VkCommandBufferAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = manager->commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1,
+        };
+
+        const VkResult result = vkAllocateCommandBuffers(
+                manager->device,
+                &allocInfo,
+                &texture->commandBuffer
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate texture command buffer!");
+
+        // Coarsest file level at most INITIAL_EXTENT across
+        uint32_t first = 0;
+        while (first + 1 < file->levelCount
+                && (levelExtent(file->width, first) > INITIAL_EXTENT
+                        || levelExtent(file->height, first) > INITIAL_EXTENT)
+        ) {
+                first++;
+        }
+
+        // Nothing has drawn with the texture yet
+        handle(createLevelImage(manager, texture, first));
+        return buildPendingImage(manager, texture, 0);
+}
+
+const Result textureManagerUpdate(TextureManager *manager, uint64_t frameNumber)
+{
+        uint64_t completed = 0;
+        vkGetSemaphoreCounterValue(manager->device, manager->timeline, &completed);
+
+        Texture *next = NULL;
+        uint32_t nextExtent = UINT32_MAX;
+        for (uint32_t i = 0; i < manager->textureCount; i++) {
+                Texture *texture = &manager->textures[i];
+                if (texture->pendingValue != 0 && texture->pendingValue <= completed) {
+                        if (texture->image.id != 0) {
+                                registryReleaseImage(manager->registry, texture->image, frameNumber);
+                                manager->residentBytes -= texture->imageBytes;
+                                manager->levelsStreamed++;
+                        }
+
+                        texture->image = texture->pendingImage;
+                        texture->imageBytes = texture->pendingBytes;
+                        texture->residentLevel = texture->pendingLevel;
+                        texture->pendingImage = (ImageHandle) {0};
+                        texture->pendingValue = 0;
+                        manager->generation++;
+
+                        if (texture->residentLevel == 0)
+                                textureFileUnmap(&texture->file);
+                }
+
+                if (texture->pendingValue != 0 || texture->image.id == 0 || texture->residentLevel == 0)
+                        continue;
+
+                const uint32_t width = levelExtent(texture->file.width, texture->residentLevel);
+                const uint32_t height = levelExtent(texture->file.height, texture->residentLevel);
+                const uint32_t extent = width > height ? width : height;
+                if (extent < nextExtent) {
+                        next = texture;
+                        nextExtent = extent;
+                }
+        }
+
+        // One level a frame keeps the upload and copy cost per frame small
+        if (!next)
+                return RESULT_SUCCESS;
+
+        if (manager->residentBytes + chainBytes(next, next->residentLevel - 1) > manager->budget)
+                return RESULT_SUCCESS;
+
+        Result res;
+        handle(createLevelImage(manager, next, next->residentLevel - 1));
+        return buildPendingImage(manager, next, frameNumber);
+}
+
+VkImageView textureManagerView(const TextureManager *manager, uint32_t index)
+{
+        const RegistryImage *image = registryGetImage(manager->registry, manager->textures[index].image);
+        return image ? image->view : VK_NULL_HANDLE;
+}
+
+VkSampler textureManagerSampler(const TextureManager *manager, uint32_t index)
+{
+        return manager->textures[index].sampler;
+}
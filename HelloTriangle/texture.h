@@ -0,0 +1,131 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "registry.h"
+#include "result.h"
+#include "sampler_cache.h"
+#include "upload.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+#define TEXTURE_MAX_LEVELS 16
+
+#define TEXTURE_RAW_MAGIC 0x58455452 // "RTEX" little-endian
+#define TEXTURE_RAW_VERSION 1
+#define TEXTURE_RAW_ALIGNMENT 16
+
+// On-disk header of the raw format, little-endian. The levels follow from
+// the largest down, each at a TEXTURE_RAW_ALIGNMENT aligned offset and
+// tightly packed in whole blocks, so they go straight into staging memory.
+typedef struct textureRawHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t format; // VkFormat
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+} TextureRawHeader;
+
+typedef struct textureLevel {
+        uint64_t offset; // into the mapping
+        uint64_t size;
+} TextureLevel;
+
+// A 2D image with its mip levels, from a KTX2 (no supercompression) or raw
+// file. Level 0 is the full size.
+typedef struct textureFile {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        TextureLevel levels[TEXTURE_MAX_LEVELS];
+        uint32_t blockSize; // block width and height in texels
+        uint32_t blockBytes;
+        void *mapping;
+        size_t mappingSize;
+} TextureFile;
+
+// Maps the file and points the levels into it; nothing is copied
+const Result textureFileLoad(TextureFile *file, const char *path);
+// Drops the level data once uploaded, the format and extent stay valid
+void textureFileUnmap(TextureFile *file);
+
+typedef struct texture {
+        TextureFile file;
+        uint32_t chainLevels; // full mip chain, beyond the file's when generated
+        uint32_t residentLevel; // finest level on the GPU
+        ImageHandle image; // levels residentLevel to chainLevels - 1
+        VkDeviceSize imageBytes;
+        VkSampler sampler; // owned by the sampler cache
+        VkCommandBuffer commandBuffer;
+
+        // The next image, one level finer, while it is being built
+        ImageHandle pendingImage;
+        uint32_t pendingLevel;
+        VkDeviceSize pendingBytes;
+        uint64_t pendingValue; // manager timeline value, 0 when not building
+} Texture;
+
+// Loads textures at a coarse level first and streams finer levels in over
+// the following frames while the estimated device memory stays within the
+// budget. Level data goes through the upload manager; copies between
+// images and blits for missing mip levels run on the graphics queue, which
+// the images are shared with when uploads use another family. Every build
+// produces a new image so frames in flight keep sampling the old one until
+// the registry retires it.
+typedef struct textureManager {
+        VkDevice device;
+        VkPhysicalDevice physicalDevice;
+        Registry *registry;
+        UploadManager *uploads;
+        SamplerCache samplers;
+        float maxAnisotropy; // 0 disables anisotropic filtering
+        VkQueue queue;
+        uint32_t queueFamilies[2];
+        uint32_t queueFamilyCount; // 2 when uploads use another family
+        VkCommandPool commandPool;
+        VkSemaphore timeline; // reaches each build's value once it completes
+        uint64_t timelineValue; // last value submitted
+
+        Texture *textures;
+        uint32_t textureCount;
+        uint32_t textureCapacity;
+
+        VkDeviceSize budget;
+        VkDeviceSize residentBytes; // every live image, pending ones included
+        uint64_t uploadedBytes;
+        uint32_t levelsStreamed;
+        uint32_t generation; // bumped whenever a texture's image changes
+} TextureManager;
+
+const Result textureManagerCreate(
+        TextureManager *manager,
+        VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        Registry *registry,
+        UploadManager *uploads,
+        uint32_t queueFamily,
+        VkQueue queue,
+        float maxAnisotropy,
+        VkDeviceSize budget
+);
+
+// Call once the queue is idle. Images go back to the registry.
+void textureManagerDestroy(TextureManager *manager);
+
+// Maps the file and starts building its coarsest levels; the texture can
+// be drawn with as soon as textureManagerView returns a view for it
+const Result textureManagerLoad(TextureManager *manager, const char *path, uint32_t *pIndex);
+
+// Swaps in finished builds, releasing the images they replace after
+// frameNumber, and starts streaming the next finer level of the coarsest
+// texture that fits the budget. Call once per frame.
+const Result textureManagerUpdate(TextureManager *manager, uint64_t frameNumber);
+
+// VK_NULL_HANDLE until the first build of the texture completes
+VkImageView textureManagerView(const TextureManager *manager, uint32_t index);
+VkSampler textureManagerSampler(const TextureManager *manager, uint32_t index);
+
+#endif
@@ -0,0 +1,624 @@
+#include "transform.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define TRANSFORM_X86 1
+#include <immintrin.h>
+#endif
+
+#define TRANSFORM_FIELD_COUNT 12
+
+static const char *const KERNEL_NAMES[] = {
+        [TRANSFORM_KERNEL_SCALAR] = "scalar",
+        [TRANSFORM_KERNEL_SSE2] = "sse2",
+        [TRANSFORM_KERNEL_AVX2] = "avx2",
+};
+
+// Bench value names are stored, not copied
+static const char *const THROUGHPUT_NAMES[] = {
+        [TRANSFORM_KERNEL_SCALAR] = "scalarObjectsPerMs",
+        [TRANSFORM_KERNEL_SSE2] = "sse2ObjectsPerMs",
+        [TRANSFORM_KERNEL_AVX2] = "avx2ObjectsPerMs",
+};
+
+// Each kernel runs for at least this long
+static const double BENCHMARK_MS = 250.0;
+
+const Result transformBatchCreate(TransformBatch *batch, uint32_t count)
+{
+        memset(batch, 0, sizeof(TransformBatch));
+        batch->count = count;
+        batch->capacity = (count + TRANSFORM_BATCH_WIDTH - 1)
+                / TRANSFORM_BATCH_WIDTH
+                * TRANSFORM_BATCH_WIDTH;
+
+        if (batch->capacity == 0)
+                batch->capacity = TRANSFORM_BATCH_WIDTH;
+
+        // One block, every field starting on a full vector of the widest kernel
+        const size_t fieldBytes = sizeof(float) * batch->capacity;
+        float *fields = aligned_alloc(
+                sizeof(float) * TRANSFORM_BATCH_WIDTH,
+                fieldBytes * TRANSFORM_FIELD_COUNT
+        );
+
+        if (fields == NULL)
+                return RESULT_ERROR(-1, "failed to allocate transform batch!");
+
+        memset(fields, 0, fieldBytes * TRANSFORM_FIELD_COUNT);
+
+        float **const fieldPointers[TRANSFORM_FIELD_COUNT] = {
+                &batch->positionX,
+                &batch->positionY,
+                &batch->positionZ,
+                &batch->rotationX,
+                &batch->rotationY,
+                &batch->rotationZ,
+                &batch->rotationW,
+                &batch->scale,
+                &batch->boundsX,
+                &batch->boundsY,
+                &batch->boundsZ,
+                &batch->boundsRadius,
+        };
+
+        for (uint32_t i = 0; i < TRANSFORM_FIELD_COUNT; i++)
+                *fieldPointers[i] = fields + batch->capacity * i;
+
+        for (uint32_t i = 0; i < batch->capacity; i++) {
+                batch->rotationW[i] = 1.0f;
+                batch->scale[i] = 1.0f;
+                batch->boundsRadius[i] = 1.0f;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+void transformBatchDestroy(TransformBatch *batch)
+{
+        free(batch->positionX);
+        memset(batch, 0, sizeof(TransformBatch));
+}
+
+bool transformKernelSupported(TransformKernel kernel)
+{
+        switch (kernel) {
+        case TRANSFORM_KERNEL_SCALAR:
+                return true;
+#ifdef TRANSFORM_X86
+        case TRANSFORM_KERNEL_SSE2:
+                return true; // part of x86-64
+        case TRANSFORM_KERNEL_AVX2:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+                return false;
+        }
+}
+
+TransformKernel transformKernelBest(void)
+{
+        TransformKernel best = TRANSFORM_KERNEL_SCALAR;
+        for (uint32_t i = 0; i < TRANSFORM_KERNEL_COUNT; i++) {
+                if (transformKernelSupported(i))
+                        best = i;
+        }
+
+        return best;
+}
+
+const char *transformKernelName(TransformKernel kernel)
+{
+        return KERNEL_NAMES[kernel];
+}
+
+static float *matrixAt(void *matrices, size_t matrixStride, uint32_t index)
+{
+        return (float *) ((char *) matrices + matrixStride * index);
+}
+
+// Objects from first to the end of the batch, one at a time. Also the
+// tail of the SIMD kernels.
+static void computeScalar(
+        const TransformBatch *batch,
+        uint32_t first,
+        mat4 parent,
+        void *matrices,
+        size_t matrixStride,
+        vec4 *spheres
+) {
+        for (uint32_t i = first; i < batch->count; i++) {
+                const float x = batch->rotationX[i];
+                const float y = batch->rotationY[i];
+                const float z = batch->rotationZ[i];
+                const float w = batch->rotationW[i];
+                const float s = batch->scale[i];
+                const float s2 = s * 2.0f;
+
+                const float model[4][4] = {
+                        {
+                                s - s2 * (y * y + z * z),
+                                s2 * (x * y + w * z),
+                                s2 * (x * z - w * y),
+                                0.0f,
+                        },
+                        {
+                                s2 * (x * y - w * z),
+                                s - s2 * (x * x + z * z),
+                                s2 * (y * z + w * x),
+                                0.0f,
+                        },
+                        {
+                                s2 * (x * z + w * y),
+                                s2 * (y * z - w * x),
+                                s - s2 * (x * x + y * y),
+                                0.0f,
+                        },
+                        {
+                                batch->positionX[i],
+                                batch->positionY[i],
+                                batch->positionZ[i],
+                                1.0f,
+                        },
+                };
+
+                if (spheres) {
+                        for (uint32_t r = 0; r < 3; r++) {
+                                spheres[i][r] = batch->boundsX[i] * model[0][r]
+                                        + batch->boundsY[i] * model[1][r]
+                                        + batch->boundsZ[i] * model[2][r]
+                                        + model[3][r];
+                        }
+
+                        spheres[i][3] = batch->boundsRadius[i] * fabsf(s);
+                }
+
+                float *out = matrixAt(matrices, matrixStride, i);
+                if (parent == NULL) {
+                        memcpy(out, model, sizeof(model));
+                        continue;
+                }
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        for (uint32_t r = 0; r < 4; r++) {
+                                out[j * 4 + r] = parent[0][r] * model[j][0]
+                                        + parent[1][r] * model[j][1]
+                                        + parent[2][r] * model[j][2]
+                                        + parent[3][r] * model[j][3];
+                        }
+                }
+        }
+}
+
+#ifdef TRANSFORM_X86
+
+// Turns four vectors holding one element of four objects into one vector
+// per object, and stores them at column `column` of each object's matrix
+static void storeColumnsSse2(
+        void *matrices,
+        size_t matrixStride,
+        uint32_t first,
+        uint32_t column,
+        __m128 r0,
+        __m128 r1,
+        __m128 r2,
+        __m128 r3
+) {
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(matrixAt(matrices, matrixStride, first) + column * 4, r0);
+        _mm_storeu_ps(matrixAt(matrices, matrixStride, first + 1) + column * 4, r1);
+        _mm_storeu_ps(matrixAt(matrices, matrixStride, first + 2) + column * 4, r2);
+        _mm_storeu_ps(matrixAt(matrices, matrixStride, first + 3) + column * 4, r3);
+}
+
+// Returns how many objects it covered, a multiple of four
+static uint32_t computeSse2(
+        const TransformBatch *batch,
+        mat4 parent,
+        void *matrices,
+        size_t matrixStride,
+        vec4 *spheres
+) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+
+        __m128 p[4][4];
+        if (parent) {
+                for (uint32_t k = 0; k < 4; k++) {
+                        for (uint32_t r = 0; r < 4; r++)
+                                p[k][r] = _mm_set1_ps(parent[k][r]);
+                }
+        }
+
+        const uint32_t end = batch->count & ~3u;
+        for (uint32_t i = 0; i < end; i += 4) {
+                const __m128 x = _mm_load_ps(batch->rotationX + i);
+                const __m128 y = _mm_load_ps(batch->rotationY + i);
+                const __m128 z = _mm_load_ps(batch->rotationZ + i);
+                const __m128 w = _mm_load_ps(batch->rotationW + i);
+                const __m128 s = _mm_load_ps(batch->scale + i);
+                const __m128 s2 = _mm_mul_ps(s, two);
+
+                const __m128 xx = _mm_mul_ps(x, x);
+                const __m128 yy = _mm_mul_ps(y, y);
+                const __m128 zz = _mm_mul_ps(z, z);
+                const __m128 xy = _mm_mul_ps(x, y);
+                const __m128 xz = _mm_mul_ps(x, z);
+                const __m128 yz = _mm_mul_ps(y, z);
+                const __m128 wx = _mm_mul_ps(w, x);
+                const __m128 wy = _mm_mul_ps(w, y);
+                const __m128 wz = _mm_mul_ps(w, z);
+
+                const __m128 m[4][4] = {
+                        {
+                                _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(yy, zz))),
+                                _mm_mul_ps(s2, _mm_add_ps(xy, wz)),
+                                _mm_mul_ps(s2, _mm_sub_ps(xz, wy)),
+                                zero,
+                        },
+                        {
+                                _mm_mul_ps(s2, _mm_sub_ps(xy, wz)),
+                                _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(xx, zz))),
+                                _mm_mul_ps(s2, _mm_add_ps(yz, wx)),
+                                zero,
+                        },
+                        {
+                                _mm_mul_ps(s2, _mm_add_ps(xz, wy)),
+                                _mm_mul_ps(s2, _mm_sub_ps(yz, wx)),
+                                _mm_sub_ps(s, _mm_mul_ps(s2, _mm_add_ps(xx, yy))),
+                                zero,
+                        },
+                        {
+                                _mm_load_ps(batch->positionX + i),
+                                _mm_load_ps(batch->positionY + i),
+                                _mm_load_ps(batch->positionZ + i),
+                                one,
+                        },
+                };
+
+                if (spheres) {
+                        const __m128 bx = _mm_load_ps(batch->boundsX + i);
+                        const __m128 by = _mm_load_ps(batch->boundsY + i);
+                        const __m128 bz = _mm_load_ps(batch->boundsZ + i);
+
+                        __m128 c[4];
+                        for (uint32_t r = 0; r < 3; r++) {
+                                c[r] = _mm_add_ps(
+                                        _mm_add_ps(_mm_mul_ps(bx, m[0][r]), _mm_mul_ps(by, m[1][r])),
+                                        _mm_add_ps(_mm_mul_ps(bz, m[2][r]), m[3][r])
+                                );
+                        }
+
+                        c[3] = _mm_mul_ps(
+                                _mm_load_ps(batch->boundsRadius + i),
+                                _mm_andnot_ps(signMask, s)
+                        );
+
+                        _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+                        for (uint32_t n = 0; n < 4; n++)
+                                _mm_storeu_ps(spheres[i + n], c[n]);
+                }
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        if (parent == NULL) {
+                                storeColumnsSse2(matrices, matrixStride, i, j, m[j][0], m[j][1], m[j][2], m[j][3]);
+                                continue;
+                        }
+
+                        __m128 o[4];
+                        for (uint32_t r = 0; r < 4; r++) {
+                                o[r] = _mm_add_ps(
+                                        _mm_add_ps(_mm_mul_ps(p[0][r], m[j][0]), _mm_mul_ps(p[1][r], m[j][1])),
+                                        _mm_add_ps(_mm_mul_ps(p[2][r], m[j][2]), _mm_mul_ps(p[3][r], m[j][3]))
+                                );
+                        }
+
+                        storeColumnsSse2(matrices, matrixStride, i, j, o[0], o[1], o[2], o[3]);
+                }
+        }
+
+        return end;
+}
+
+// Eight-object counterpart of storeColumnsSse2; each 128-bit half is
+// transposed on its own
+__attribute__((target("avx2,fma")))
+static void storeColumnsAvx2(
+        void *matrices,
+        size_t matrixStride,
+        uint32_t first,
+        uint32_t column,
+        __m256 r0,
+        __m256 r1,
+        __m256 r2,
+        __m256 r3
+) {
+        const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        const __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+        const __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+        const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+
+        const __m256 objects[4] = {
+                _mm256_shuffle_ps(t0, t1, 0x44),
+                _mm256_shuffle_ps(t0, t1, 0xee),
+                _mm256_shuffle_ps(t2, t3, 0x44),
+                _mm256_shuffle_ps(t2, t3, 0xee),
+        };
+
+        for (uint32_t n = 0; n < 4; n++) {
+                _mm_storeu_ps(
+                        matrixAt(matrices, matrixStride, first + n) + column * 4,
+                        _mm256_castps256_ps128(objects[n])
+                );
+                _mm_storeu_ps(
+                        matrixAt(matrices, matrixStride, first + n + 4) + column * 4,
+                        _mm256_extractf128_ps(objects[n], 1)
+                );
+        }
+}
+
+// Returns how many objects it covered, a multiple of eight
+__attribute__((target("avx2,fma")))
+static uint32_t computeAvx2(
+        const TransformBatch *batch,
+        mat4 parent,
+        void *matrices,
+        size_t matrixStride,
+        vec4 *spheres
+) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+        __m256 p[4][4];
+        if (parent) {
+                for (uint32_t k = 0; k < 4; k++) {
+                        for (uint32_t r = 0; r < 4; r++)
+                                p[k][r] = _mm256_set1_ps(parent[k][r]);
+                }
+        }
+
+        const uint32_t end = batch->count & ~7u;
+        for (uint32_t i = 0; i < end; i += 8) {
+                const __m256 x = _mm256_load_ps(batch->rotationX + i);
+                const __m256 y = _mm256_load_ps(batch->rotationY + i);
+                const __m256 z = _mm256_load_ps(batch->rotationZ + i);
+                const __m256 w = _mm256_load_ps(batch->rotationW + i);
+                const __m256 s = _mm256_load_ps(batch->scale + i);
+                const __m256 s2 = _mm256_mul_ps(s, two);
+
+                const __m256 xx = _mm256_mul_ps(x, x);
+                const __m256 yy = _mm256_mul_ps(y, y);
+                const __m256 zz = _mm256_mul_ps(z, z);
+                const __m256 xy = _mm256_mul_ps(x, y);
+                const __m256 xz = _mm256_mul_ps(x, z);
+                const __m256 yz = _mm256_mul_ps(y, z);
+                const __m256 wx = _mm256_mul_ps(w, x);
+                const __m256 wy = _mm256_mul_ps(w, y);
+                const __m256 wz = _mm256_mul_ps(w, z);
+
+                const __m256 m[4][4] = {
+                        {
+                                _mm256_fnmadd_ps(s2, _mm256_add_ps(yy, zz), s),
+                                _mm256_mul_ps(s2, _mm256_add_ps(xy, wz)),
+                                _mm256_mul_ps(s2, _mm256_sub_ps(xz, wy)),
+                                zero,
+                        },
+                        {
+                                _mm256_mul_ps(s2, _mm256_sub_ps(xy, wz)),
+                                _mm256_fnmadd_ps(s2, _mm256_add_ps(xx, zz), s),
+                                _mm256_mul_ps(s2, _mm256_add_ps(yz, wx)),
+                                zero,
+                        },
+                        {
+                                _mm256_mul_ps(s2, _mm256_add_ps(xz, wy)),
+                                _mm256_mul_ps(s2, _mm256_sub_ps(yz, wx)),
+                                _mm256_fnmadd_ps(s2, _mm256_add_ps(xx, yy), s),
+                                zero,
+                        },
+                        {
+                                _mm256_load_ps(batch->positionX + i),
+                                _mm256_load_ps(batch->positionY + i),
+                                _mm256_load_ps(batch->positionZ + i),
+                                one,
+                        },
+                };
+
+                if (spheres) {
+                        const __m256 bx = _mm256_load_ps(batch->boundsX + i);
+                        const __m256 by = _mm256_load_ps(batch->boundsY + i);
+                        const __m256 bz = _mm256_load_ps(batch->boundsZ + i);
+
+                        __m256 c[4];
+                        for (uint32_t r = 0; r < 3; r++) {
+                                c[r] = _mm256_fmadd_ps(
+                                        bx,
+                                        m[0][r],
+                                        _mm256_fmadd_ps(by, m[1][r], _mm256_fmadd_ps(bz, m[2][r], m[3][r]))
+                                );
+                        }
+
+                        c[3] = _mm256_mul_ps(
+                                _mm256_load_ps(batch->boundsRadius + i),
+                                _mm256_andnot_ps(signMask, s)
+                        );
+
+                        // Spheres are a vec4 array, so a stride of one vec4
+                        storeColumnsAvx2(spheres[i], sizeof(vec4), 0, 0, c[0], c[1], c[2], c[3]);
+                }
+
+                for (uint32_t j = 0; j < 4; j++) {
+                        if (parent == NULL) {
+                                storeColumnsAvx2(matrices, matrixStride, i, j, m[j][0], m[j][1], m[j][2], m[j][3]);
+                                continue;
+                        }
+
+                        __m256 o[4];
+                        for (uint32_t r = 0; r < 4; r++) {
+                                o[r] = _mm256_fmadd_ps(
+                                        p[0][r],
+                                        m[j][0],
+                                        _mm256_fmadd_ps(
+                                                p[1][r],
+                                                m[j][1],
+                                                _mm256_fmadd_ps(p[2][r], m[j][2], _mm256_mul_ps(p[3][r], m[j][3]))
+                                        )
+                                );
+                        }
+
+                        storeColumnsAvx2(matrices, matrixStride, i, j, o[0], o[1], o[2], o[3]);
+                }
+        }
+
+        return end;
+}
+
+#endif
+
+void transformBatchCompute(
+        const TransformBatch *batch,
+        TransformKernel kernel,
+        mat4 parent,
+        void *matrices,
+        size_t matrixStride,
+        vec4 *spheres
+) {
+        uint32_t done = 0;
+#ifdef TRANSFORM_X86
+        if (kernel == TRANSFORM_KERNEL_AVX2)
+                done = computeAvx2(batch, parent, matrices, matrixStride, spheres);
+        else if (kernel == TRANSFORM_KERNEL_SSE2)
+                done = computeSse2(batch, parent, matrices, matrixStride, spheres);
+#endif
+
+        computeScalar(batch, done, parent, matrices, matrixStride, spheres);
+}
+
+static float maxDifference(const float *a, const float *b, size_t count)
+{
+        float difference = 0.0f;
+        for (size_t i = 0; i < count; i++)
+                difference = fmaxf(difference, fabsf(a[i] - b[i]));
+
+        return difference;
+}
+
+static void benchmarkKernels(
+        Bench *bench,
+        const TransformBatch *batch,
+        mat4 parent,
+        size_t matrixStride,
+        char *reference,
+        char *matrices,
+        vec4 *referenceSpheres,
+        vec4 *spheres
+) {
+        const uint32_t objectCount = batch->count;
+        memset(reference, 0, matrixStride * objectCount);
+        memset(matrices, 0, matrixStride * objectCount);
+        transformBatchCompute(batch, TRANSFORM_KERNEL_SCALAR, parent, reference, matrixStride, referenceSpheres);
+
+        float maxError = 0.0f;
+        for (uint32_t kernel = 0; kernel < TRANSFORM_KERNEL_COUNT; kernel++) {
+                if (!transformKernelSupported(kernel))
+                        continue;
+
+                transformBatchCompute(batch, kernel, parent, matrices, matrixStride, spheres);
+                for (uint32_t i = 0; i < objectCount; i++) {
+                        maxError = fmaxf(maxError, maxDifference(
+                                (const float *) (reference + matrixStride * i),
+                                (const float *) (matrices + matrixStride * i),
+                                16
+                        ));
+                }
+
+                maxError = fmaxf(maxError, maxDifference(
+                        (const float *) referenceSpheres,
+                        (const float *) spheres,
+                        4 * (size_t) objectCount
+                ));
+
+                uint64_t objects = 0;
+                const double start = benchNowMs();
+                double elapsed;
+                do {
+                        transformBatchCompute(batch, kernel, parent, matrices, matrixStride, spheres);
+                        objects += objectCount;
+                        elapsed = benchNowMs() - start;
+                } while (elapsed < BENCHMARK_MS);
+
+                benchSetValue(bench, THROUGHPUT_NAMES[kernel], objects / elapsed);
+        }
+
+        benchSetLabel(bench, "transformKernel", transformKernelName(transformKernelBest()));
+        benchSetValue(bench, "transformObjects", objectCount);
+        benchSetValue(bench, "transformMaxError", maxError);
+}
+
+const Result transformBenchmark(Bench *bench, uint32_t objectCount, size_t matrixStride)
+{
+        if (objectCount == 0 || matrixStride < sizeof(mat4))
+                return RESULT_ERROR(-1, "transform benchmark needs objects and room for a mat4!");
+
+        TransformBatch batch;
+        Result res = transformBatchCreate(&batch, objectCount);
+        if (res.code != 0)
+                return res;
+
+        // Arbitrary but varied, so nothing is skipped or constant-folded
+        for (uint32_t i = 0; i < objectCount; i++) {
+                const float angle = 0.001f * i;
+                const float axis = sqrtf(1.0f / 3.0f);
+                const float sine = sinf(angle * 0.5f);
+
+                batch.positionX[i] = (float) (i % 1024);
+                batch.positionY[i] = (float) (i / 1024);
+                batch.positionZ[i] = -0.5f * (i % 7);
+                batch.rotationX[i] = axis * sine;
+                batch.rotationY[i] = axis * sine;
+                batch.rotationZ[i] = axis * sine;
+                batch.rotationW[i] = cosf(angle * 0.5f);
+                batch.scale[i] = 0.5f + 0.001f * (i % 100);
+                batch.boundsX[i] = 0.25f;
+                batch.boundsRadius[i] = 0.75f;
+        }
+
+        mat4 parent;
+        for (uint32_t k = 0; k < 4; k++) {
+                for (uint32_t r = 0; r < 4; r++)
+                        parent[k][r] = (k == r ? 1.5f : 0.0f) + 0.125f * k - 0.0625f * r;
+        }
+
+        char *reference = malloc(matrixStride * objectCount);
+        char *matrices = malloc(matrixStride * objectCount);
+        vec4 *referenceSpheres = malloc(sizeof(vec4) * objectCount);
+        vec4 *spheres = malloc(sizeof(vec4) * objectCount);
+        if (reference && matrices && referenceSpheres && spheres) {
+                benchmarkKernels(
+                        bench,
+                        &batch,
+                        parent,
+                        matrixStride,
+                        reference,
+                        matrices,
+                        referenceSpheres,
+                        spheres
+                );
+        } else {
+                res = RESULT_ERROR(-1, "failed to allocate transform benchmark output!");
+        }
+
+        free(reference);
+        free(matrices);
+        free(referenceSpheres);
+        free(spheres);
+        transformBatchDestroy(&batch);
+        return res;
+}
@@ -0,0 +1,70 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "bench.h"
+#include "result.h"
+#include <cglm/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Widest kernel's object count; capacity is rounded up to a multiple of it
+#define TRANSFORM_BATCH_WIDTH 8
+
+typedef enum transformKernel {
+        TRANSFORM_KERNEL_SCALAR,
+        TRANSFORM_KERNEL_SSE2,
+        TRANSFORM_KERNEL_AVX2, // with FMA
+        TRANSFORM_KERNEL_COUNT,
+} TransformKernel;
+
+// Object transforms in structure-of-arrays form, so the SIMD kernels load
+// one field of several objects per instruction. Rotation is a unit
+// quaternion and scale is uniform, so bounding spheres stay spheres.
+typedef struct transformBatch {
+        uint32_t count;
+        uint32_t capacity;
+        float *positionX;
+        float *positionY;
+        float *positionZ;
+        float *rotationX;
+        float *rotationY;
+        float *rotationZ;
+        float *rotationW;
+        float *scale;
+        float *boundsX; // local bounding sphere centre
+        float *boundsY;
+        float *boundsZ;
+        float *boundsRadius;
+} TransformBatch;
+
+// Every object starts at the origin, unrotated, at unit scale, with a unit
+// bounding sphere around its origin
+const Result transformBatchCreate(TransformBatch *batch, uint32_t count);
+void transformBatchDestroy(TransformBatch *batch);
+
+bool transformKernelSupported(TransformKernel kernel);
+// The widest kernel this CPU runs
+TransformKernel transformKernelBest(void);
+const char *transformKernelName(TransformKernel kernel);
+
+// Writes parent * translate * rotate * scale for object i to the mat4 at
+// matrices + i * matrixStride bytes, so it can go straight into a mapped
+// instance buffer. parent may be NULL for model matrices alone. spheres,
+// when not NULL, receives each bounding sphere (centre, radius) in the
+// space the parent is applied to. kernel must pass transformKernelSupported;
+// resolve it once, e.g. with transformKernelBest, outside the hot loop.
+void transformBatchCompute(
+        const TransformBatch *batch,
+        TransformKernel kernel,
+        mat4 parent,
+        void *matrices,
+        size_t matrixStride,
+        vec4 *spheres
+);
+
+// Runs every supported kernel over objectCount objects and reports objects
+// per millisecond for each, plus the largest difference from scalar
+const Result transformBenchmark(Bench *bench, uint32_t objectCount, size_t matrixStride);
+
+#endif
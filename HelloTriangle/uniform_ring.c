@@ -0,0 +1,80 @@
+#include "uniform_ring.h"
+
+#include <string.h>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+        return (value + alignment - 1) & ~(alignment - 1);
+}
+
+const Result uniformRingCreate(
+        UniformRing *ring,
+        VkDevice device,
+        Allocator *allocator,
+        const VkPhysicalDeviceLimits *limits,
+        VkDeviceSize regionSize,
+        uint32_t regionCount
+) {
+        memset(ring, 0, sizeof(UniformRing));
+
+        // Both limits are powers of two, so the larger satisfies both
+        ring->alignment = limits->minUniformBufferOffsetAlignment;
+        if (limits->minStorageBufferOffsetAlignment > ring->alignment)
+                ring->alignment = limits->minStorageBufferOffsetAlignment;
+
+        ring->regionSize = alignUp(regionSize, ring->alignment);
+        ring->regionCount = regionCount;
+
+        // Dynamic offsets are 32-bit
+        const VkDeviceSize bufferSize = ring->regionSize * regionCount;
+        if (bufferSize > UINT32_MAX)
+                return RESULT_ERROR(-1, "uniform ring too large for dynamic offsets!");
+
+        const VkBufferCreateInfo bufferInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = bufferSize,
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+                        | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        const VkResult result = vkCreateBuffer(device, &bufferInfo, NULL, &ring->buffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create uniform ring buffer!");
+
+        // Coherent, so writes need no flush before the submit that reads them
+        return allocatorAllocateBuffer(
+                allocator,
+                ring->buffer,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &ring->allocation
+        );
+}
+
+void uniformRingDestroy(UniformRing *ring, VkDevice device, Allocator *allocator)
+{
+        vkDestroyBuffer(device, ring->buffer, NULL);
+        allocatorFree(allocator, &ring->allocation);
+        ring->buffer = VK_NULL_HANDLE;
+}
+
+void uniformRingBegin(UniformRing *ring, uint32_t region)
+{
+        ring->regionStart = ring->regionSize * region;
+        ring->offset = 0;
+}
+
+void *uniformRingAllocate(UniformRing *ring, VkDeviceSize size, uint32_t *pOffset)
+{
+        const VkDeviceSize offset = alignUp(ring->offset, ring->alignment);
+        if (offset + size > ring->regionSize)
+                return NULL;
+
+        ring->offset = offset + size;
+        if (ring->offset > ring->peakBytes)
+                ring->peakBytes = ring->offset;
+
+        *pOffset = (uint32_t) (ring->regionStart + offset);
+        return (char *) ring->allocation.mapped + ring->regionStart + offset;
+}
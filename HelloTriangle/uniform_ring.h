@@ -0,0 +1,44 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include "allocator.h"
+#include "result.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+// One persistently mapped, host-coherent buffer split into a region per
+// frame in flight. Each frame bump-allocates from its own region and hands
+// the offsets to the shaders as dynamic descriptor offsets, so per-frame
+// data is a plain memcpy with no descriptor updates or vkMapMemory calls.
+// A region may only be written once the frame that last used it finished.
+typedef struct uniformRing {
+        VkBuffer buffer;
+        Allocation allocation;
+        VkDeviceSize alignment; // satisfies both uniform and storage offsets
+        VkDeviceSize regionSize;
+        uint32_t regionCount;
+        VkDeviceSize regionStart; // of the region being written
+        VkDeviceSize offset; // bump pointer within that region
+        VkDeviceSize peakBytes; // most any frame has used
+} UniformRing;
+
+const Result uniformRingCreate(
+        UniformRing *ring,
+        VkDevice device,
+        Allocator *allocator,
+        const VkPhysicalDeviceLimits *limits,
+        VkDeviceSize regionSize,
+        uint32_t regionCount
+);
+void uniformRingDestroy(UniformRing *ring, VkDevice device, Allocator *allocator);
+
+// Starts writing the given region from its beginning
+void uniformRingBegin(UniformRing *ring, uint32_t region);
+
+// Returns mapped memory for size bytes and the offset to bind it at, or
+// NULL when the region is full. Allocations in the same order each frame
+// land at the same offsets within their region.
+void *uniformRingAllocate(UniformRing *ring, VkDeviceSize size, uint32_t *pOffset);
+
+#endif
@@ -0,0 +1,602 @@
+#include "upload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const VkDeviceSize RING_ALIGNMENT = 16;
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+        return (value + alignment - 1) & ~(alignment - 1);
+}
+
+const Result uploadCreate(
+        UploadManager *uploads,
+        VkDevice device,
+        Allocator *allocator,
+        uint32_t queueFamily,
+        VkQueue queue,
+        VkDeviceSize ringSize
+) {
+        memset(uploads, 0, sizeof(UploadManager));
+        uploads->device = device;
+        uploads->queue = queue;
+        uploads->queueFamily = queueFamily;
+        uploads->ringSize = ringSize;
+        uploads->nextTicket = 1;
+
+        const VkCommandPoolCreateInfo poolInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+                        | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                .queueFamilyIndex = queueFamily,
+        };
+
+        VkResult result = vkCreateCommandPool(
+                device,
+                &poolInfo,
+                NULL,
+                &uploads->commandPool
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create upload command pool!");
+
+        VkCommandBuffer commandBuffers[UPLOAD_MAX_SUBMISSIONS];
+        const VkCommandBufferAllocateInfo allocInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool = uploads->commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = UPLOAD_MAX_SUBMISSIONS,
+        };
+
+        result = vkAllocateCommandBuffers(device, &allocInfo, commandBuffers);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to allocate upload command buffers!");
+
+        for (uint32_t i = 0; i < UPLOAD_MAX_SUBMISSIONS; i++)
+                uploads->submissions[i].commandBuffer = commandBuffers[i];
+
+        const VkSemaphoreTypeCreateInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+        };
+
+        const VkSemaphoreCreateInfo semaphoreInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                .pNext = &timelineInfo,
+        };
+
+        result = vkCreateSemaphore(device, &semaphoreInfo, NULL, &uploads->timeline);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create upload timeline semaphore!");
+
+        const VkBufferCreateInfo bufferInfo = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = ringSize,
+                .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        result = vkCreateBuffer(device, &bufferInfo, NULL, &uploads->ringBuffer);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to create upload ring buffer!");
+
+        return allocatorAllocateBuffer(
+                allocator,
+                uploads->ringBuffer,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &uploads->ringAllocation
+        );
+}
+
+static void retireSubmission(UploadManager *uploads)
+{
+        UploadSubmission *submission = &uploads->submissions[uploads->oldestSubmission];
+        submission->pending = false;
+
+        uploads->tail = submission->ringEnd;
+        uploads->completedTicket = submission->ticket;
+        uploads->oldestSubmission =
+                (uploads->oldestSubmission + 1) % UPLOAD_MAX_SUBMISSIONS;
+        uploads->submissionCount--;
+
+        // Nothing in flight or waiting to be flushed, start the ring over
+        if (uploads->submissionCount == 0
+                && uploads->copyCount == 0
+                && uploads->imageCopyCount == 0
+        ) {
+                uploads->head = 0;
+                uploads->tail = 0;
+        }
+}
+
+// A failed query retires nothing, so ring space the GPU may still read is
+// never handed out again
+static const Result pollSubmissions(UploadManager *uploads)
+{
+        if (uploads->submissionCount == 0)
+                return RESULT_SUCCESS;
+
+        uint64_t completed = 0;
+        const VkResult result = vkGetSemaphoreCounterValue(
+                uploads->device,
+                uploads->timeline,
+                &completed
+        );
+
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to query upload timeline!");
+
+        while (uploads->submissionCount > 0
+                && uploads->submissions[uploads->oldestSubmission].ticket <= completed
+        ) {
+                retireSubmission(uploads);
+        }
+
+        return RESULT_SUCCESS;
+}
+
+static const Result waitOldestSubmission(UploadManager *uploads)
+{
+        const UploadSubmission *submission =
+                &uploads->submissions[uploads->oldestSubmission];
+
+        const VkSemaphoreWaitInfo waitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                .semaphoreCount = 1,
+                .pSemaphores = &uploads->timeline,
+                .pValues = &submission->ticket,
+        };
+
+        const VkResult result = vkWaitSemaphores(uploads->device, &waitInfo, UINT64_MAX);
+        if (result != VK_SUCCESS)
+                return RESULT_ERROR(result, "failed to wait for upload batch!");
+
+        retireSubmission(uploads);
+        return RESULT_SUCCESS;
+}
+
+// Space between head and tail, keeping head != tail unless the ring is empty
+static bool reserveRing(UploadManager *uploads, VkDeviceSize size, VkDeviceSize *pOffset)
+{
+        const VkDeviceSize offset = alignUp(uploads->head, RING_ALIGNMENT);
+
+        if (uploads->head >= uploads->tail) {
+                if (offset + size <= uploads->ringSize) {
+                        *pOffset = offset;
+                        return true;
+                }
+
+                if (size < uploads->tail) {
+                        *pOffset = 0;
+                        return true;
+                }
+
+                return false;
+        }
+
+        if (offset + size < uploads->tail) {
+                *pOffset = offset;
+                return true;
+        }
+
+        return false;
+}
+
+static const Result pushCopy(UploadManager *uploads, UploadCopy copy)
+{
+        if (uploads->copyCount == uploads->copyCapacity) {
+                const uint32_t capacity = uploads->copyCapacity
+                        ? uploads->copyCapacity * 2
+                        : 64;
+
+                UploadCopy *copies = realloc(uploads->copies, sizeof(UploadCopy) * capacity);
+                if (!copies)
+                        return RESULT_ERROR(-1, "failed to grow upload copy list!");
+
+                uploads->copies = copies;
+                uploads->copyCapacity = capacity;
+        }
+
+        uploads->copies[uploads->copyCount++] = copy;
+        return RESULT_SUCCESS;
+}
+
+static const Result pushImageCopy(UploadManager *uploads, UploadImageCopy copy)
+{
+        if (uploads->imageCopyCount == uploads->imageCopyCapacity) {
+                const uint32_t capacity = uploads->imageCopyCapacity
+                        ? uploads->imageCopyCapacity * 2
+                        : 16;
+
+                UploadImageCopy *copies = realloc(
+                        uploads->imageCopies,
+                        sizeof(UploadImageCopy) * capacity
+                );
+
+                if (!copies)
+                        return RESULT_ERROR(-1, "failed to grow upload image copy list!");
+
+                uploads->imageCopies = copies;
+                uploads->imageCopyCapacity = capacity;
+        }
+
+        uploads->imageCopies[uploads->imageCopyCount++] = copy;
+        return RESULT_SUCCESS;
+}
+
+// Ring space for size bytes, flushing and then waiting on older batches
+// until there is some
+static const Result acquireRing(UploadManager *uploads, VkDeviceSize size, VkDeviceSize *pOffset)
+{
+        Result res;
+        handle(pollSubmissions(uploads));
+
+        while (!reserveRing(uploads, size, pOffset)) {
+                if (uploads->submissionCount == 0) {
+                        UploadTicket ticket;
+                        handle(uploadFlush(uploads, &ticket));
+                }
+
+                handle(waitOldestSubmission(uploads));
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const Result uploadBuffer(
+        UploadManager *uploads,
+        VkBuffer dstBuffer,
+        VkDeviceSize dstOffset,
+        const void *data,
+        VkDeviceSize size
+) {
+        // Anything bigger than a quarter of the ring goes through in pieces
+        const VkDeviceSize maxChunk = uploads->ringSize / 4;
+        Result res;
+
+        VkDeviceSize done = 0;
+        while (done < size) {
+                const VkDeviceSize chunk = size - done < maxChunk ? size - done : maxChunk;
+
+                VkDeviceSize offset;
+                handle(acquireRing(uploads, chunk, &offset));
+
+                memcpy(
+                        (char *) uploads->ringAllocation.mapped + offset,
+                        (const char *) data + done,
+                        (size_t) chunk
+                );
+
+                handle(pushCopy(uploads, (UploadCopy) {
+                        .dstBuffer = dstBuffer,
+                        .region = {
+                                .srcOffset = offset,
+                                .dstOffset = dstOffset + done,
+                                .size = chunk,
+                        },
+                }));
+
+                uploads->head = offset + chunk;
+                done += chunk;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+const Result uploadImage(
+        UploadManager *uploads,
+        VkImage dstImage,
+        uint32_t mipLevel,
+        VkExtent2D extent,
+        uint32_t blockSize,
+        uint32_t blockBytes,
+        const void *data
+) {
+        const uint32_t blocksWide = (extent.width + blockSize - 1) / blockSize;
+        const uint32_t blocksHigh = (extent.height + blockSize - 1) / blockSize;
+        const VkDeviceSize rowBytes = (VkDeviceSize) blocksWide * blockBytes;
+
+        const VkDeviceSize maxChunk = uploads->ringSize / 4;
+        if (rowBytes > maxChunk)
+                return RESULT_ERROR(-1, "image rows too wide for the upload ring!");
+
+        // Bands start on multiples of 64 texel rows, which covers the image
+        // transfer granularity dedicated transfer queues tend to report
+        const uint32_t bandAlignment = blockSize < 64 ? 64 / blockSize : 1;
+        uint32_t rowsPerBand = (uint32_t) (maxChunk / rowBytes);
+        if (rowsPerBand > bandAlignment)
+                rowsPerBand -= rowsPerBand % bandAlignment;
+
+        Result res;
+
+        for (uint32_t row = 0; row < blocksHigh; row += rowsPerBand) {
+                const uint32_t rows = blocksHigh - row < rowsPerBand ? blocksHigh - row : rowsPerBand;
+                const VkDeviceSize chunk = rowBytes * rows;
+
+                VkDeviceSize offset;
+                handle(acquireRing(uploads, chunk, &offset));
+
+                memcpy(
+                        (char *) uploads->ringAllocation.mapped + offset,
+                        (const char *) data + rowBytes * row,
+                        (size_t) chunk
+                );
+
+                // The last band of a level may end short of a whole block
+                const uint32_t top = row * blockSize;
+                const uint32_t bottom = (row + rows) * blockSize;
+                handle(pushImageCopy(uploads, (UploadImageCopy) {
+                        .dstImage = dstImage,
+                        .region = {
+                                .bufferOffset = offset,
+                                .bufferRowLength = 0, // tightly packed
+                                .bufferImageHeight = 0,
+                                .imageSubresource = {
+                                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                        .mipLevel = mipLevel,
+                                        .baseArrayLayer = 0,
+                                        .layerCount = 1,
+                                },
+                                .imageOffset = { .x = 0, .y = (int32_t) top, .z = 0 },
+                                .imageExtent = {
+                                        .width = extent.width,
+                                        .height = (bottom < extent.height ? bottom : extent.height) - top,
+                                        .depth = 1,
+                                },
+                        },
+                        .transition = row == 0,
+                }));
+
+                uploads->head = offset + chunk;
+        }
+
+        return RESULT_SUCCESS;
+}
+
+// Levels arriving in this batch leave UNDEFINED before any copy runs
+static void recordImageTransitions(UploadManager *uploads, VkCommandBuffer commandBuffer)
+{
+        VkImageMemoryBarrier barriers[uploads->imageCopyCount];
+        uint32_t barrierCount = 0;
+        for (uint32_t i = 0; i < uploads->imageCopyCount; i++) {
+                const UploadImageCopy *copy = &uploads->imageCopies[i];
+                if (!copy->transition)
+                        continue;
+
+                barriers[barrierCount++] = (VkImageMemoryBarrier) {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                        .srcAccessMask = 0,
+                        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = copy->dstImage,
+                        .subresourceRange = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .baseMipLevel = copy->region.imageSubresource.mipLevel,
+                                .levelCount = 1,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                        },
+                };
+        }
+
+        if (barrierCount == 0)
+                return;
+
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0, NULL,
+                0, NULL,
+                barrierCount, barriers
+        );
+}
+
+static int compareImageCopies(const void *a, const void *b)
+{
+        const UploadImageCopy *x = a;
+        const UploadImageCopy *y = b;
+        if (x->dstImage != y->dstImage)
+                return x->dstImage < y->dstImage ? -1 : 1;
+
+        return (x->region.bufferOffset > y->region.bufferOffset)
+                - (x->region.bufferOffset < y->region.bufferOffset);
+}
+
+static int compareCopies(const void *a, const void *b)
+{
+        const UploadCopy *x = a;
+        const UploadCopy *y = b;
+        if (x->dstBuffer != y->dstBuffer)
+                return x->dstBuffer < y->dstBuffer ? -1 : 1;
+
+        return (x->region.srcOffset > y->region.srcOffset)
+                - (x->region.srcOffset < y->region.srcOffset);
+}
+
+// One vkCmdCopyBuffer per destination with all of its regions
+static void recordBufferCopies(UploadManager *uploads, VkCommandBuffer commandBuffer)
+{
+        if (uploads->copyCount == 0)
+                return;
+
+        qsort(uploads->copies, uploads->copyCount, sizeof(UploadCopy), compareCopies);
+
+        VkBufferCopy regions[uploads->copyCount];
+        uint32_t first = 0;
+        while (first < uploads->copyCount) {
+                const VkBuffer dstBuffer = uploads->copies[first].dstBuffer;
+                uint32_t regionCount = 0;
+                uint32_t i = first;
+                for (; i < uploads->copyCount && uploads->copies[i].dstBuffer == dstBuffer; i++)
+                        regions[regionCount++] = uploads->copies[i].region;
+
+                vkCmdCopyBuffer(
+                        commandBuffer,
+                        uploads->ringBuffer,
+                        dstBuffer,
+                        regionCount,
+                        regions
+                );
+
+                first = i;
+        }
+}
+
+// Likewise one vkCmdCopyBufferToImage per image
+static void recordImageCopies(UploadManager *uploads, VkCommandBuffer commandBuffer)
+{
+        if (uploads->imageCopyCount == 0)
+                return;
+
+        recordImageTransitions(uploads, commandBuffer);
+        qsort(
+                uploads->imageCopies,
+                uploads->imageCopyCount,
+                sizeof(UploadImageCopy),
+                compareImageCopies
+        );
+
+        VkBufferImageCopy regions[uploads->imageCopyCount];
+        uint32_t first = 0;
+        while (first < uploads->imageCopyCount) {
+                const VkImage dstImage = uploads->imageCopies[first].dstImage;
+                uint32_t regionCount = 0;
+                uint32_t i = first;
+                for (; i < uploads->imageCopyCount && uploads->imageCopies[i].dstImage == dstImage; i++)
+                        regions[regionCount++] = uploads->imageCopies[i].region;
+
+                vkCmdCopyBufferToImage(
+                        commandBuffer,
+                        uploads->ringBuffer,
+                        dstImage,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        regionCount,
+                        regions
+                );
+
+                first = i;
+        }
+}
+
+const Result uploadFlush(UploadManager *uploads, UploadTicket *pTicket)
+{
+        if (uploads->copyCount == 0 && uploads->imageCopyCount == 0) {
+                *pTicket = uploads->nextTicket - 1;
+                return RESULT_SUCCESS;
+        }
+
+        Result res;
+        if (uploads->submissionCount == UPLOAD_MAX_SUBMISSIONS) {
+                handle(waitOldestSubmission(uploads));
+        }
+
+        const uint32_t index =
+                (uploads->oldestSubmission + uploads->submissionCount)
+                % UPLOAD_MAX_SUBMISSIONS;
+
+        UploadSubmission *submission = &uploads->submissions[index];
+
+        const VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+
+        const VkResult resetResult = vkResetCommandBuffer(submission->commandBuffer, 0);
+        if (resetResult != VK_SUCCESS)
+                return RESULT_ERROR(resetResult, "failed to reset upload command buffer!");
+
+        const VkResult beginResult = vkBeginCommandBuffer(submission->commandBuffer, &beginInfo);
+        if (beginResult != VK_SUCCESS)
+                return RESULT_ERROR(beginResult, "failed to begin upload command buffer!");
+
+        recordBufferCopies(uploads, submission->commandBuffer);
+        recordImageCopies(uploads, submission->commandBuffer);
+
+        const VkResult endResult = vkEndCommandBuffer(submission->commandBuffer);
+        if (endResult != VK_SUCCESS)
+                return RESULT_ERROR(endResult, "failed to record upload command buffer!");
+
+        const UploadTicket ticket = uploads->nextTicket;
+        const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &ticket,
+        };
+
+        const VkSubmitInfo submitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = &timelineInfo,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &submission->commandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &uploads->timeline,
+        };
+
+        const VkResult submitResult = vkQueueSubmit(
+                uploads->queue,
+                1,
+                &submitInfo,
+                VK_NULL_HANDLE
+        );
+
+        if (submitResult != VK_SUCCESS)
+                return RESULT_ERROR(submitResult, "failed to submit upload batch!");
+
+        submission->ticket = uploads->nextTicket++;
+        submission->ringEnd = uploads->head;
+        submission->pending = true;
+        uploads->submissionCount++;
+        uploads->copyCount = 0;
+        uploads->imageCopyCount = 0;
+
+        *pTicket = submission->ticket;
+        return RESULT_SUCCESS;
+}
+
+// A failed poll leaves the ticket looking incomplete
+bool uploadIsComplete(UploadManager *uploads, UploadTicket ticket)
+{
+        pollSubmissions(uploads);
+        return ticket <= uploads->completedTicket;
+}
+
+const Result uploadWait(UploadManager *uploads, UploadTicket ticket)
+{
+        if (ticket >= uploads->nextTicket)
+                return RESULT_ERROR(-1, "waiting on an upload ticket that was never flushed!");
+
+        Result res;
+        while (ticket > uploads->completedTicket) {
+                handle(waitOldestSubmission(uploads));
+        }
+
+        return RESULT_SUCCESS;
+}
+
+void uploadDestroy(UploadManager *uploads, Allocator *allocator)
+{
+        // A failed wait means the device is lost, so nothing is left to wait for
+        while (uploads->submissionCount > 0) {
+                if (waitOldestSubmission(uploads).code != 0)
+                        break;
+        }
+
+        vkDestroySemaphore(uploads->device, uploads->timeline, NULL);
+
+        vkDestroyCommandPool(uploads->device, uploads->commandPool, NULL);
+        vkDestroyBuffer(uploads->device, uploads->ringBuffer, NULL);
+        allocatorFree(allocator, &uploads->ringAllocation);
+        free(uploads->copies);
+        free(uploads->imageCopies);
+        uploads->copies = NULL;
+        uploads->imageCopies = NULL;
+}
@@ -0,0 +1,106 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include "allocator.h"
+#include "result.h"
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+#define UPLOAD_MAX_SUBMISSIONS 8
+
+// Identifies one flushed batch of copies; batches complete in order, so a
+// ticket being complete implies every earlier ticket is too. Each ticket is
+// also the value the manager's timeline semaphore reaches when it completes.
+typedef uint64_t UploadTicket;
+
+typedef struct uploadCopy {
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+} UploadCopy;
+
+typedef struct uploadImageCopy {
+        VkImage dstImage;
+        VkBufferImageCopy region;
+        bool transition; // first band of its level, moves it out of UNDEFINED
+} UploadImageCopy;
+
+typedef struct uploadSubmission {
+        VkCommandBuffer commandBuffer;
+        UploadTicket ticket;
+        VkDeviceSize ringEnd; // ring head when the batch was flushed
+        bool pending;
+} UploadSubmission;
+
+// Copies data into a persistently mapped staging ring and batches the
+// buffer copies into one submission per flush, preferably on a dedicated
+// transfer queue. Ring space is reclaimed as the timeline reaches each
+// submission's ticket.
+typedef struct uploadManager {
+        VkDevice device;
+        VkQueue queue;
+        uint32_t queueFamily;
+        VkCommandPool commandPool;
+        VkSemaphore timeline; // other queues wait on this for a ticket
+
+        VkBuffer ringBuffer;
+        Allocation ringAllocation;
+        VkDeviceSize ringSize;
+        VkDeviceSize head;
+        VkDeviceSize tail;
+
+        UploadCopy *copies;
+        uint32_t copyCount;
+        uint32_t copyCapacity;
+
+        UploadImageCopy *imageCopies;
+        uint32_t imageCopyCount;
+        uint32_t imageCopyCapacity;
+
+        UploadSubmission submissions[UPLOAD_MAX_SUBMISSIONS];
+        uint32_t oldestSubmission;
+        uint32_t submissionCount;
+
+        UploadTicket nextTicket;
+        UploadTicket completedTicket;
+} UploadManager;
+
+const Result uploadCreate(
+        UploadManager *uploads,
+        VkDevice device,
+        Allocator *allocator,
+        uint32_t queueFamily,
+        VkQueue queue,
+        VkDeviceSize ringSize
+);
+void uploadDestroy(UploadManager *uploads, Allocator *allocator);
+
+// The data is copied into the ring immediately; the GPU copy happens at the
+// next flush. May block if the ring is full of in-flight batches.
+const Result uploadBuffer(
+        UploadManager *uploads,
+        VkBuffer dstBuffer,
+        VkDeviceSize dstOffset,
+        const void *data,
+        VkDeviceSize size
+);
+
+// Copies one mip level of a 2D image, in bands of whole block rows when it
+// does not fit the ring at once. The level goes from UNDEFINED to
+// TRANSFER_DST_OPTIMAL ahead of its first band and is left there; whoever
+// reads it transitions it once the ticket completes. blockSize is the
+// block's width and height in texels, 1 for uncompressed formats.
+const Result uploadImage(
+        UploadManager *uploads,
+        VkImage dstImage,
+        uint32_t mipLevel,
+        VkExtent2D extent,
+        uint32_t blockSize,
+        uint32_t blockBytes,
+        const void *data
+);
+
+const Result uploadFlush(UploadManager *uploads, UploadTicket *pTicket);
+bool uploadIsComplete(UploadManager *uploads, UploadTicket ticket);
+const Result uploadWait(UploadManager *uploads, UploadTicket ticket);
+
+#endif